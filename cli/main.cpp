@@ -0,0 +1,482 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Flowing.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+void usage( const char* program ) {
+    std::cout << "Usage: " << program << " [options] [PATH_TO_GRAPH...]" << std::endl;
+    std::cout << "The graph is read from the standard input when no path is given. gzip and zstd compressed graphs are detected automatically." << std::endl;
+    std::cout << "When several paths are given, the graphs are processed concurrently sharing one buffer pool, and the communities" << std::endl;
+    std::cout << "of the i-th graph are written to the output path with the suffix .i" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "\t-H\t\tBack the buffer pool with explicit huge pages (falls back to transparent huge pages)." << std::endl;
+    std::cout << "\t-T\t\tBack the buffer pool with transparent huge pages." << std::endl;
+    std::cout << "\t-n NODE\t\tBind the buffer pool to the given NUMA node." << std::endl;
+    std::cout << "\t-i\t\tInterleave the buffer pool across all NUMA nodes." << std::endl;
+    std::cout << "\t-p\t\tPre-fault the whole buffer pool at startup." << std::endl;
+    std::cout << "\t-P PAGES\tThe number of adjacency pages of the buffer pool, shared by all the graphs." << std::endl;
+    std::cout << "\t-m MIN[:MAX]\tThe number of pages guaranteed to each graph when several are given (default a quarter of its fair share), and the most it can take (default the whole pool)." << std::endl;
+    std::cout << "\t-M MB\t\tThe memory budget of the whole graph and communities in megabytes. Pages are evicted to stay within it." << std::endl;
+    std::cout << "\t-s PATH\t\tSpill the evicted adjacency pages to a log file at PATH." << std::endl;
+    std::cout << "\t-S MB\t\tThe disk budget of the spill log in megabytes (default 1024)." << std::endl;
+    std::cout << "\t-e\t\tKeep the spilled edges in the graph until they are overwritten in the spill log." << std::endl;
+    std::cout << "\t-g\t\tReclaim the nodes whose edges, and those of their whole community, have all been evicted, and recycle their ids. Only their final label is kept, and each node is written once." << std::endl;
+    std::cout << "\t-o PATH\t\tThe file the communities are written to (default communities.dat)." << std::endl;
+    std::cout << "\t-b\t\tWrite the communities in binary format, as (node, community) pairs." << std::endl;
+    std::cout << "\t-B\t\tThe graph is binary, made of (tail, head) pairs of 32 bit integers." << std::endl;
+    std::cout << "\t-r SECONDS\tRefine the communities over the retained edges for at most SECONDS before writing them." << std::endl;
+    std::cout << "\t-t THREADS\tThe number of threads used by the refinement (default all the cores)." << std::endl;
+    std::cout << "\t-d\t\tThe graph is directed. Edges are not symmetrised and the directed score is used." << std::endl;
+    std::cout << "\t-D\t\tMake the scores account for the evicted edges through the total degrees and a count-min sketch." << std::endl;
+    std::cout << "\t-w WIDTH\tThe width of the count-min sketch used with -D (default " << FLOWING_SKETCH_WIDTH << ", 0 only uses the degrees)." << std::endl;
+    std::cout << "\t-y\t\tCount the triangles closed by each edge among the retained edges, per node and per community." << std::endl;
+    std::cout << "\t-Y\t\tCount the triangles and raise the scores of the communities that close the triangles of their members." << std::endl;
+    std::cout << "\t-R EDGES\tShed edges when fewer than EDGES edges per second are processed. The kept edges count for the shed ones." << std::endl;
+    std::cout << "\t-q BLOCKS\tShed edges when more than BLOCKS blocks of the input are waiting to be processed (at most " << FLOWING_READER_NUM_BLOCKS << ")." << std::endl;
+    std::cout << "\t-u PATH\t\tListen on a Unix domain socket at PATH instead of reading a graph. Producers connect and write binary (tail, head)" << std::endl;
+    std::cout << "\t\t\tpairs of 32 bit integers. Producers are pushed back when the edges arrive faster than they are processed." << std::endl;
+    std::cout << "\t-N PRODUCERS\tThe number of producers that connect to the socket before the stream can end (default 1)." << std::endl;
+    std::cout << "\t-a MS\t\tAutotune the number of edges processed at once, keeping the latency of a batch below MS milliseconds." << std::endl;
+    std::cout << "\t-z MIN:MAX\tThe bounds of the autotuned batch size (default 1:" << FLOWING_TUNER_MAX_SIZE << "). Enables the autotuning, or fixes the size when MIN equals MAX." << std::endl;
+    std::cout << "\t-c EDGES\tMerge whole communities once EDGES more edges arrived between them than with other communities," << std::endl;
+    std::cout << "\t\t\tif the merged community scores better. 0 uses " << FLOWING_MERGE_EVIDENCE << "." << std::endl;
+    std::cout << "\t-x\t\tKeep the number of neighbours of each node in each community, so the moves are scored without scanning" << std::endl;
+    std::cout << "\t\t\tthe adjacencies, at the cost of memory for the distinct communities around each node." << std::endl;
+    std::cout << "\t-k PARTS\tSpread the nodes over PARTS balanced parts as they arrive, with Fennel scoring." << std::endl;
+    std::cout << "\t-l\t\tScore the parts with LDG instead of Fennel." << std::endl;
+    std::cout << "\t-K PATH\t\tThe file the part of each node is written to, as (node, part) lines, when -k is given." << std::endl;
+    std::cout << "\t-h\t\tShow this help." << std::endl;
+}
+
+/** @brief The options of a run, shared by all the streams.*/
+struct Options {
+    int                                     m_PoolFlags;
+    int                                     m_NumaNode;
+    int                                     m_NumPages;
+    int                                     m_MinPages;
+    int                                     m_MaxPages;
+    const char*                             m_SpillPath;
+    size_t                                  m_SpillBudget;
+    flowing::StreamGraph::SpillPolicy       m_SpillPolicy;
+    const char*                             m_OutputPath;
+    flowing::CommunityWriter::Format        m_OutputFormat;
+    flowing::EdgeReader::Format             m_InputFormat;
+    double                                  m_RefineBudget;
+    int                                     m_NumThreads;
+    flowing::StreamGraph::EdgeMode          m_EdgeMode;
+    bool                                    m_FullDegree;
+    bool                                    m_ReclaimNodes;
+    size_t                                  m_MemoryBudget;
+    unsigned int                            m_SketchWidth;
+    double                                  m_TargetThroughput;
+    int                                     m_TargetQueueDepth;
+    bool                                    m_Triangles;
+    bool                                    m_TriangleScoring;
+    int                                     m_NumParts;
+    flowing::StreamPartitioner::Method      m_PartitionMethod;
+    const char*                             m_PartitionPath;
+    const char*                             m_SocketPath;
+    int                                     m_NumProducers;
+    bool                                    m_TuneBatches;
+    int                                     m_MinBatchSize;
+    int                                     m_MaxBatchSize;
+    double                                  m_BatchLatency;
+    int                                     m_MergeEvidence;
+    bool                                    m_NeighborCounts;
+};
+
+/** @brief Computes the communities of a stream.
+ *  @param[in] options The options of the run.
+ *  @param[in] inputPath The path of the graph, "-" for the standard input. Ignored when listening on a socket.
+ *  @param[in] suffix The suffix added to the output and spill paths, to tell the streams apart.
+ *  @param[in] shared The pool shared with the other streams. NULL if the stream has its own.
+ *  @param[in] minPages The number of pages guaranteed to the stream by the shared pool.
+ *  @param[in] maxPages The most pages the stream can take from the shared pool.
+ *  @param[out] out Where the messages are printed.
+ *  @return The exit code of the stream.*/
+static int RunStream( const Options& options, const char* inputPath, const std::string& suffix, flowing::SharedBufferPool* shared, int minPages, int maxPages, std::ostream& out ) {
+    std::string outputPath = std::string( options.m_OutputPath ) + suffix;
+    flowing::EdgeReader reader;
+    flowing::EdgeServer server;
+    if( options.m_SocketPath != NULL ) {
+        if( !server.Open( options.m_SocketPath, options.m_NumProducers ) ) {
+            out << "ERROR: Unable to listen on " << options.m_SocketPath << std::endl;
+            return 1;
+        }
+    } else if( !reader.Open( inputPath, options.m_InputFormat ) ) {
+        out << "ERROR: Unable to open " << inputPath << " or its compression is not supported." << std::endl;
+        return 1;
+    }
+
+    flowing::CommunityDetector detector( options.m_EdgeMode );
+    flowing::StreamGraph& graph = detector.Graph();
+    flowing::CommunityStructure& communities = detector.Structure();
+    if( options.m_FullDegree ) communities.EnableFullDegree( options.m_SketchWidth );
+    if( options.m_Triangles ) communities.EnableTriangles( options.m_TriangleScoring );
+    if( options.m_MergeEvidence > 0 ) communities.EnableMerging( options.m_MergeEvidence );
+    detector.SetNeighborCounts( options.m_NeighborCounts );
+    detector.EnablePartitioning( options.m_NumParts, options.m_PartitionMethod );
+    if( shared != NULL ) {
+        graph.SetSharedBufferPool( shared, minPages, maxPages );
+        graph.SetVerbose( false );
+    } else {
+        graph.ConfigureBufferPool( options.m_PoolFlags, options.m_NumaNode );
+        graph.SetNumPages( options.m_NumPages );
+    }
+    graph.SetMemoryBudget( options.m_MemoryBudget*1024*1024 );
+    graph.ConfigureSampling( options.m_TargetThroughput, options.m_TargetQueueDepth );
+    if( options.m_TuneBatches ) graph.ConfigureBatchTuning( options.m_MinBatchSize, options.m_MaxBatchSize, options.m_BatchLatency );
+    detector.SetReclaimNodes( options.m_ReclaimNodes );
+    if( options.m_SpillPath != NULL ) {
+        graph.ConfigureSpill( (std::string( options.m_SpillPath ) + suffix).c_str(), options.m_SpillBudget*1024*1024, options.m_SpillPolicy );
+    }
+    // The communities are written by a background thread while the graph is being torn down.
+    flowing::CommunityWriter writer;
+    if( !writer.Open( outputPath.c_str(), options.m_OutputFormat, true ) ) {
+        out << "ERROR: Unable to open " << outputPath << std::endl;
+        return 1;
+    }
+    detector.SetWriter( &writer );
+    std::ofstream partitionFile;
+    if( options.m_NumParts > 0 && options.m_PartitionPath != NULL ) {
+        std::string partitionPath = std::string( options.m_PartitionPath ) + suffix;
+        partitionFile.open( partitionPath.c_str() );
+        if( !partitionFile.is_open() ) {
+            out << "ERROR: Unable to open " << partitionPath << std::endl;
+            return 1;
+        }
+        detector.Partitioner().SetOutput( &partitionFile );
+    }
+    if(!detector.Initialize()) {
+        out << "ERROR: Unable to initialize the stream graph." << std::endl;
+        return 1;
+    }
+    bool readFailed;
+    if( options.m_SocketPath != NULL ) {
+        detector.Push( server );
+        readFailed = server.Failed();
+        if( readFailed ) {
+            out << "ERROR: Unable to receive on " << options.m_SocketPath << ", writing the communities of the edges received so far." << std::endl;
+        }
+        out << "Server: " << server.NumEdges() << " edges from " << server.NumProducers() << " producers, "
+            << server.NumStalls() << " stalls on a full ring, " << server.NumDroppedBytes() << " bytes of incomplete edges dropped" << std::endl;
+        server.Close();
+    } else {
+        detector.Push( reader );
+        readFailed = reader.Failed();
+        if( reader.MalformedLine() > 0 ) {
+            out << "ERROR: Malformed edge at line " << reader.MalformedLine() << " of " << inputPath << ", writing the communities of the edges read so far." << std::endl;
+        } else if( reader.Truncated() ) {
+            out << "ERROR: " << inputPath << " ends in the middle of an edge, writing the communities of the edges read so far." << std::endl;
+        } else if( readFailed ) {
+            out << "ERROR: Unable to read " << inputPath << ", writing the communities of the edges read so far." << std::endl;
+        }
+        reader.Close();
+    }
+    // The last batch and the nodes still waiting for a part are processed before anything is reported.
+    detector.Flush();
+    flowing::MemoryUsage usage;
+    graph.GetMemoryUsage( usage );
+    out << "Memory: " << usage.Total()/1024 << " KB";
+    if( options.m_MemoryBudget > 0 ) out << " of " << options.m_MemoryBudget*1024 << " KB, " << graph.NumBudgetEvictions() << " pages evicted to meet the budget";
+    out << std::endl;
+    if( graph.BudgetUnmet() ) {
+        out << "WARNING: The memory budget could not be met by evicting pages, the per-node metadata alone exceeds it." << std::endl;
+    }
+    for( int i = 0; i < flowing::MEMORY_NUM_SUBSYSTEMS; ++i ) {
+        out << "\t" << flowing::MemoryUsage::Name( i ) << ": " << usage.m_Bytes[i]/1024 << " KB" << std::endl;
+    }
+    const flowing::EdgeSampler& sampler = graph.Sampler();
+    if( sampler.Enabled() ) {
+        out << "Sampling: " << sampler.NumShed() << " of " << sampler.NumOffered() << " edges shed in " << sampler.NumSheddingWindows()
+            << " windows, weight " << sampler.Weight() << " (max " << sampler.MaxWeight() << ")" << std::endl;
+    }
+    const flowing::BatchTuner& tuner = graph.Tuner();
+    if( tuner.Enabled() ) {
+        out << "Batching: size " << graph.BatchSize() << " after " << tuner.NumChanges() << " changes, " << tuner.NumLateWindows()
+            << " windows late, slowest batch " << tuner.MaxLatency()*1000.0 << " ms" << std::endl;
+        const std::vector<flowing::BatchTuner::Step>& history = tuner.History();
+        for( unsigned int i = 0; i < history.size(); ++i ) {
+            out << "\t" << history[i].m_NumEdges << " edges: " << history[i].m_Size << " (" << (unsigned long long)history[i].m_Throughput
+                << " edges/s, " << history[i].m_Latency*1000.0 << " ms)" << std::endl;
+        }
+    }
+    const flowing::TriangleCounter& triangles = communities.Triangles();
+    if( triangles.Enabled() && triangles.NumEdges() > 0 ) {
+        out << "Triangles: " << triangles.NumTriangles() << " closed by " << triangles.NumEdges() << " edges, "
+            << triangles.NumAdjacencies() / triangles.NumEdges() << " adjacencies and "
+            << (unsigned long long)(triangles.Seconds()*1e9 / triangles.NumEdges()) << " ns per edge" << std::endl;
+    }
+    const flowing::StreamPartitioner& partitioner = detector.Partitioner();
+    if( partitioner.Enabled() && partitioner.NumEdges() > 0 ) {
+        out << "Partitions: " << partitioner.NumAssigned() << " nodes in " << partitioner.NumParts() << " parts, "
+            << partitioner.NumCutEdges() << " of " << partitioner.NumEdges() << " edges cut ("
+            << 100.0*partitioner.NumCutEdges()/partitioner.NumEdges() << "%), imbalance " << partitioner.Imbalance() << std::endl;
+    }
+    if( options.m_MergeEvidence > 0 ) {
+        out << "Merges: " << communities.NumMerges() << " communities merged, " << communities.NumCommunities() << " left" << std::endl;
+    }
+    const flowing::NeighborCounts& counts = graph.Counts();
+    if( counts.Enabled() ) {
+        out << "Neighbor counts: " << counts.NumLabels() << " node-community pairs in " << counts.Bytes()/1024 << " KB, "
+            << counts.NumUpdates() << " updates" << std::endl;
+    }
+    if( options.m_ReclaimNodes ) {
+        out << "Nodes: " << graph.NumLiveNodes() << " live, " << graph.NumReclaimedNodes() << " reclaimed" << std::endl;
+    }
+    if( options.m_RefineBudget > 0.0 ) {
+        flowing::CommunityStructure::RefineStats stats = detector.Refine( options.m_RefineBudget, options.m_NumThreads );
+        out << "Refinement: " << stats.m_NumRounds << " rounds, " << stats.m_NumMoves << " moves, " 
+            << stats.m_NumConflicts << " conflicts in " << stats.m_Seconds << " s" << std::endl;
+    }
+/*    unsigned int numNodes = graph.NumNodes();
+    for( unsigned int i = 0; i < numNodes; ++i ) {
+        flowing::StreamGraph::AdjacencyIterator it = graph.Iterator(i);
+
+        std::cout << graph.Remap(i) << ":"  << std::endl; 
+        while( it.HasNext() ) {
+            std::cout << graph.Remap(it.Next()) << " ";
+        }
+        std::cout << std::endl;
+        i % 10000 == 0 ? std::cout << "Iterated over " << i << " nodes" << std::endl : (void*)0;
+    }
+    */
+    detector.Close();
+    if( !writer.Close() ) {
+        out << "ERROR: Unable to write the communities to " << outputPath << std::endl;
+        return 1;
+    }
+    return readFailed ? 1 : 0;
+}
+
+/** @brief Computes the communities of several streams concurrently, one thread each, sharing one buffer pool.
+ *  @param[in] options The options of the run.
+ *  @param[in] inputPaths The paths of the graphs.
+ *  @return The exit code of the run, 1 if any of the streams failed.*/
+static int RunStreams( const Options& options, const std::vector<const char*>& inputPaths ) {
+    int numStreams = inputPaths.size();
+    flowing::SharedBufferPool shared( options.m_NumPages, FLOWING_PAGE_SIZE, options.m_PoolFlags, options.m_NumaNode );
+    if( !shared.Initialize() ) {
+        std::cout << "ERROR: Unable to initialize the shared buffer pool." << std::endl;
+        return 1;
+    }
+    int maxPages = options.m_MaxPages > 0 ? options.m_MaxPages : options.m_NumPages;
+    int minPages = options.m_MinPages > 0 ? options.m_MinPages : options.m_NumPages / (4*numStreams);
+    if( options.m_MinPages == 0 && minPages > maxPages ) minPages = maxPages;
+    if( (long long)minPages*numStreams > options.m_NumPages ) {
+        std::cout << "ERROR: The pages guaranteed to the graphs do not fit in the buffer pool." << std::endl;
+        shared.Close();
+        return 1;
+    }
+    std::vector<std::ostringstream> reports( numStreams );
+    std::vector<int> results( numStreams, 0 );
+    std::vector<std::thread> threads;
+    for( int i = 0; i < numStreams; ++i ) {
+        std::ostringstream suffix;
+        suffix << "." << i;
+        threads.push_back( std::thread( [&, i]( std::string streamSuffix ) {
+            results[i] = RunStream( options, inputPaths[i], streamSuffix, &shared, minPages, maxPages, reports[i] );
+        }, suffix.str() ) );
+    }
+    int result = 0;
+    for( int i = 0; i < numStreams; ++i ) {
+        threads[i].join();
+        std::cout << inputPaths[i] << ":" << std::endl << reports[i].str();
+        if( results[i] != 0 ) result = 1;
+    }
+    shared.Close();
+    return result;
+}
+
+int main( int argc, char** argv ) {
+
+    Options options;
+    options.m_PoolFlags = flowing::BufferPool::NONE;
+    options.m_NumaNode = -1;
+    options.m_NumPages = FLOWING_NUM_PAGES;
+    options.m_MinPages = 0;
+    options.m_MaxPages = 0;
+    options.m_SpillPath = NULL;
+    options.m_SpillBudget = 1024;
+    options.m_SpillPolicy = flowing::StreamGraph::SPILL_ARCHIVE;
+    options.m_OutputPath = "communities.dat";
+    options.m_OutputFormat = flowing::CommunityWriter::TEXT;
+    options.m_InputFormat = flowing::EdgeReader::TEXT;
+    options.m_RefineBudget = 0.0;
+    options.m_NumThreads = std::thread::hardware_concurrency();
+    options.m_EdgeMode = flowing::StreamGraph::UNDIRECTED;
+    options.m_FullDegree = false;
+    options.m_ReclaimNodes = false;
+    options.m_MemoryBudget = 0;
+    options.m_SketchWidth = FLOWING_SKETCH_WIDTH;
+    options.m_TargetThroughput = 0.0;
+    options.m_TargetQueueDepth = 0;
+    options.m_Triangles = false;
+    options.m_NumParts = 0;
+    options.m_PartitionMethod = flowing::StreamPartitioner::FENNEL;
+    options.m_PartitionPath = NULL;
+    options.m_SocketPath = NULL;
+    options.m_NumProducers = 1;
+    options.m_TuneBatches = false;
+    options.m_MinBatchSize = 1;
+    options.m_MaxBatchSize = FLOWING_TUNER_MAX_SIZE;
+    options.m_BatchLatency = 0.0;
+    options.m_MergeEvidence = -1;
+    options.m_NeighborCounts = false;
+    options.m_TriangleScoring = false;
+    int option;
+    while( (option = getopt( argc, argv, "HTn:ipP:m:M:s:S:ego:bBr:t:dDw:yYR:q:k:lK:u:N:a:z:c:xh" )) != -1 ) {
+        switch( option ) {
+            case 'H':
+                options.m_PoolFlags |= flowing::BufferPool::HUGE_PAGES;
+                break;
+            case 'T':
+                options.m_PoolFlags |= flowing::BufferPool::TRANSPARENT_HUGE_PAGES;
+                break;
+            case 'n':
+                options.m_PoolFlags |= flowing::BufferPool::NUMA_BIND;
+                options.m_NumaNode = atoi( optarg );
+                break;
+            case 'i':
+                options.m_PoolFlags |= flowing::BufferPool::NUMA_INTERLEAVE;
+                break;
+            case 'p':
+                options.m_PoolFlags |= flowing::BufferPool::POPULATE;
+                break;
+            case 'P':
+                options.m_NumPages = atoi( optarg );
+                break;
+            case 'm': {
+                int numBounds = sscanf( optarg, "%d:%d", &options.m_MinPages, &options.m_MaxPages );
+                if( numBounds < 1 || options.m_MinPages < 1 || (numBounds == 2 && options.m_MaxPages < options.m_MinPages) ) {
+                    usage( argv[0] );
+                    return 1;
+                }
+                break;
+            }
+            case 'M':
+                options.m_MemoryBudget = strtoul( optarg, NULL, 10 );
+                break;
+            case 's':
+                options.m_SpillPath = optarg;
+                break;
+            case 'S':
+                options.m_SpillBudget = strtoul( optarg, NULL, 10 );
+                break;
+            case 'e':
+                options.m_SpillPolicy = flowing::StreamGraph::SPILL_EXTEND;
+                break;
+            case 'g':
+                options.m_ReclaimNodes = true;
+                break;
+            case 'o':
+                options.m_OutputPath = optarg;
+                break;
+            case 'b':
+                options.m_OutputFormat = flowing::CommunityWriter::BINARY;
+                break;
+            case 'B':
+                options.m_InputFormat = flowing::EdgeReader::BINARY;
+                break;
+            case 'r':
+                options.m_RefineBudget = atof( optarg );
+                break;
+            case 't':
+                options.m_NumThreads = atoi( optarg );
+                break;
+            case 'd':
+                options.m_EdgeMode = flowing::StreamGraph::DIRECTED;
+                break;
+            case 'D':
+                options.m_FullDegree = true;
+                break;
+            case 'w':
+                options.m_SketchWidth = strtoul( optarg, NULL, 10 );
+                break;
+            case 'y':
+                options.m_Triangles = true;
+                break;
+            case 'Y':
+                options.m_Triangles = true;
+                options.m_TriangleScoring = true;
+                break;
+            case 'R':
+                options.m_TargetThroughput = atof( optarg );
+                break;
+            case 'q':
+                options.m_TargetQueueDepth = atoi( optarg );
+                break;
+            case 'k':
+                options.m_NumParts = atoi( optarg );
+                break;
+            case 'l':
+                options.m_PartitionMethod = flowing::StreamPartitioner::LDG;
+                break;
+            case 'K':
+                options.m_PartitionPath = optarg;
+                break;
+            case 'u':
+                options.m_SocketPath = optarg;
+                break;
+            case 'N':
+                options.m_NumProducers = atoi( optarg );
+                break;
+            case 'a':
+                options.m_TuneBatches = true;
+                options.m_BatchLatency = atof( optarg ) / 1000.0;
+                break;
+            case 'z':
+                options.m_TuneBatches = true;
+                if( sscanf( optarg, "%d:%d", &options.m_MinBatchSize, &options.m_MaxBatchSize ) != 2 ||
+                    options.m_MinBatchSize < 1 || options.m_MaxBatchSize < options.m_MinBatchSize ) {
+                    usage( argv[0] );
+                    return 1;
+                }
+                break;
+            case 'c':
+                options.m_MergeEvidence = atoi( optarg );
+                if( options.m_MergeEvidence <= 0 ) options.m_MergeEvidence = FLOWING_MERGE_EVIDENCE;
+                break;
+            case 'x':
+                options.m_NeighborCounts = true;
+                break;
+            case 'h':
+                usage( argv[0] );
+                return 0;
+            default:
+                usage( argv[0] );
+                return 1;
+        }
+    }
+
+    if( options.m_SocketPath != NULL && optind < argc ) {
+        std::cout << "ERROR: No graph can be given when listening on a socket." << std::endl;
+        return 1;
+    }
+    if( argc - optind > 1 ) {
+        std::vector<const char*> inputPaths( argv + optind, argv + argc );
+        return RunStreams( options, inputPaths );
+    }
+    const char* inputPath = optind < argc ? argv[optind] : "-";
+    return RunStream( options, inputPath, "", NULL, 0, 0, std::cout );
+}
@@ -0,0 +1,118 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCH_TUNER_H
+#define BATCH_TUNER_H
+
+#include <chrono>
+#include <vector>
+
+namespace flowing {
+
+#define FLOWING_TUNER_WINDOW 16384
+#define FLOWING_TUNER_MAX_SIZE 4096
+#define FLOWING_TUNER_HISTORY 64
+#define FLOWING_TUNER_TOLERANCE 0.05
+
+    /** @brief Adapts the number of edges the StreamGraph passes at once to the insert callback. Once every
+     *  FLOWING_TUNER_WINDOW processed edges the size is doubled or halved, climbing towards the size
+     *  that processes the most edges per second: a change that lowers the throughput by more than
+     *  FLOWING_TUNER_TOLERANCE is undone and the search turns around. The latency of a batch, from its
+     *  first edge arriving to its callback returning, bounds the climb: the size is halved whenever the
+     *  slowest batch of the window missed the target, and it does not grow when doubling it would miss
+     *  it. While blocks are waiting in the input queue the search leans towards larger batches.*/
+    class BatchTuner {
+        public:
+
+            /** @brief A change of the batch size.*/
+            struct Step {
+                unsigned long long  m_NumEdges;     /**< @brief The number of edges processed when the size changed.*/
+                int                 m_Size;         /**< @brief The new size.*/
+                double              m_Throughput;   /**< @brief The edges per second of the window that led to the change.*/
+                double              m_Latency;      /**< @brief The latency of the slowest batch of the window, in seconds.*/
+            };
+
+            BatchTuner();
+            ~BatchTuner();
+
+            /** @brief Enables the tuning.
+             *  @param[in] size The size to start with.
+             *  @param[in] minSize The smallest size allowed.
+             *  @param[in] maxSize The largest size allowed. Tuning is disabled when it is below minSize, and the size is fixed when it is equal.
+             *  @param[in] latency The target latency of a batch in seconds. 0 to only maximize the throughput.*/
+            void Configure( const int size, const int minSize, const int maxSize, const double latency );
+
+            /** @brief Tells if the tuning is enabled.
+             *  @return true if the size is adapted.*/
+            bool Enabled() const;
+
+            /** @brief Records that the first edge of a batch arrived.*/
+            void BatchStarted();
+
+            /** @brief Records that a batch was processed, adapting the size at the end of the window.
+             *  @param[in] numEdges The number of edges of the batch.*/
+            void BatchProcessed( const int numEdges );
+
+            /** @brief Records the number of blocks waiting in the input, used at the end of the window.
+             *  @param[in] queueDepth The number of blocks.*/
+            void ObserveQueueDepth( const int queueDepth );
+
+            /** @brief Gets the current batch size.
+             *  @return The size.*/
+            int Size() const;
+
+            /** @brief Gets the largest batch size allowed, which the batch buffer has to hold.
+             *  @return The size.*/
+            int MaxSize() const;
+
+            /** @brief Gets the changes of the size, at most the last FLOWING_TUNER_HISTORY.
+             *  @return The changes, oldest first.*/
+            const std::vector<Step>& History() const;
+
+            /** @brief Gets the number of times the size changed.
+             *  @return The number of changes.*/
+            unsigned long long NumChanges() const;
+
+            /** @brief Gets the number of windows whose slowest batch missed the latency target.
+             *  @return The number of windows.*/
+            unsigned long long NumLateWindows() const;
+
+            /** @brief Gets the latency of the slowest batch so far.
+             *  @return The latency in seconds.*/
+            double MaxLatency() const;
+
+        private:
+            /** @brief Adapts the size to the throughput and latency of the last window.*/
+            void Adapt();
+
+            int                                     m_Size;             /**< @brief The current size.*/
+            int                                     m_MinSize;          /**< @brief The smallest size allowed.*/
+            int                                     m_MaxSize;          /**< @brief The largest size allowed.*/
+            double                                  m_Latency;          /**< @brief The target latency in seconds. 0 if there is none.*/
+            int                                     m_Direction;        /**< @brief 1 if the size is being grown, -1 if it is being shrunk.*/
+            double                                  m_LastThroughput;   /**< @brief The throughput of the previous window. 0 before the first one.*/
+            int                                     m_ObservedDepth;    /**< @brief The last queue depth observed.*/
+            unsigned long long                      m_NumEdges;         /**< @brief The number of edges processed.*/
+            unsigned long long                      m_WindowEdges;      /**< @brief The number of edges processed in the current window.*/
+            double                                  m_WindowLatency;    /**< @brief The latency of the slowest batch of the current window.*/
+            double                                  m_MaxLatency;       /**< @brief The latency of the slowest batch.*/
+            unsigned long long                      m_NumChanges;       /**< @brief The number of changes of the size.*/
+            unsigned long long                      m_NumLateWindows;   /**< @brief The number of windows that missed the latency target.*/
+            std::vector<Step>                       m_History;          /**< @brief The last changes of the size.*/
+            std::chrono::steady_clock::time_point   m_BatchStart;       /**< @brief When the first edge of the current batch arrived.*/
+            std::chrono::steady_clock::time_point   m_WindowStart;      /**< @brief When the current window started.*/
+    };
+}
+
+#endif
@@ -15,17 +15,40 @@
 #ifndef PAGE_POOL_H
 #define PAGE_POOL_H
 
+#include <cstddef>
+
 namespace flowing {
 
     class BufferPool {
         public:
 
+            /** @brief Options controlling how the pool memory is mapped.*/
+            enum Flags {
+                NONE                    = 0,        /**< @brief Plain anonymous mapping, committed lazily by the kernel.*/
+                HUGE_PAGES              = 1 << 0,   /**< @brief Try explicit huge pages (MAP_HUGETLB), falling back to transparent huge pages.*/
+                TRANSPARENT_HUGE_PAGES  = 1 << 1,   /**< @brief Advise the kernel to back the pool with transparent huge pages.*/
+                NUMA_BIND               = 1 << 2,   /**< @brief Bind the pool to the configured NUMA node.*/
+                NUMA_INTERLEAVE         = 1 << 3,   /**< @brief Interleave the pool pages across all NUMA nodes.*/
+                POPULATE                = 1 << 4    /**< @brief Pre-fault the whole pool at initialization.*/
+            };
+
             /** @param numPages The number of buffers to contain.
-              @param bufferSize The size of the buffers in bytes.*/
-            BufferPool( const int numBuffers, const int bufferSize);
+              @param bufferSize The size of the buffers in bytes.
+              @param flags A combination of BufferPool::Flags.
+              @param numaNode The NUMA node used with NUMA_BIND.*/
+            BufferPool( const int numBuffers, const int bufferSize, const int flags = NONE, const int numaNode = -1 );
             ~BufferPool();
 
-            /** @brief Initializes the buffer pool.
+            /** @brief Changes the mapping options. Only has effect before Initialize is called.
+              @param flags A combination of BufferPool::Flags.
+              @param numaNode The NUMA node used with NUMA_BIND.*/
+            void Configure( const int flags, const int numaNode = -1 );
+
+            /** @brief Changes the number of buffers. Only has effect before Initialize is called.
+              @param numBuffers The number of buffers to contain.*/
+            void SetNumBuffers( const int numBuffers );
+
+            /** @brief Initializes the buffer pool. Fails when the NUMA policy set with Configure cannot be applied.
               @param True if the initialization was successful*/
             bool Initialize();
 
@@ -44,13 +67,34 @@ namespace flowing {
              *  @return The number of free buffers.*/
             int NumFreeBuffers();
 
+            /** @brief Gets the number of bytes reserved for the pool.
+             *  @return The size of the mapping backing the pool.*/
+            size_t MappedBytes() const;
+
+            /** @brief Tells if the pool ended up backed by explicit huge pages.
+             *  @return true if MAP_HUGETLB succeeded.*/
+            bool UsesHugePages() const;
+
+        private:
+
+            /** @brief Applies the configured NUMA policy to the mapping.
+              @return true if the policy was applied or none was requested.*/
+            bool ApplyNumaPolicy();
+
+            /** @brief Faults in the whole mapping, once the NUMA policy decides where its pages go.*/
+            void Populate();
+
         public:
             int     m_NumBuffers; /**< @brief The number of buffers.*/
             int     m_BufferSize; /**< @brief The buffer size in bytes.*/
             int     m_Next;       /**< @brief The index to the next available buffer.*/
             void*   m_Buffers;     /**< @brief A pointer to the memory buffer.*/
+            int     m_Flags;      /**< @brief The mapping options.*/
+            int     m_NumaNode;   /**< @brief The NUMA node to bind to.*/
+            size_t  m_MappedSize; /**< @brief The size of the mapping in bytes.*/
+            bool    m_HugePages;  /**< @brief Whether the mapping uses explicit huge pages.*/
     };
 
 }
 
-#endif 
+#endif
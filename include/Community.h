@@ -17,10 +17,16 @@
 
 #include "Types.h"
 #include "StreamGraph.h"
+#include "DegreeSketch.h"
+#include "TriangleCounter.h"
+#include "MemoryUsage.h"
 #include <set>
+#include <vector>
 
 namespace flowing {
 
+#define FLOWING_COMMUNITY_POOL_CHUNK 4096
+
     class Community {
         public:
             class CommunityIterator {
@@ -45,10 +51,18 @@ namespace flowing {
             };
 
             /** param[in] graph The graph this community belongs to.
-             *  param[in] id The identifier of the community.*/
-            Community( StreamGraph* graph, unsigned int id );
+             *  param[in] id The identifier of the community.
+             *  param[in] sketch The summaries of the evicted edges used in the scores. NULL to only use the retained edges.
+             *  param[in] triangles The triangle counts of the nodes, used in the scores if it is scoring. NULL to ignore the triangles.*/
+            Community( StreamGraph* graph, unsigned int id, const DegreeSketch* sketch = NULL, const TriangleCounter* triangles = NULL );
             ~Community();
 
+            /** @brief Turns the community into a community with a single node, so it can be reused.
+             *  @param[in] id The identifier of the community, which is also its only node.
+             *  @param[in] kin The internal degree of the community.
+             *  @param[in] kout The external degree of the community.*/
+            void Reset( unsigned int id, int kin, int kout );
+
             /** @brief Checks if the node exists into the community.
              *  @param[in] id The node to check if exists.
              *  @return true if the node was already into the community. false otherwise.*/
@@ -62,10 +76,43 @@ namespace flowing {
              *  @param[in] id The node to remove.*/
             void Remove( unsigned int id );
 
-            /** @brief Gets the size of the community.
+            /** @brief Gets the size of the community, including the members of the absorbed communities.
              *  @return The size of the community.*/
             int Size() const;
 
+            /** @brief Gets the community this one was merged into, following the chain of merges.
+             *  @return The community itself if it was not merged into another one.*/
+            Community* Find() const;
+
+            /** @brief Merges another community into this one. Only the degrees are combined right away, while
+             *  the members of the other community stay in its own set until they are reconciled.
+             *  @param[in] other The community to absorb. Must not have been merged into another one.
+             *  @param[in] cut The edges between the two communities.*/
+            void Absorb( Community* other, const int cut );
+
+            /** @brief Tests the score of the community if another community is merged into it.
+             *  @param[in] other The community to merge.
+             *  @param[in] cut The edges between the two communities.
+             *  @return The score of the merged community.*/
+            double TestMerge( const Community* other, const int cut ) const;
+
+            /** @brief Gets the communities absorbed directly by this one and not reconciled yet.
+             *  @return The communities.*/
+            const std::vector<Community*>& Absorbed() const;
+
+            /** @brief Takes the members of an absorbed community into the set of this one, emptying it.
+             *  @param[in] absorbed The absorbed community, whose own absorbed communities are forgotten.*/
+            void Adopt( Community* absorbed );
+
+            /** @brief Forgets the absorbed communities, once they have been adopted.*/
+            void ClearAbsorbed();
+
+            /** @brief Counts an edge between this community and another one, keeping track of the community
+             *  this one shares the most recent edges with, as a single counter heavy hitter sketch.
+             *  @param[in] other The community at the other end of the edge.
+             *  @return The evidence that other is the partner of this community, 0 if it is not.*/
+            int Observe( const Community* other );
+
             /** @brief Tests the score of the community if a node is inserted.
              *  @param[in] nodeId The node to insert.
              *  @return The score of the community if a node was inserted.*/
@@ -76,44 +123,166 @@ namespace flowing {
              *  @return The score of the community if a node was removed.*/
             double TestRemove( unsigned int nodeId ) const ;
 
-            /** @brief Gets the score of the community.
+            /** @brief Gets the score of the community. In DIRECTED mode the edges entering and leaving the
+             *  nodes are both taken into account, and every internal arc counts once towards the internal degree.
+             *  When the triangles are scored, the score is raised towards 1 by the fraction of the triangles of
+             *  the members that are closed inside the community.
              *  @return The score of the community.*/
             double Score() const ;
 
+            /** @brief Tests the score of a community formed by a single node, without materializing it, if a node is inserted.
+             *  @param[in] graph The graph the communities belong to.
+             *  @param[in] sketch The summaries of the evicted edges used in the scores. NULL to only use the retained edges.
+             *  @param[in] singleton The only node of the community.
+             *  @param[in] kout The external degree of the community.
+             *  @param[in] nodeId The node to insert.
+             *  @return The score of the community if a node was inserted.*/
+            static double TestInsertSingleton( const StreamGraph* graph, const DegreeSketch* sketch, unsigned int singleton, int kout, unsigned int nodeId );
+
+            /** @brief Gets the label of the community of a node, as counted by the NeighborCounts of the graph.
+             *  Singletons are told apart from communities by the top bit, which no pointer uses.
+             *  @param[in] community The community of the node, which must not have been merged into another one. NULL for a singleton.
+             *  @param[in] nodeId The node.
+             *  @return The label.*/
+            static unsigned long long Label( const Community* community, unsigned int nodeId );
+
+            /** @brief Gets the internal degree of the community.
+             *  @return The internal degree of the community.*/
+            int Kin() const;
+
+            /** @brief Gets the external degree of the community.
+             *  @return The external degree of the community.*/
+            int Kout() const;
+
+            /** @brief Gets the triangles closed while their three nodes were in the community, adjusted by
+             *  an estimate when nodes move in or out.
+             *  @return The weighted number of internal triangles.*/
+            unsigned long long InternalTriangles() const;
+
+            /** @brief Gets the triangles the members of the community took part in, counted once per member.
+             *  @return The weighted sum of the triangles of the members.*/
+            unsigned long long TriangleVolume() const;
+
+            /** @brief Signals a triangle one of the members took part in.
+             *  @param[in] weight The number of triangles it stands for.
+             *  @param[in] internal Whether its three nodes are in the community. Only signaled for one of them.*/
+            void SignalTriangle( const unsigned long long weight, const bool internal );
+
             /** @brief Gets the id of the community.
              *  @return The id of the community.*/
             unsigned int Id() const ;
 
-            /** @brief Obtains an iterator of the community.
+            /** @brief Obtains an iterator over the members in the set of the community, which only include the members
+             *  of the absorbed communities once they are reconciled, see CommunityStructure::Reconcile.
              * @return An iterator of the community.*/ 
             CommunityIterator Iterator() const;
 
-            void SignalInsertInternalEdge();
-            void SignalInsertExternalEdge();
-            void SignalRemoveInternalEdge();
-            void SignalRemoveExternalEdge();
+            /** @brief Signals edges inserted or removed inside or at the border of the community.
+             *  @param[in] weight The number of edges they stand for.*/
+            void SignalInsertInternalEdge( const int weight = 1 );
+            void SignalInsertExternalEdge( const int weight = 1 );
+            void SignalRemoveInternalEdge( const int weight = 1 );
+            void SignalRemoveExternalEdge( const int weight = 1 );
 
         private:
+            friend class CommunityPool;
 
             /** @brief Tests the score of the community if a node is inserted.
              *  @param[in] nodeId The node to insert.
              *  @param[out] newKin The new Kin of the community.
              *  @param[out] newKout The new Kout of the community.
+             *  @param[out] newTriangles The new internal triangles of the community.
              *  @return The score of the community if a node was inserted.*/
-            double TestInsert( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout ) const;
+            double TestInsert( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout, unsigned long long& newTriangles ) const;
 
             /** @brief Tests the score of the community if a node is removed.
              *  @param[in] nodeId The node to remove.
              *  @param[out] newKin The new Kin of the community.
              *  @param[out] newKout The new Kout of the community.
+             *  @param[out] newTriangles The new internal triangles of the community.
              *  @return The score of the community if a node was removed.*/
-            double TestRemove( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout ) const ;
+            double TestRemove( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout, unsigned long long& newTriangles ) const ;
+
+            /** @brief Estimates the triangles of a node closed inside the community, assuming its triangles
+             *  are spread like its edges.
+             *  @param[in] nodeId The node.
+             *  @param[in] nodeKin The edges of the node inside the community.
+             *  @param[in] nodeKout The edges of the node outside the community.
+             *  @return The weighted number of triangles.*/
+            unsigned long long InternalTriangles( unsigned int nodeId, int nodeKin, int nodeKout ) const;
+
+            /** @brief Weighs the retained adjacencies of a node into the community, looking them up in the
+             *  NeighborCounts of the graph when they are kept and scanning the adjacencies otherwise.
+             *  @param[in] nodeId The node.
+             *  @param[out] nodeDegree The weight of the retained adjacencies of the node.
+             *  @return The weight of the adjacencies into the community.*/
+            int RetainedKin( unsigned int nodeId, int& nodeDegree ) const;
+
+            /** @brief Applies the triangles to a score, if they are scored.
+             *  @param[in] score The score from the degrees.
+             *  @param[in] internal The internal triangles.
+             *  @param[in] volume The triangles of the members.
+             *  @return The score.*/
+            double ScoreTriangles( double score, unsigned long long internal, unsigned long long volume ) const;
 
             unsigned int            m_CommunityId;  /**< @brief The id of the community.*/
             std::set<unsigned int>  m_Nodes;        /**< @brief The set of nodes in the community.*/   
             StreamGraph* const      m_Graph;        /**< @brief The graph this community belongs to.*/
             int                     m_Kin;          /**< @brief Internal degree of the community.*/
             int                     m_Kout;         /**< @brief External degree of the community.*/
+            const DegreeSketch*     m_Sketch;       /**< @brief The summaries of the evicted edges.*/
+            const TriangleCounter*  m_TriangleCounter;  /**< @brief The triangle counts of the nodes.*/
+            unsigned long long      m_InternalTriangles; /**< @brief The triangles closed inside the community.*/
+            unsigned long long      m_TriangleVolume;   /**< @brief The triangles of the members.*/
+            mutable Community*      m_Parent;       /**< @brief The community this one was merged into, itself if none.*/
+            std::vector<Community*> m_Absorbed;     /**< @brief The communities merged into this one and not reconciled yet.*/
+            int                     m_Size;         /**< @brief The number of members, including the ones of the absorbed communities.*/
+            const Community*        m_Partner;      /**< @brief The community this one shares the most recent edges with.*/
+            int                     m_PartnerEdges; /**< @brief The evidence of the partner.*/
+    };
+
+    /** @brief An arena of communities. Freed communities are kept and handed out again
+     *  instead of being returned to the heap.*/
+    class CommunityPool {
+        public:
+            /** param[in] graph The graph the communities belong to.
+             *  param[in] sketch The summaries of the evicted edges used in the scores.
+             *  param[in] triangles The triangle counts of the nodes used in the scores.
+             *  param[in] chunkSize The number of communities allocated at once.*/
+            CommunityPool( StreamGraph* graph, const DegreeSketch* sketch = NULL, const TriangleCounter* triangles = NULL, const int chunkSize = FLOWING_COMMUNITY_POOL_CHUNK );
+            ~CommunityPool();
+
+            /** @brief Gets a community with a single node.
+             *  @param[in] id The identifier of the community, which is also its only node.
+             *  @param[in] kin The internal degree of the community.
+             *  @param[in] kout The external degree of the community.
+             *  @return The community.*/
+            Community* Allocate( unsigned int id, int kin, int kout );
+
+            /** @brief Returns a community to the pool. Its remaining nodes are discarded.
+             *  @param[in] community The community to free.*/
+            void Free( Community* community );
+
+            /** @brief Gets the number of communities handed out.
+             *  @return The number of communities in use.*/
+            int NumUsed() const;
+
+            /** @brief Gets the number of communities the pool holds, either in use or free.
+             *  @return The number of communities constructed by the pool.*/
+            int NumConstructed() const;
+
+            /** @brief Gets the memory held by the pool, without the member sets of the communities.
+             *  @return The size of the pool in bytes.*/
+            size_t Bytes() const;
+
+        private:
+            StreamGraph* const          m_Graph;        /**< @brief The graph the communities belong to.*/
+            const DegreeSketch* const   m_Sketch;       /**< @brief The summaries of the evicted edges.*/
+            const TriangleCounter* const m_Triangles;   /**< @brief The triangle counts of the nodes.*/
+            const int                   m_ChunkSize;    /**< @brief The number of communities in a chunk.*/
+            std::vector<Community*>     m_Chunks;       /**< @brief The chunks of memory holding the communities.*/
+            int                         m_NumInChunk;   /**< @brief The number of communities constructed in the last chunk.*/
+            std::vector<Community*>     m_Free;         /**< @brief The freed communities ready to be reused.*/
     };
 }
 
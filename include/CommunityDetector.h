@@ -0,0 +1,161 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMUNITY_DETECTOR_H
+#define COMMUNITY_DETECTOR_H
+
+#include "Types.h"
+#include "StreamGraph.h"
+#include "CommunityStructure.h"
+#include "CommunityWriter.h"
+#include "StreamPartitioner.h"
+#include "EdgeReader.h"
+#include "EdgeServer.h"
+#include <cstddef>
+
+namespace flowing {
+
+    /** @brief The in-process entry point of the library. It wires a StreamGraph to a CommunityStructure,
+     *  takes the edges as arrays that are read in place, and hands the community of every node back as
+     *  arrays. The graph and the structure stay reachable for the configuration and statistics that the
+     *  detector does not wrap.
+     *
+     *  A community is labeled with the original id of its member with the smallest internal id, and a
+     *  node that is alone with the original id of the node itself. The nodes can also be spread over
+     *  balanced parts in the same pass, see StreamPartitioner.*/
+    class CommunityDetector {
+        public:
+            /** @param[in] mode The mode of the graph.
+             *  @param[in] batchSize The number of edges passed at once to the community structure.*/
+            CommunityDetector( const StreamGraph::EdgeMode mode = StreamGraph::UNDIRECTED, const int batchSize = 1 );
+            ~CommunityDetector();
+
+            /** @brief StreamGraph insert callback, forwarding the edges to the structure and the partitioner.*/
+            static void InsertEdges( StreamGraph* graph, Edge* edges, int numEdges );
+
+            /** @brief StreamGraph remove callback.*/
+            static void RemoveEdges( StreamGraph* graph, Edge* edges, int numEdges );
+
+            /** @brief StreamGraph node data allocation callback.*/
+            static void* NodeDataAllocate( StreamGraph* graph, unsigned int nodeId );
+
+            /** @brief StreamGraph node data free callback.*/
+            static void NodeDataFree( StreamGraph* graph, unsigned int nodeId, void* nodeData );
+
+            /** @brief StreamGraph node reclaim callback. The partitioner lets the node go only if the structure does.*/
+            static bool NodeReclaim( StreamGraph* graph, unsigned int nodeId, void* nodeData );
+
+            /** @brief StreamGraph neighbour label callback, see CommunityStructure::NodeLabel.*/
+            static unsigned long long NodeLabel( const StreamGraph* graph, unsigned int nodeId );
+
+            /** @brief StreamGraph node data usage callback.*/
+            static void NodeDataUsage( const StreamGraph* graph, MemoryUsage& usage );
+
+            /** @brief Gets the graph, to configure it before Initialize or to read its statistics.
+             *  @return The graph.*/
+            StreamGraph& Graph();
+
+            /** @brief Gets the community structure, to configure it before Initialize or to read its statistics.
+             *  @return The community structure.*/
+            CommunityStructure& Structure();
+
+            /** @brief Sets where the communities are written when the detector is closed, the reclaimed
+             *  nodes included.
+             *  @param[in] writer The writer, already open. NULL to not write anything.*/
+            void SetWriter( CommunityWriter* writer );
+
+            /** @brief Enables or disables the reclamation of the nodes whose whole community has no edges
+             *  left in the graph, see CommunityStructure::NodeReclaim. Must be called before Initialize.
+             *  @param[in] reclaim Whether the nodes are reclaimed.*/
+            void SetReclaimNodes( const bool reclaim );
+
+            /** @brief Enables or disables the counts of the neighbours of each node in each community, so the
+             *  moves are scored with lookups instead of scanning the adjacencies, see NeighborCounts. They
+             *  cost memory proportional to the distinct communities around each node. Must be called before Initialize.
+             *  @param[in] enabled Whether the counts are kept.*/
+            void SetNeighborCounts( const bool enabled );
+
+            /** @brief Spreads the nodes over balanced parts as they arrive. Must be called before Initialize.
+             *  @param[in] numParts The number of parts. 0 disables the partitioning.
+             *  @param[in] method How the parts are scored.*/
+            void EnablePartitioning( const int numParts, const StreamPartitioner::Method method = StreamPartitioner::FENNEL );
+
+            /** @brief Gets the partitioner, to read its metrics or set where the assignments are written.
+             *  @return The partitioner.*/
+            StreamPartitioner& Partitioner();
+
+            /** @brief Initializes the detector, once it is configured.
+             *  @return true if the initialization was successful.*/
+            bool Initialize();
+
+            /** @brief Pushes an array of edges.
+             *  @param[in] edges The edges, made of original node ids.
+             *  @param[in] numEdges The number of edges.*/
+            void Push( const Edge* edges, const size_t numEdges );
+
+            /** @brief Pushes the edges given as two arrays of ends.
+             *  @param[in] tails The tails of the edges.
+             *  @param[in] heads The heads of the edges.
+             *  @param[in] numEdges The number of edges.*/
+            void Push( const unsigned int* tails, const unsigned int* heads, const size_t numEdges );
+
+            /** @brief Pushes all the edges read by an edge reader.
+             *  @param[in] reader The reader.*/
+            void Push( EdgeReader& reader );
+
+            /** @brief Pushes all the edges received by an edge server.
+             *  @param[in] server The server.*/
+            void Push( EdgeServer& server );
+
+            /** @brief Gets the number of nodes currently in the graph, which is the size the arrays of Assignments need.
+             *  @return The number of nodes.*/
+            size_t NumNodes() const;
+
+            /** @brief Gets the community of every node currently in the graph, once the pending batch is processed.
+             *  @param[out] nodes Where the original ids of the nodes are stored.
+             *  @param[out] communities Where the labels of their communities are stored.
+             *  @param[in] maxNodes The size of the arrays.
+             *  @return The number of nodes stored.*/
+            size_t Assignments( unsigned int* nodes, unsigned int* communities, const size_t maxNodes );
+
+            /** @brief Gets the part of every node currently in the graph, once the detector is flushed, see Flush.
+             *  @param[out] nodes Where the original ids of the nodes are stored.
+             *  @param[out] parts Where their parts are stored.
+             *  @param[in] maxNodes The size of the arrays.
+             *  @return The number of nodes stored.*/
+            size_t Partitions( unsigned int* nodes, int* parts, const size_t maxNodes );
+
+            /** @brief Refines the communities over the retained edges, once the pending batch is processed, see CommunityStructure::Refine.
+             *  @param[in] timeBudget The maximum time to spend, in seconds.
+             *  @param[in] numThreads The number of threads evaluating moves.
+             *  @return The outcome of the refinement.*/
+            CommunityStructure::RefineStats Refine( const double timeBudget, const int numThreads );
+
+            /** @brief Processes the edges waiting in the current batch and assigns the nodes still pending in the
+             *  partitioner, so the statistics of the graph, the structure and the partitioner cover every edge
+             *  pushed so far. Meant to be called once the stream ends, before reading them.*/
+            void Flush();
+
+            /** @brief Processes the pending edges, writes the communities if there is a writer and frees all the resources.*/
+            void Close();
+
+        private:
+            StreamGraph         m_Graph;            /**< @brief The graph the edges are pushed into.*/
+            CommunityStructure  m_Structure;        /**< @brief The communities of the nodes of the graph.*/
+            StreamPartitioner   m_Partitioner;      /**< @brief The parts of the nodes of the graph.*/
+            bool                m_Initialized;      /**< @brief Whether Initialize succeeded and Close was not called yet.*/
+    };
+}
+
+#endif
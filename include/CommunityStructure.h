@@ -17,17 +17,330 @@
 
 #include "Types.h"
 #include "StreamGraph.h"
+#include "Community.h"
+#include "CommunityWriter.h"
+#include <vector>
 
 namespace flowing {
+
+#define FLOWING_REFINE_MAX_CANDIDATES 16
+#define FLOWING_REFINE_CHECK_INTERVAL 64
+#define FLOWING_REFINE_MAX_ROUNDS 100
+#define FLOWING_MERGE_EVIDENCE 2
+#define FLOWING_RECLAIM_COMPACT_MIN 4096
+
+    /** @brief Keeps the community each node of a StreamGraph belongs to while the edges stream in.
+     *  Nodes that have never been merged with another node are singleton communities, and they are
+     *  only represented by a NULL node data plus their external degree. Real communities are created
+     *  from a CommunityPool on the first merge and returned to it once they become empty.
+     *
+     *  Whole communities can also be merged when enough edges arrive between them. A merge only
+     *  combines their degrees and links the absorbed community to the other one, union-find style, so
+     *  the community of a node is found by following the links from its node data. The members of the
+     *  absorbed communities are moved into the set of the surviving one lazily, by Reconcile, before
+     *  the members are iterated.
+     *
+     *  The static methods are meant to be passed as the StreamGraph callbacks, with the structure
+     *  attached to the graph through StreamGraph::SetUserData.*/
     class CommunityStructure {
         public:
             CommunityStructure( StreamGraph* graph );
             ~CommunityStructure();
 
+            /** @brief StreamGraph insert callback.*/
+            static void InsertEdges( StreamGraph* graph, Edge* edges, int numEdges );
+
+            /** @brief StreamGraph remove callback.*/
+            static void RemoveEdges( StreamGraph* graph, Edge* edges, int numEdges );
+
+            /** @brief StreamGraph node data allocation callback.*/
+            static void* NodeDataAllocate( StreamGraph* graph, unsigned int nodeId );
+
+            /** @brief StreamGraph node data free callback. Writes the community of the node to the
+             *  output the first time one of its members is freed, or holds it back for Flush once nodes
+             *  have been reclaimed.*/
+            static void NodeDataFree( StreamGraph* graph, unsigned int nodeId, void* nodeData );
+
+            /** @brief Node reclamation callback of the StreamGraph. Lets a singleton go and remembers its final
+             *  label. A node in a community is only let go once all the members have no edges left, in which
+             *  case the whole community is remembered under one label and freed, and the other members are
+             *  handed to the graph too. The labels are written by Flush.
+             *  @param[in] graph The graph.
+             *  @param[in] nodeId The node without edges.
+             *  @param[in] nodeData The node data of the node.
+             *  @return true if the node can be reclaimed.*/
+            static bool NodeReclaim( StreamGraph* graph, unsigned int nodeId, void* nodeData );
+
+            /** @brief Neighbour label callback of the StreamGraph, see StreamGraph::SetNeighborLabels. With it
+             *  the moves are scored from the counts of the neighbours in each community instead of scanning
+             *  the adjacencies, and the structure keeps the labels up to date as the nodes move.
+             *  @param[in] graph The graph.
+             *  @param[in] nodeId The node.
+             *  @return The key of the community of the node.*/
+            static unsigned long long NodeLabel( const StreamGraph* graph, unsigned int nodeId );
+
+            /** @brief Node data memory accounting callback of the StreamGraph.
+             *  @param[in] graph The graph.
+             *  @param[in,out] usage Where the bytes of the communities and the sketch are added.*/
+            static void NodeDataUsage( const StreamGraph* graph, MemoryUsage& usage );
+
+            /** @brief Sets up the state of a new node, see NodeDataAllocate. Meant for callbacks that
+             *  combine the structure with other consumers of the graph.
+             *  @param[in] nodeId The node.
+             *  @return The node data of the node.*/
+            void* AllocateNode( unsigned int nodeId );
+
+            /** @brief Writes out a node that leaves the graph when it is closed, see NodeDataFree.
+             *  @param[in] nodeId The node.*/
+            void FreeNode( unsigned int nodeId );
+
+            /** @brief Reclaims a node without edges, see NodeReclaim.
+             *  @param[in] nodeId The node.
+             *  @return true if the node can be reclaimed.*/
+            bool Reclaim( unsigned int nodeId );
+
+            /** @brief Writes the communities held back because nodes were reclaimed, once per node. A node
+             *  that came back after being reclaimed is written with its live community, unless most of that
+             *  community came back from the same reclaimed one, which it then rejoins. A node alone in its
+             *  community rejoins the one it was reclaimed with. Must be called once the graph is closed.*/
+            void Flush();
+
+            /** @brief Makes the scores account for the edges evicted from the graph, using the total degree of the
+             *  nodes and an optional count-min sketch of the edges between nodes and communities. The
+             *  community degrees are then never decremented on eviction. Must be called before any edge is pushed.
+             *  @param[in] width The number of counters of each row of the sketch. 0 only uses the degrees.
+             *  @param[in] depth The number of rows of the sketch.*/
+            void EnableFullDegree( const unsigned int width = FLOWING_SKETCH_WIDTH, const unsigned int depth = FLOWING_SKETCH_DEPTH );
+
+            /** @brief Counts the triangles closed by the inserted edges, per node and per community. Must be
+             *  called before any edge is pushed.
+             *  @param[in] scoring Whether the scores of the communities use the triangles.*/
+            void EnableTriangles( const bool scoring );
+
+            /** @brief Merges two communities when an edge arrives between them, the communities have shared
+             *  most of their recent external edges and the merged community scores better than the two apart,
+             *  weighted by their sizes. Must be called before any edge is pushed.
+             *  @param[in] evidence The number of edges that have to be seen between the communities, net of the
+             *  edges seen with other communities, before the merge is scored. 0 disables the merges.*/
+            void EnableMerging( const int evidence = FLOWING_MERGE_EVIDENCE );
+
+            /** @brief Gets the number of merges of communities.
+             *  @return The number of merges.*/
+            unsigned long long NumMerges() const;
+
+            /** @brief Moves the members of the communities merged into a community into its own set, so they
+             *  can be iterated. The absorbed communities go back to the pool.
+             *  @param[in] community The community, which must not have been merged into another one.*/
+            void Reconcile( Community* community );
+
+            /** @brief Gets the triangle counter, to read its statistics.
+             *  @return The triangle counter.*/
+            const TriangleCounter& Triangles() const;
+
+            /** @brief Adds the memory used by the communities and the sketch.
+             *  @param[in,out] usage Where the bytes are added.*/
+            void AddMemoryUsage( MemoryUsage& usage ) const;
+
+            /** @brief Sets the writer the communities are written to when the graph is closed.
+             *  @param[in] writer The writer.*/
+            void SetWriter( CommunityWriter* writer );
+
+            /** @brief Processes inserted edges, moving their endpoints between communities when it improves the score.
+             *  @param[in] edges The inserted edges.
+             *  @param[in] numEdges The number of inserted edges.*/
+            void Insert( const Edge* edges, int numEdges );
+
+            /** @brief Processes removed edges.
+             *  @param[in] edges The removed edges.
+             *  @param[in] numEdges The number of removed edges.*/
+            void Remove( const Edge* edges, int numEdges );
+
+            /** @brief Gets the community of a node.
+             *  @param[in] nodeId The node.
+             *  @return The community of the node. NULL if the node is a singleton.*/
+            Community* GetCommunity( unsigned int nodeId ) const;
+
+            /** @brief Gets a key identifying the community of a node, including singletons, see Community::Label.
+             *  @param[in] nodeId The node.
+             *  @return The key of the community.*/
+            unsigned long long CommunityKey( unsigned int nodeId ) const;
+
+            /** @brief Gets the score of the community of a node.
+             *  @param[in] nodeId The node.
+             *  @return The score of its community.*/
+            double Score( unsigned int nodeId ) const;
+
+            /** @brief Tests the score of the community of a node if the node is removed from it.
+             *  @param[in] nodeId The node to remove.
+             *  @return The score of its community without the node.*/
+            double TestRemove( unsigned int nodeId ) const;
+
+            /** @brief Tests the score of the community of a node if another node is inserted into it.
+             *  @param[in] target The node whose community receives the node.
+             *  @param[in] nodeId The node to insert.
+             *  @return The score of the community of target with the node.*/
+            double TestInsert( unsigned int target, unsigned int nodeId ) const;
+
+            /** @brief Moves a node into the community of another node.
+             *  @param[in] nodeId The node to move.
+             *  @param[in] target The node whose community receives the node.*/
+            void Move( unsigned int nodeId, unsigned int target );
+
+            /** @brief Gets the number of communities materialized.
+             *  @return The number of communities with more than one node or internal edges.*/
+            int NumCommunities() const;
+
+            /** @brief The outcome of a refinement.*/
+            struct RefineStats {
+                int     m_NumRounds;        /**< @brief The number of rounds run.*/
+                int     m_NumMoves;         /**< @brief The number of nodes moved.*/
+                int     m_NumConflicts;     /**< @brief The number of moves discarded because of conflicts.*/
+                double  m_Seconds;          /**< @brief The time spent.*/
+            };
+
+            /** @brief Refines the communities over the edges retained by the graph. Each round evaluates
+             *  the best move of every node in parallel against the current communities, and then applies
+             *  the moves sequentially, best first, skipping any move whose source or destination community
+             *  was already changed in the round. Rounds are run until no move improves the score, the
+             *  maximum number of rounds is reached or the time budget runs out.
+             *  @param[in] timeBudget The maximum time to spend, in seconds.
+             *  @param[in] numThreads The number of threads evaluating moves.
+             *  @param[in] maxRounds The maximum number of rounds.
+             *  @return The outcome of the refinement.*/
+            RefineStats Refine( const double timeBudget, const int numThreads, const int maxRounds );
+
         private:
-            const StreamGraph*    m_Graph;    /**< @brief The graph to compute the community structure from.*/
+
+            /** @brief A candidate move of a node into the community of another node.*/
+            struct MoveCandidate {
+                unsigned int    m_Node;     /**< @brief The node to move.*/
+                unsigned int    m_Target;   /**< @brief The node whose community receives the node.*/
+                double          m_Gain;     /**< @brief The improvement of the score.*/
+            };
+
+            /** @brief Finds the move of a node that improves the score the most.
+             *  @param[in] nodeId The node.
+             *  @param[in] neighbors A scratch buffer for the adjacencies of the node.
+             *  @param[out] move The best move.
+             *  @return true if a move improves the score.*/
+            bool BestMove( unsigned int nodeId, UVector& neighbors, MoveCandidate& move ) const;
+
+            /** @brief Evaluates the best moves of a range of nodes.
+             *  @param[in] first The first node.
+             *  @param[in] step The distance between the evaluated nodes.
+             *  @param[in] deadline The time at which to stop, as returned by Now.
+             *  @param[out] moves Where the moves are stored.*/
+            void EvaluateMoves( unsigned int first, unsigned int step, double deadline, std::vector<MoveCandidate>* moves ) const;
+
+            /** @brief Gets the id of the community of a node, as used by the sketch.
+             *  @param[in] nodeId The node.
+             *  @return The id of the community, which is the node itself for singletons.*/
+            unsigned int CommunityId( unsigned int nodeId ) const;
+
+            /** @brief Gets the current time in seconds.*/
+            static double Now();
+
+            /** @brief Gets the community of a node, materializing it if the node is a singleton.
+             *  @param[in] nodeId The node.
+             *  @return The community of the node.*/
+            Community* Materialize( unsigned int nodeId );
+
+            /** @brief Releases a community that has lost a node. Empty communities go back to the pool,
+             *  and communities left with a single node and no internal edges become implicit again.
+             *  @param[in] community The community.*/
+            void Release( Community* community );
+
+            /** @brief Signals an edge between two different communities.
+             *  @param[in] nodeId The endpoint of the edge.
+             *  @param[in] community The community of the endpoint.
+             *  @param[in] delta The weight of an inserted edge, or minus the weight of a removed one.*/
+            void SignalExternalEdge( unsigned int nodeId, Community* community, int delta );
+
+            /** @brief Counts the triangles closed by an inserted edge and signals them to the communities of their nodes.
+             *  @param[in] tail The tail of the edge.
+             *  @param[in] head The head of the edge.
+             *  @param[in] weight The weight of the edge.*/
+            void CountTriangles( unsigned int tail, unsigned int head, unsigned int weight );
+
+            /** @brief Merges two communities if the merged community scores better than the two apart. Only the
+             *  members of the smaller one are scanned, through the neighbour counts when they are enabled and
+             *  their adjacencies otherwise, so a merge costs as much as the smaller side rather than constant
+             *  time, and each node is scanned a logarithmic number of times over the merges it goes through.
+             *  @param[in] first A community.
+             *  @param[in] second Another community.
+             *  @return true if they were merged.*/
+            bool TryMerge( Community* first, Community* second );
+
+            /** @brief Counts the retained edges between the members of a community and another community.
+             *  @param[in] community The community whose members are scanned, including the absorbed ones.
+             *  @param[in] other The other community.
+             *  @param[in] bound An upper bound of the cut, where the scan stops unless the sketch corrects the counts.
+             *  @return The weight of the edges, with each edge weighing what its page does.*/
+            int CountCut( const Community* community, const Community* other, const int bound );
+
+            /** @brief Moves the members of a community about to be merged into another one to the label of the
+             *  other one in the neighbour counts of the graph, and to its id in the sketch.
+             *  @param[in] community The community whose members are relabeled, including the absorbed ones.
+             *  @param[in] other The community it is merged into.*/
+            void RelabelMembers( const Community* community, const Community* other );
+
+            /** @brief Moves the retained edges of a node that changed community to its new id in the sketch of
+             *  its neighbours, so only the evicted edges keep the id they had when they arrived.
+             *  @param[in] nodeId The node.
+             *  @param[in] oldId The id of the community it was in.
+             *  @param[in] newId The id of the community it is in now.*/
+            void RekeySketch( unsigned int nodeId, unsigned int oldId, unsigned int newId );
+
+            /** @brief Writes the community of a node if the node is its smallest member.
+             *  @param[in] nodeId The node.*/
+            void Write( unsigned int nodeId );
+
+            /** @brief Writes all the members of a community.
+             *  @param[in] community The community.*/
+            void WriteMembers( const Community* community );
+
+            /** @brief Remembers the label a node is reclaimed with, see Flush.
+             *  @param[in] nodeId The node.
+             *  @param[in] label The label of its community.*/
+            void Retire( unsigned int nodeId, unsigned int label );
+
+            /** @brief Keeps only the last label of each reclaimed node, sorted by node.*/
+            void CompactReclaimed();
+
+            /** @brief A node written out by Flush, with the label of its community.*/
+            struct LabeledNode {
+                unsigned int        m_Node;     /**< @brief The external id of the node.*/
+                unsigned int        m_Label;    /**< @brief The label of its community.*/
+            };
+
+            /** @brief A node still in the graph when it is closed, held back for Flush.*/
+            struct LiveNode {
+                unsigned long long  m_Key;      /**< @brief The community of the node, above the reclaimed labels.*/
+                unsigned int        m_Node;     /**< @brief The external id of the node.*/
+                unsigned int        m_Label;    /**< @brief The label it was last reclaimed with, ~0U if never.*/
+            };
+
+            StreamGraph*        m_Graph;            /**< @brief The graph to compute the community structure from.*/
+            DegreeSketch        m_Sketch;           /**< @brief The summaries of the evicted edges.*/
+            TriangleCounter     m_Triangles;        /**< @brief The triangles closed by the inserted edges.*/
+            CommunityPool       m_Pool;             /**< @brief The pool the communities are allocated from.*/
+            std::vector<int>    m_SingletonKout;    /**< @brief The external degree of each node while it is a singleton.*/
+            size_t              m_NumMembers;       /**< @brief The number of nodes that belong to a materialized community.*/
+            std::vector<bool>   m_Written;          /**< @brief Whether each node has already been written with a reclaimed community.*/
+            CommunityWriter*    m_Writer;           /**< @brief Where the communities are written.*/
+            std::vector<LabeledNode> m_Reclaimed;   /**< @brief The label of each reclaimed node. Only the last record of a node counts until compacted.*/
+            size_t              m_NumCompacted;     /**< @brief The number of records left by the last compaction.*/
+            unsigned int        m_NumLabels;        /**< @brief The number of labels given to reclaimed communities.*/
+            std::vector<LiveNode> m_Live;           /**< @brief The nodes freed when the graph is closed, once nodes were reclaimed.*/
+            int                 m_MergeEvidence;    /**< @brief The evidence needed to score a merge. 0 if merges are disabled.*/
+            unsigned long long  m_NumMerges;        /**< @brief The number of merges.*/
+            int                 m_NumAbsorbed;      /**< @brief The number of absorbed communities not reconciled yet.*/
+            std::vector<const Community*> m_Pending;/**< @brief Scratch stack of the communities to visit.*/
+            UVector             m_CutNeighbors;     /**< @brief Scratch buffer for the adjacencies of the scanned members.*/
+            UVector             m_CutWeights;       /**< @brief Scratch buffer for the weights of the adjacencies of the scanned members.*/
+            UVector             m_RekeyNeighbors;   /**< @brief Scratch buffer for the adjacencies of a node moved in the sketch.*/
+            UVector             m_RekeyWeights;     /**< @brief Scratch buffer for the weights of the adjacencies of a node moved in the sketch.*/
     };
 }
 
 #endif
-
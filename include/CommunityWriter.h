@@ -0,0 +1,117 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMUNITY_WRITER_H
+#define COMMUNITY_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flowing {
+
+#define FLOWING_WRITER_BUFFER_SIZE (4*1024*1024)
+#define FLOWING_WRITER_NUM_BUFFERS 4
+#define FLOWING_BINARY_MAGIC 0x57434c46     /* "FLCW" */
+#define FLOWING_BINARY_VERSION 1
+
+    /** @brief Writes communities to a file through large buffers, optionally handing the full
+     *  buffers to a background thread that performs the actual writes.
+     *
+     *  Two formats are supported. TEXT writes one community per line, with the members separated
+     *  by spaces. BINARY writes a header with FLOWING_BINARY_MAGIC and FLOWING_BINARY_VERSION as
+     *  two 32 bit integers, followed by a (node, community) pair of 32 bit integers per node, where
+     *  communities are numbered consecutively from 0 in the order they are written. All integers
+     *  are in the byte order of the host.*/
+    class CommunityWriter {
+        public:
+
+            enum Format {
+                TEXT,
+                BINARY
+            };
+
+            /** @param[in] bufferSize The size of each buffer in bytes.*/
+            CommunityWriter( const int bufferSize = FLOWING_WRITER_BUFFER_SIZE );
+            ~CommunityWriter();
+
+            /** @brief Opens the file to write to.
+              @param[in] path The path of the file.
+              @param[in] format The format to write.
+              @param[in] background Whether the writes are performed by a background thread.
+              @return true if the file was opened.*/
+            bool Open( const char* path, const Format format, const bool background );
+
+            /** @brief Flushes the pending data, waits for the background thread and closes the file.
+              @return true if all the data was written.*/
+            bool Close();
+
+            /** @brief Starts a new community.*/
+            void BeginCommunity();
+
+            /** @brief Adds a node to the current community.
+              @param[in] node The node to add.*/
+            void Add( const unsigned int node );
+
+            /** @brief Finishes the current community.*/
+            void EndCommunity();
+
+            /** @brief Gets the number of communities written.
+             *  @return The number of communities.*/
+            unsigned int NumCommunities() const;
+
+        private:
+
+            /** @brief Makes sure the current buffer has room for a number of bytes.
+              @param[in] size The number of bytes.*/
+            void Reserve( const int size );
+
+            /** @brief Hands the current buffer to be written and gets an empty one.*/
+            void Flush();
+
+            /** @brief Writes a buffer to the file.
+              @param[in] buffer The buffer.
+              @param[in] size The number of bytes to write.*/
+            void WriteBuffer( const char* buffer, const int size );
+
+            /** @brief The loop run by the background thread.*/
+            void Run();
+
+            /** @brief A buffer with the number of bytes used.*/
+            struct Buffer {
+                char*   m_Data;     /**< @brief The data of the buffer.*/
+                int     m_Size;     /**< @brief The number of bytes used.*/
+            };
+
+            int                         m_File;             /**< @brief The file descriptor.*/
+            Format                      m_Format;           /**< @brief The format to write.*/
+            const int                   m_BufferSize;       /**< @brief The size of each buffer in bytes.*/
+            Buffer                      m_Current;          /**< @brief The buffer being filled.*/
+            unsigned int                m_NumCommunities;   /**< @brief The number of communities started.*/
+            unsigned int                m_NumMembers;       /**< @brief The number of members of the current community.*/
+            bool                        m_Failed;           /**< @brief Whether a write failed.*/
+            bool                        m_Background;       /**< @brief Whether a background thread performs the writes.*/
+            bool                        m_Done;             /**< @brief Tells the background thread to finish.*/
+            std::vector<char*>          m_Allocated;        /**< @brief All the buffers allocated.*/
+            std::vector<Buffer>         m_Free;             /**< @brief The empty buffers.*/
+            std::deque<Buffer>          m_Full;             /**< @brief The buffers waiting to be written.*/
+            std::mutex                  m_Mutex;            /**< @brief Protects the buffer queues.*/
+            std::condition_variable     m_Condition;        /**< @brief Signals changes in the buffer queues.*/
+            std::thread                 m_Thread;           /**< @brief The background writer thread.*/
+    };
+}
+
+#endif
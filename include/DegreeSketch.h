@@ -0,0 +1,102 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEGREE_SKETCH_H
+#define DEGREE_SKETCH_H
+
+#include "StreamGraph.h"
+#include <cstddef>
+#include <vector>
+
+namespace flowing {
+
+#define FLOWING_SKETCH_WIDTH (1 << 20)
+#define FLOWING_SKETCH_DEPTH 4
+
+    /** @brief Summarizes the full history of the stream so community scoring can account for the
+     *  edges evicted from the BufferPool. It combines the total degree of each node, kept by the
+     *  StreamGraph, with an optional count-min sketch of the number of edges between each node and
+     *  each community. An edge is counted with the id of the community of its other end when it
+     *  arrives, and the owner moves it to the new id with Uncount and Count whenever that end changes
+     *  community while the edge is retained. The evicted edges keep the id they had when they left,
+     *  which goes stale as their nodes keep moving. Neither summary is ever decremented on eviction.*/
+    class DegreeSketch {
+        public:
+            /** @param[in] graph The graph whose degrees are used.*/
+            DegreeSketch( const StreamGraph* graph );
+            ~DegreeSketch();
+
+            /** @brief Enables or disables full degree scoring.
+             *  @param[in] enabled Whether the scores account for the evicted edges.
+             *  @param[in] width The number of counters of each row of the sketch, rounded up to a power of two. 0 disables the sketch.
+             *  @param[in] depth The number of rows of the sketch.*/
+            void Configure( const bool enabled, const unsigned int width = FLOWING_SKETCH_WIDTH, const unsigned int depth = FLOWING_SKETCH_DEPTH );
+
+            /** @brief Tells if full degree scoring is enabled.
+             *  @return true if the scores account for the evicted edges.*/
+            bool Enabled() const;
+
+            /** @brief Counts an edge between a node and a community.
+             *  @param[in] node The node.
+             *  @param[in] community The id of the community of the other endpoint.
+             *  @param[in] weight The number of edges it stands for.*/
+            void Count( const unsigned int node, const unsigned int community, const unsigned int weight = 1 );
+
+            /** @brief Takes back edges counted between a node and a community, to count them with another one.
+             *  @param[in] node The node.
+             *  @param[in] community The id the edges were counted with.
+             *  @param[in] weight The number of edges, which must have been counted.*/
+            void Uncount( const unsigned int node, const unsigned int community, const unsigned int weight = 1 );
+
+            /** @brief Tells if the count-min sketch is kept, besides the degrees.
+             *  @return true if edges are counted.*/
+            bool Counting() const;
+
+            /** @brief Estimates the number of edges seen between a node and a community. Never underestimates.
+             *  @param[in] node The node.
+             *  @param[in] community The id of the community.
+             *  @return The estimated number of edges.*/
+            unsigned int Estimate( const unsigned int node, const unsigned int community ) const;
+
+            /** @brief Combines the adjacencies of a node retained in memory with the summaries.
+             *  @param[in] node The node.
+             *  @param[in] community The id of the community being scored.
+             *  @param[in] retainedKin The retained adjacencies of the node inside the community.
+             *  @param[in] retainedDegree The retained adjacencies of the node.
+             *  @param[out] nodeKin The estimated number of edges of the node inside the community.
+             *  @param[out] nodeKout The estimated number of edges of the node outside the community.*/
+            void Combine( const unsigned int node, const unsigned int community, const int retainedKin, const int retainedDegree, int& nodeKin, int& nodeKout ) const;
+
+            /** @brief Gets the memory used by the sketch.
+             *  @return The size of the sketch in bytes.*/
+            size_t Bytes() const;
+
+        private:
+            /** @brief Gets the counter of a row for a key.
+             *  @param[in] row The row.
+             *  @param[in] key The key.
+             *  @return The index of the counter.*/
+            size_t Index( const unsigned int row, const unsigned long long key ) const;
+
+            const StreamGraph*          m_Graph;        /**< @brief The graph whose degrees are used.*/
+            bool                        m_Enabled;      /**< @brief Whether full degree scoring is enabled.*/
+            unsigned int                m_Width;        /**< @brief The number of counters per row.*/
+            unsigned int                m_WidthBits;    /**< @brief The log2 of the number of counters per row.*/
+            unsigned int                m_Depth;        /**< @brief The number of rows.*/
+            std::vector<unsigned int>   m_Counters;     /**< @brief The counters, row after row.*/
+            std::vector<unsigned long long> m_Seeds;    /**< @brief The hash seed of each row.*/
+    };
+}
+
+#endif
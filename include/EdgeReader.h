@@ -0,0 +1,200 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDGE_READER_H
+#define EDGE_READER_H
+
+#include "Types.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flowing {
+
+#define FLOWING_READER_BLOCK_SIZE (1024*1024)
+#define FLOWING_READER_NUM_BLOCKS 8
+
+    /** @brief Reads edges from a file, optionally compressed with gzip or zstd. The file is read
+     *  and decompressed by a background thread, which hands fixed-size blocks of raw data to the
+     *  parser through a ring buffer, so decompression overlaps with the processing of the edges.
+     *
+     *  In TEXT format the file holds whitespace separated (tail, head) pairs of unsigned integers,
+     *  and lines starting with '#' or '%' are skipped. In BINARY format it holds (tail, head)
+     *  pairs of 32 bit unsigned integers in the byte order of the host.*/
+    class EdgeReader {
+        public:
+
+            enum Format {
+                TEXT,
+                BINARY
+            };
+
+            enum Compression {
+                AUTO,       /**< @brief Detect the compression from the magic number of the file.*/
+                NONE,
+                GZIP,
+                ZSTD
+            };
+
+            /** @param[in] blockSize The size of the blocks of the ring buffer in bytes.
+             *  @param[in] numBlocks The number of blocks of the ring buffer.*/
+            EdgeReader( const int blockSize = FLOWING_READER_BLOCK_SIZE, const int numBlocks = FLOWING_READER_NUM_BLOCKS );
+            ~EdgeReader();
+
+            /** @brief Opens a file and starts decompressing it.
+              @param[in] path The path of the file. "-" reads from the standard input.
+              @param[in] format The format of the edges.
+              @param[in] compression The compression of the file.
+              @return true if the file was opened and its compression is supported.*/
+            bool Open( const char* path, const Format format, const Compression compression = AUTO );
+
+            /** @brief Stops the background thread and closes the file.*/
+            void Close();
+
+            /** @brief Reads the next edges.
+              @param[out] edges Where the edges are stored.
+              @param[in] maxEdges The maximum number of edges to read.
+              @return The number of edges read. 0 when the end of the file is reached.*/
+            int Read( Edge* edges, const int maxEdges );
+
+            /** @brief Tells if reading, decompressing or parsing the file failed. A text file fails to parse
+             *  when it has anything but whitespace between the numbers outside the comment lines, a number
+             *  that does not fit in 32 bits, or a line that holds other than zero or two numbers. A binary
+             *  file fails when its size is not a whole number of edges.
+             *  @return true if there was an error.*/
+            bool Failed() const;
+
+            /** @brief Gets the line where parsing a text file failed.
+             *  @return The line, counting from 1, or 0 if parsing did not fail.*/
+            unsigned long long MalformedLine() const;
+
+            /** @brief Tells if a binary file ended in the middle of an edge, whose bytes were dropped.
+             *  @return true if the file was truncated.*/
+            bool Truncated() const;
+
+            /** @brief Gets the number of decompressed blocks waiting to be parsed, which grows when the
+             *  edges are consumed slower than the file is read.
+             *  @return The number of blocks, at most the number of blocks of the ring.*/
+            int QueueDepth() const;
+
+            /** @brief Tells if a compression is supported by this build.
+              @param[in] compression The compression.
+              @return true if the compression is supported.*/
+            static bool Supports( const Compression compression );
+
+            /** @brief Parses a single line of a text file, following the same rules as Read.
+              @param[in] line The line, without its line break.
+              @param[out] edge Where the edge is stored if the line holds one.
+              @return 1 if the line holds an edge, 0 if it is empty or a comment and -1 if it is malformed.*/
+            static int ParseLine( const char* line, Edge& edge );
+
+        private:
+
+            /** @brief The loop run by the background thread.*/
+            void Run();
+
+            /** @brief Reads raw bytes from the file, serving first the bytes used to detect the compression.
+              @param[out] buffer Where the bytes are stored.
+              @param[in] size The maximum number of bytes to read.
+              @return The number of bytes read, 0 at the end of the file and -1 on error.*/
+            int ReadRaw( char* buffer, const int size );
+
+            /** @brief Fills a block with decompressed data.
+              @param[out] block The block to fill.
+              @return The number of bytes stored, 0 at the end of the file and -1 on error.*/
+            int Fill( char* block );
+
+            /** @brief Fills a block reading the file as is.*/
+            int FillNone( char* block );
+
+            /** @brief Fills a block decompressing a gzip file.*/
+            int FillGzip( char* block );
+
+            /** @brief Fills a block decompressing a zstd file.*/
+            int FillZstd( char* block );
+
+            /** @brief Parses text edges from the current block.
+              @param[out] edges Where the edges are stored.
+              @param[in] maxEdges The maximum number of edges to parse.
+              @return The number of edges parsed.*/
+            int ParseText( Edge* edges, const int maxEdges );
+
+            /** @brief Parses binary edges from the current block.
+              @param[out] edges Where the edges are stored.
+              @param[in] maxEdges The maximum number of edges to parse.
+              @return The number of edges parsed.*/
+            int ParseBinary( Edge* edges, const int maxEdges );
+
+            /** @brief Parses a number that was completed, and stops parsing if it is the third of its line.
+              @param[out] edges Where the edge is stored if the number completes one.
+              @return 1 if an edge was completed, 0 otherwise.*/
+            int EndNumber( Edge* edges );
+
+            /** @brief Stops parsing at a malformed line, which makes Failed return true and Read return 0.*/
+            void SetMalformed();
+
+            /** @brief Makes the next full block the current one.
+              @return false if there are no more blocks.*/
+            bool AcquireBlock();
+
+            /** @brief Returns the current block to the decompression thread.*/
+            void ReleaseBlock();
+
+            int                         m_File;             /**< @brief The file descriptor.*/
+            bool                        m_OwnsFile;         /**< @brief Whether the file descriptor has to be closed.*/
+            Format                      m_Format;           /**< @brief The format of the edges.*/
+            Compression                 m_Compression;      /**< @brief The compression of the file.*/
+            const int                   m_BlockSize;        /**< @brief The size of the blocks in bytes.*/
+            const int                   m_NumBlocks;        /**< @brief The number of blocks of the ring.*/
+            std::vector<char*>          m_Blocks;           /**< @brief The blocks of the ring.*/
+            std::vector<int>            m_BlockSizes;       /**< @brief The number of bytes stored in each block.*/
+            int                         m_NumFull;          /**< @brief The number of blocks ready to be parsed.*/
+            int                         m_ReadBlock;        /**< @brief The next block to parse.*/
+            int                         m_WriteBlock;       /**< @brief The next block to fill.*/
+            bool                        m_End;              /**< @brief Whether the decompression thread reached the end of the file.*/
+            bool                        m_Stop;             /**< @brief Tells the decompression thread to stop.*/
+            bool                        m_Failed;           /**< @brief Whether reading or decompressing failed.*/
+            mutable std::mutex          m_Mutex;            /**< @brief Protects the ring.*/
+            std::condition_variable     m_Condition;        /**< @brief Signals changes in the ring.*/
+            std::thread                 m_Thread;           /**< @brief The decompression thread.*/
+
+            char                        m_Magic[4];         /**< @brief The first bytes of the file, read to detect the compression.*/
+            int                         m_MagicSize;        /**< @brief The number of bytes in m_Magic.*/
+            int                         m_MagicPosition;    /**< @brief The next byte of m_Magic to serve.*/
+            char*                       m_Input;            /**< @brief The compressed input buffer.*/
+            int                         m_InputSize;        /**< @brief The number of bytes in the compressed input buffer.*/
+            int                         m_InputPosition;    /**< @brief The next byte to decompress from the input buffer.*/
+            bool                        m_InputEnd;         /**< @brief Whether the end of the compressed file was reached.*/
+            bool                        m_InFrame;          /**< @brief Whether the decompressor is in the middle of a compressed frame.*/
+            void*                       m_Stream;           /**< @brief The state of the decompressor.*/
+
+            bool                        m_HasBlock;         /**< @brief Whether the parser holds a block.*/
+            int                         m_Position;         /**< @brief The next byte to parse in the current block.*/
+            unsigned int                m_Number;           /**< @brief The number being parsed.*/
+            bool                        m_InNumber;         /**< @brief Whether a number is being parsed.*/
+            bool                        m_InComment;        /**< @brief Whether a comment line is being skipped.*/
+            bool                        m_LineStart;        /**< @brief Whether the parser is at the start of a line.*/
+            bool                        m_HasTail;          /**< @brief Whether the tail of the next edge was parsed.*/
+            bool                        m_HasEdge;          /**< @brief Whether an edge was completed on the line being parsed.*/
+            unsigned long long          m_Line;             /**< @brief The line being parsed, counting from 1.*/
+            unsigned long long          m_MalformedLine;    /**< @brief The line where parsing failed, 0 if it did not.*/
+            unsigned int                m_Tail;             /**< @brief The tail of the next edge.*/
+            unsigned char               m_Partial[sizeof(Edge)];    /**< @brief The bytes of a binary edge split between blocks.*/
+            int                         m_PartialSize;      /**< @brief The number of bytes in m_Partial.*/
+            bool                        m_Truncated;        /**< @brief Whether the file ended in the middle of a binary edge.*/
+    };
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDGE_SAMPLER_H
+#define EDGE_SAMPLER_H
+
+#include <chrono>
+
+namespace flowing {
+
+#define FLOWING_SAMPLER_WINDOW 4096
+#define FLOWING_SAMPLER_MAX_WEIGHT 1024
+#define FLOWING_SAMPLER_HYSTERESIS 1.25
+
+    /** @brief Sheds edges at the front of the StreamGraph when the input arrives faster than it can be
+     *  processed. Each offered edge is kept with probability 1/w, where the weight w is an integer that
+     *  is adapted once every FLOWING_SAMPLER_WINDOW offered edges, so the kept edges can stand for the
+     *  shed ones by counting w times in the community degrees.
+     *
+     *  The weight grows when the offered edges are processed below the target throughput, or when the
+     *  queue of the reader holds more blocks than the target depth, and it shrinks again once both
+     *  targets are comfortably met.*/
+    class EdgeSampler {
+        public:
+            EdgeSampler();
+            ~EdgeSampler();
+
+            /** @brief Sets the targets the weight is adapted to. Sampling is disabled when both are 0.
+             *  @param[in] throughput The minimum number of offered edges processed per second. 0 to ignore it.
+             *  @param[in] queueDepth The maximum number of blocks waiting in the reader. 0 to ignore it.*/
+            void Configure( const double throughput, const int queueDepth );
+
+            /** @brief Tells if sampling is enabled.
+             *  @return true if edges may be shed.*/
+            bool Enabled() const;
+
+            /** @brief Decides whether the next offered edge is kept, adapting the weight at the end of each window.
+             *  @return true if the edge is kept, in which case it counts Weight() times.*/
+            bool Sample();
+
+            /** @brief Records the number of blocks waiting in the reader, used at the end of the window.
+             *  @param[in] queueDepth The number of blocks.*/
+            void ObserveQueueDepth( const int queueDepth );
+
+            /** @brief Gets the current weight of the kept edges.
+             *  @return The inverse of the sampling rate.*/
+            unsigned int Weight() const;
+
+            /** @brief Gets the number of edges offered to the sampler.
+             *  @return The number of edges.*/
+            unsigned long long NumOffered() const;
+
+            /** @brief Gets the number of edges kept.
+             *  @return The number of edges.*/
+            unsigned long long NumKept() const;
+
+            /** @brief Gets the number of edges shed.
+             *  @return The number of edges.*/
+            unsigned long long NumShed() const;
+
+            /** @brief Gets the number of windows in which some edge was shed.
+             *  @return The number of windows.*/
+            unsigned long long NumSheddingWindows() const;
+
+            /** @brief Gets the largest weight used so far.
+             *  @return The weight.*/
+            unsigned int MaxWeight() const;
+
+        private:
+            /** @brief Adapts the weight to the throughput and queue depth of the last window.*/
+            void Adapt();
+
+            double                                  m_Throughput;       /**< @brief The target throughput in edges per second. 0 if there is none.*/
+            int                                     m_QueueDepth;       /**< @brief The target queue depth in blocks. 0 if there is none.*/
+            int                                     m_ObservedDepth;    /**< @brief The last queue depth observed.*/
+            unsigned int                            m_Weight;           /**< @brief The current weight.*/
+            unsigned int                            m_MaxWeight;        /**< @brief The largest weight used.*/
+            unsigned long long                      m_NumOffered;       /**< @brief The number of edges offered.*/
+            unsigned long long                      m_NumKept;          /**< @brief The number of edges kept.*/
+            unsigned long long                      m_NumSheddingWindows; /**< @brief The number of windows with a weight above 1.*/
+            unsigned long long                      m_State;            /**< @brief The state of the random number generator.*/
+            std::chrono::steady_clock::time_point   m_WindowStart;      /**< @brief When the current window started.*/
+    };
+}
+
+#endif
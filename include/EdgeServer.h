@@ -0,0 +1,139 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDGE_SERVER_H
+#define EDGE_SERVER_H
+
+#include "Types.h"
+#include "EdgeReader.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flowing {
+
+#define FLOWING_SERVER_MAX_EVENTS 64
+
+    /** @brief Receives edges from several local producers through a Unix domain socket. Each producer
+     *  connects and writes (tail, head) pairs of 32 bit unsigned integers in the byte order of the host,
+     *  as in the BINARY format of EdgeReader, in batches of any size, and closes the connection when it
+     *  is done. The connections are multiplexed with epoll by a background thread, which receives
+     *  straight into the blocks of a ring that are then handed whole to the consumer, so the edges
+     *  are not copied on their way to the graph.
+     *
+     *  The ring is the only buffer: when all its blocks are waiting to be consumed the background
+     *  thread stops receiving, the socket buffers fill up and the writes of the producers block until
+     *  the consumer catches up. The stream ends once the expected number of producers has connected
+     *  and all of them have closed their connection.*/
+    class EdgeServer {
+        public:
+            /** @param[in] blockSize The size of the blocks of the ring in bytes.
+             *  @param[in] numBlocks The number of blocks of the ring.*/
+            EdgeServer( const int blockSize = FLOWING_READER_BLOCK_SIZE, const int numBlocks = FLOWING_READER_NUM_BLOCKS );
+            ~EdgeServer();
+
+            /** @brief Starts listening on a socket. A stale socket left at the path is replaced.
+              @param[in] path The path of the socket.
+              @param[in] numProducers The number of producers that have to connect before the stream can end.
+              @return true if the socket is listening.*/
+            bool Open( const char* path, const int numProducers = 1 );
+
+            /** @brief Stops the background thread, closes the connections and removes the socket.*/
+            void Close();
+
+            /** @brief Gets the next batch of received edges, releasing the previous one. Blocks until
+             *  edges arrive or the stream ends.
+              @param[out] edges Where the pointer to the edges is stored. They are valid until the next call.
+              @return The number of edges. 0 when the stream ended.*/
+            int Read( const Edge*& edges );
+
+            /** @brief Tells if the server failed while receiving.
+             *  @return true if there was an error.*/
+            bool Failed() const;
+
+            /** @brief Gets the number of blocks waiting to be consumed, which grows when the edges are
+             *  consumed slower than they arrive.
+             *  @return The number of blocks, at most the number of blocks of the ring.*/
+            int QueueDepth() const;
+
+            /** @brief Gets the number of producers that connected.
+             *  @return The number of connections accepted.*/
+            int NumProducers() const;
+
+            /** @brief Gets the number of edges received.
+             *  @return The number of edges.*/
+            unsigned long long NumEdges() const;
+
+            /** @brief Gets the number of times receiving stopped because the ring was full, pushing back on the producers.
+             *  @return The number of stalls.*/
+            unsigned long long NumStalls() const;
+
+            /** @brief Gets the number of bytes dropped because a connection closed in the middle of an edge.
+             *  @return The number of bytes.*/
+            unsigned long long NumDroppedBytes() const;
+
+        private:
+            /** @brief The state of a producer connection.*/
+            struct Connection {
+                int             m_Socket;                   /**< @brief The socket of the connection.*/
+                unsigned char   m_Partial[sizeof(Edge)];    /**< @brief The bytes of an edge split between receives.*/
+                int             m_PartialSize;              /**< @brief The number of bytes in m_Partial.*/
+            };
+
+            /** @brief The loop run by the background thread.*/
+            void Run();
+
+            /** @brief Accepts the pending connections.
+              @return false if accepting failed.*/
+            bool Accept();
+
+            /** @brief Receives from a connection into the next free block, waiting for one if the ring is full.
+              @param[in] connection The connection.
+              @return false if the connection was closed or failed.*/
+            bool Receive( Connection* connection );
+
+            /** @brief Closes a connection.
+              @param[in] connection The connection.*/
+            void Disconnect( Connection* connection );
+
+            std::string                 m_Path;             /**< @brief The path of the socket.*/
+            int                         m_Listener;         /**< @brief The listening socket.*/
+            int                         m_Epoll;            /**< @brief The epoll instance.*/
+            int                         m_Wake;             /**< @brief The eventfd used to wake the background thread up.*/
+            int                         m_NumProducers;     /**< @brief The number of producers expected.*/
+            int                         m_NumAccepted;      /**< @brief The number of connections accepted.*/
+            std::vector<Connection*>    m_Connections;      /**< @brief The open connections.*/
+            const int                   m_BlockSize;        /**< @brief The size of the blocks in edges.*/
+            const int                   m_NumBlocks;        /**< @brief The number of blocks of the ring.*/
+            std::vector<Edge*>          m_Blocks;           /**< @brief The blocks of the ring.*/
+            std::vector<int>            m_BlockSizes;       /**< @brief The number of edges stored in each block.*/
+            int                         m_NumFull;          /**< @brief The number of blocks ready to be consumed, including the one being consumed.*/
+            int                         m_ReadBlock;        /**< @brief The next block to consume.*/
+            int                         m_WriteBlock;       /**< @brief The next block to fill.*/
+            bool                        m_HasBlock;         /**< @brief Whether the consumer holds a block.*/
+            bool                        m_End;              /**< @brief Whether the background thread finished.*/
+            bool                        m_Stop;             /**< @brief Tells the background thread to stop.*/
+            bool                        m_Failed;           /**< @brief Whether receiving failed.*/
+            unsigned long long          m_NumEdges;         /**< @brief The number of edges received.*/
+            unsigned long long          m_NumStalls;        /**< @brief The number of times the ring was full.*/
+            unsigned long long          m_NumDroppedBytes;  /**< @brief The bytes of incomplete edges dropped.*/
+            mutable std::mutex          m_Mutex;            /**< @brief Protects the ring and the counters.*/
+            std::condition_variable     m_Condition;        /**< @brief Signals changes in the ring.*/
+            std::thread                 m_Thread;           /**< @brief The background thread.*/
+    };
+}
+
+#endif
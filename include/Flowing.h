@@ -16,6 +16,20 @@
 
 #ifndef FLOWING_H
 #define FLOWING_H
-#include "StreamGraph.h"
+
+/** @file Flowing.h
+ *  @brief The public header of libflowing. CommunityDetector is the in-process entry point: edges are
+ *  pushed as arrays and the community of every node is read back as arrays. StreamGraph and
+ *  CommunityStructure can be used directly to plug other callbacks into the stream.*/
+
 #include "Types.h"
+#include "StreamGraph.h"
+#include "SharedBufferPool.h"
+#include "EdgeReader.h"
+#include "EdgeServer.h"
+#include "CommunityStructure.h"
+#include "CommunityWriter.h"
+#include "StreamPartitioner.h"
+#include "CommunityDetector.h"
+
 #endif
@@ -0,0 +1,81 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOWING_KERNELS_H
+#define FLOWING_KERNELS_H
+
+#include "Types.h"
+
+namespace flowing {
+
+/** @brief The number of extra entries the output of ScanEdges must have room for, since
+ *  the vectorized kernels store whole registers.*/
+#define FLOWING_SCAN_SLACK 8
+
+    /** @brief The ends of an edge where ScanEdges looks for the node.*/
+    enum ScanMatch {
+        MATCH_TAIL  = 1 << 0,   /**< @brief The edges leaving the node.*/
+        MATCH_HEAD  = 1 << 1,   /**< @brief The edges entering the node.*/
+        MATCH_ANY   = MATCH_TAIL | MATCH_HEAD
+    };
+
+    /** @brief Collects the adjacencies of a node found in an array of edges. An edge is an
+     *  adjacency of the node if the node is at one of the matched ends.
+     *  Uses the widest kernel supported by the cpu.
+     *  @param[in] edges The edges to scan.
+     *  @param[in] numEdges The number of edges to scan.
+     *  @param[in] node The node to collect the adjacencies of.
+     *  @param[in] match A combination of ScanMatch.
+     *  @param[out] out Where the adjacencies are written. Must have room for numEdges + FLOWING_SCAN_SLACK entries.
+     *  @return The number of adjacencies written.*/
+    int ScanEdges( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out );
+
+    /** @brief Portable version of ScanEdges.*/
+    int ScanEdgesScalar( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out );
+
+    /** @brief Collects the values found in two sorted arrays without repeated values.
+     *  Uses the widest kernel supported by the cpu.
+     *  @param[in] a The first array.
+     *  @param[in] numA The number of values of the first array.
+     *  @param[in] b The second array.
+     *  @param[in] numB The number of values of the second array.
+     *  @param[out] out Where the common values are written, in order. Must have room for the size of the smallest array + FLOWING_SCAN_SLACK entries.
+     *  @return The number of common values written.*/
+    int IntersectSorted( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out );
+
+    /** @brief Portable version of IntersectSorted.*/
+    int IntersectSortedScalar( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out );
+
+    /** @brief The implementations of the kernels, from the portable one to the widest.*/
+    enum KernelLevel {
+        KERNEL_SCALAR,  /**< @brief The portable kernels.*/
+        KERNEL_SSE2,    /**< @brief The SSE2 kernels.*/
+        KERNEL_AVX2     /**< @brief The AVX2 kernels.*/
+    };
+
+    /** @brief Tells if the kernels of a level were built and can run on this cpu.
+     *  @param[in] level The level.
+     *  @return true if ScanEdgesWith and IntersectSortedWith can be called with it.*/
+    bool KernelSupported( const KernelLevel level );
+
+    /** @brief ScanEdges with the kernel of a given level, so every level can be checked against the portable one.
+     *  @param[in] level The level, which must be supported.*/
+    int ScanEdgesWith( const KernelLevel level, const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out );
+
+    /** @brief IntersectSorted with the kernel of a given level, so every level can be checked against the portable one.
+     *  @param[in] level The level, which must be supported.*/
+    int IntersectSortedWith( const KernelLevel level, const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out );
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+
+namespace flowing {
+
+/** @brief Estimated size of a node of a std::map or std::set of integers, including its allocation overhead.*/
+#define FLOWING_TREE_NODE_BYTES (4*sizeof(void*) + 16)
+/** @brief Estimated size of a node of a std::list of pointers, including its allocation overhead.*/
+#define FLOWING_LIST_NODE_BYTES (3*sizeof(void*) + 8)
+/** @brief Estimated allocation overhead of a malloc'd block.*/
+#define FLOWING_MALLOC_OVERHEAD 16
+
+    /** @brief The parts of the process whose memory is accounted.*/
+    enum MemorySubsystem {
+        MEMORY_BUFFER_POOL,         /**< @brief The buffers of the BufferPool that have been handed out.*/
+        MEMORY_PAGES,               /**< @brief The page descriptors and the LRU list of pages.*/
+        MEMORY_ADJACENCY_LISTS,     /**< @brief The adjacency lists and their list nodes.*/
+        MEMORY_ID_MAPS,             /**< @brief The maps between external and internal ids.*/
+        MEMORY_NODE_STATE,          /**< @brief The per-node arrays of the graph: node data, degrees, flags.*/
+        MEMORY_SPILL_INDEX,         /**< @brief The index of the spilled segments of each node.*/
+        MEMORY_COMMUNITIES,         /**< @brief The communities, their member sets and the per-node community state.*/
+        MEMORY_SKETCH,              /**< @brief The summaries of the evicted edges.*/
+        MEMORY_TRIANGLES,           /**< @brief The triangle counters and their scratch buffers.*/
+        MEMORY_PARTITIONS,          /**< @brief The part of each node and the loads of the parts.*/
+        MEMORY_NEIGHBOR_COUNTS,     /**< @brief The counts of the adjacencies of each node by the community of the neighbour.*/
+        MEMORY_NUM_SUBSYSTEMS
+    };
+
+    /** @brief The bytes used by each subsystem. The figures are estimates computed from the sizes
+     *  of the structures, so they are cheap to obtain at any time.*/
+    struct MemoryUsage {
+        size_t  m_Bytes[MEMORY_NUM_SUBSYSTEMS];    /**< @brief The bytes used by each subsystem.*/
+
+        MemoryUsage();
+
+        /** @brief Gets the bytes used by all the subsystems.
+         *  @return The total bytes.*/
+        size_t Total() const;
+
+        /** @brief Gets the name of a subsystem, as printed in the metrics.
+         *  @param[in] subsystem The subsystem.
+         *  @return The name of the subsystem.*/
+        static const char* Name( const int subsystem );
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NEIGHBOR_COUNTS_H
+#define NEIGHBOR_COUNTS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace flowing {
+
+    /** @brief Counts, for every node, the weight of its retained adjacencies that carry each label, where the
+     *  label of a node is chosen by the owner, typically the community the node belongs to. The counts
+     *  are kept by the StreamGraph, which increments them when an edge is inserted and decrements them
+     *  when the edge leaves the adjacencies, and relabeling a node moves its adjacencies from one label
+     *  to the other in the counts of its neighbours. An adjacency counts with the weight of its edge, so
+     *  the counts match the weights Neighbors reports. How many neighbours of a node are in a community
+     *  is then a lookup instead of a scan of the adjacencies.
+     *
+     *  The labels of a node are kept in a vector sorted by label, so a lookup is a binary search and
+     *  the memory is proportional to the number of distinct labels around each node.*/
+    class NeighborCounts {
+        public:
+            NeighborCounts();
+            ~NeighborCounts();
+
+            /** @brief Enables or disables the counts. Must be set before any node is added.
+             *  @param[in] enabled Whether the counts are kept.*/
+            void Configure( const bool enabled );
+
+            /** @brief Tells if the counts are kept.
+             *  @return true if they are kept.*/
+            bool Enabled() const;
+
+            /** @brief Makes room for a new node, with no adjacencies.*/
+            void AddNode();
+
+            /** @brief Releases the memory of a node without adjacencies, since internal ids are reused.
+             *  @param[in] node The node.*/
+            void ClearNode( const unsigned int node );
+
+            /** @brief Counts an adjacency of a node to a neighbour with a label.
+             *  @param[in] node The node.
+             *  @param[in] label The label of the neighbour.
+             *  @param[in] weight The weight of the adjacency.*/
+            void Add( const unsigned int node, const unsigned long long label, const unsigned int weight = 1 );
+
+            /** @brief Uncounts an adjacency of a node to a neighbour with a label, which must have been counted.
+             *  @param[in] node The node.
+             *  @param[in] label The label of the neighbour.
+             *  @param[in] weight The weight the adjacency was counted with.*/
+            void Subtract( const unsigned int node, const unsigned long long label, const unsigned int weight = 1 );
+
+            /** @brief Gets the weight of the adjacencies of a node to neighbours with a label.
+             *  @param[in] node The node.
+             *  @param[in] label The label.
+             *  @return The weight of the adjacencies, which is their number when all the edges weigh 1.*/
+            unsigned int Count( const unsigned int node, const unsigned long long label ) const;
+
+            /** @brief Gets the weight of the retained adjacencies of a node, which is the sum of the weights StreamGraph::Neighbors returns for BOTH.
+             *  @param[in] node The node.
+             *  @return The weight of the adjacencies.*/
+            unsigned int Degree( const unsigned int node ) const;
+
+            /** @brief Gets the number of distinct labels counted over all the nodes.
+             *  @return The number of labels.*/
+            size_t NumLabels() const;
+
+            /** @brief Gets the number of times an adjacency was counted or uncounted.
+             *  @return The number of updates.*/
+            unsigned long long NumUpdates() const;
+
+            /** @brief Gets the memory used by the counts.
+             *  @return The size in bytes.*/
+            size_t Bytes() const;
+
+        private:
+            /** @brief The adjacencies of a node to the neighbours with a label.*/
+            struct Entry {
+                unsigned long long  m_Label;    /**< @brief The label.*/
+                unsigned int        m_Count;    /**< @brief The weight of the adjacencies.*/
+            };
+
+            typedef std::vector<Entry> Entries;
+
+            /** @brief Finds the position of a label among the entries of a node.
+             *  @param[in] entries The entries of the node.
+             *  @param[in] label The label.
+             *  @return The position of the first entry whose label is not below the given one.*/
+            static size_t Find( const Entries& entries, const unsigned long long label );
+
+            bool                    m_Enabled;      /**< @brief Whether the counts are kept.*/
+            std::vector<Entries>    m_Entries;      /**< @brief The entries of each node, sorted by label.*/
+            std::vector<unsigned int> m_Degrees;    /**< @brief The weight of the retained adjacencies of each node.*/
+            size_t                  m_NumLabels;    /**< @brief The number of entries over all the nodes.*/
+            size_t                  m_EntryBytes;   /**< @brief The memory allocated for the entries.*/
+            unsigned long long      m_NumUpdates;   /**< @brief The number of adjacencies counted or uncounted.*/
+    };
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHARED_BUFFER_POOL_H
+#define SHARED_BUFFER_POOL_H
+
+#include "BufferPool.h"
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace flowing {
+
+/** @brief The number of buffer requests after which the arbiter halves the demand of every client.*/
+#define FLOWING_ARBITER_EPOCH 65536
+
+    /** @brief A BufferPool shared by several StreamGraphs of the same process, possibly running in
+     *  different threads. Every client gets a guaranteed minimum and a maximum number of buffers.
+     *  Above their minimums, clients take free buffers as they need them. Once the pool is exhausted,
+     *  the arbiter splits the buffers above the minimums in proportion to the recent demand of each
+     *  client. Clients above their quota then give buffers back at their next batch boundary.*/
+    class SharedBufferPool {
+        public:
+            /** @param numBuffers The number of buffers to contain.
+              @param bufferSize The size of the buffers in bytes.
+              @param flags A combination of BufferPool::Flags.
+              @param numaNode The NUMA node used with BufferPool::NUMA_BIND.*/
+            SharedBufferPool( const int numBuffers, const int bufferSize, const int flags = BufferPool::NONE, const int numaNode = -1 );
+            ~SharedBufferPool();
+
+            /** @brief Initializes the pool.
+              @return true if the initialization was successful.*/
+            bool Initialize();
+
+            /** @brief Closes the pool. All the clients must have been unregistered.*/
+            void Close();
+
+            /** @brief Registers a client.
+              @param[in] minBuffers The number of buffers guaranteed to the client.
+              @param[in] maxBuffers The maximum number of buffers the client can hold.
+              @return The id of the client. -1 if the minimums of all the clients do not fit in the pool.*/
+            int Register( const int minBuffers, const int maxBuffers );
+
+            /** @brief Unregisters a client. It must have released all its buffers.
+              @param[in] client The id of the client.*/
+            void Unregister( const int client );
+
+            /** @brief Gets a buffer for a client.
+              @param[in] client The id of the client.
+              @return The buffer. NULL if the client must reuse one of its own buffers instead.*/
+            void* Acquire( const int client );
+
+            /** @brief Gives a buffer back to the pool.
+              @param[in] client The id of the client.
+              @param[in] buffer The buffer.*/
+            void Release( const int client, void* buffer );
+
+            /** @brief Gets the number of buffers a client holds above its quota, which it should give back.
+              @param[in] client The id of the client.
+              @return The number of excess buffers.*/
+            int Excess( const int client );
+
+            /** @brief Gets the number of buffers a client holds.
+              @param[in] client The id of the client.
+              @return The number of buffers.*/
+            int NumUsed( const int client );
+
+            /** @brief Gets the size of the buffers.
+             *  @return The size of the buffers in bytes.*/
+            int BufferSize() const;
+
+        private:
+            /** @brief Represents a client of the pool.*/
+            struct Client {
+                bool        m_Active;       /**< @brief Whether the client is registered.*/
+                int         m_Min;          /**< @brief The number of buffers guaranteed to the client.*/
+                int         m_Max;          /**< @brief The maximum number of buffers of the client.*/
+                int         m_Used;         /**< @brief The number of buffers the client holds.*/
+                int         m_Quota;        /**< @brief The number of buffers the client may hold as decided by the arbiter.*/
+                double      m_Demand;       /**< @brief The recent number of buffer requests of the client.*/
+            };
+
+            /** @brief Gets the number of free buffers not reserved for the minimums of the other clients.
+              @param[in] client The client asking.
+              @return The number of buffers the client can take.*/
+            int Unreserved( const int client ) const;
+
+            /** @brief Splits the buffers above the minimums among the clients in proportion to their demand.*/
+            void Arbitrate();
+
+            BufferPool              m_Pool;         /**< @brief The memory of the buffers.*/
+            std::vector<void*>      m_Free;         /**< @brief The buffers given back to the pool.*/
+            std::vector<Client>     m_Clients;      /**< @brief The clients of the pool.*/
+            int                     m_NumRequests;  /**< @brief The number of requests in the current epoch.*/
+            std::mutex              m_Mutex;        /**< @brief Protects the state of the pool.*/
+    };
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPILL_LOG_H
+#define SPILL_LOG_H
+
+#include "Types.h"
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+namespace flowing {
+
+#define FLOWING_SPILL_ADVISED_PAGES 4096
+
+    /** @brief A disk backed log where the adjacency pages evicted from the BufferPool are appended.
+     *  The log is a ring of fixed-size segments mapped into memory. Segments are identified by a
+     *  monotonically increasing id, and once the disk budget is exhausted the oldest segment is
+     *  overwritten by the newest one.*/
+    class SpillLog {
+        public:
+            SpillLog();
+            ~SpillLog();
+
+            /** @brief Opens the log.
+              @param[in] path The path of the log file.
+              @param[in] budget The maximum number of bytes the log can take on disk.
+              @param[in] maxEdges The maximum number of edges in a segment.
+              @return true if the log was successfully opened.*/
+            bool Open( const char* path, const size_t budget, const int maxEdges );
+
+            /** @brief Closes the log and removes its file.*/
+            void Close();
+
+            /** @brief Tells if the log is open.
+             *  @return true if the log is open.*/
+            bool IsOpen() const;
+
+            /** @brief Tells if the next append overwrites the oldest segment.
+             *  @return true if the log is full.*/
+            bool IsFull() const;
+
+            /** @brief Appends a segment to the log.
+              @param[in] edges The edges to append.
+              @param[in] numEdges The number of edges to append.
+              @return The id of the new segment.*/
+            unsigned int Append( const Edge* edges, const int numEdges );
+
+            /** @brief Tells if a segment is still in the log.
+              @param[in] segment The segment id.
+              @return true if the segment has not been overwritten.*/
+            bool IsValid( const unsigned int segment ) const;
+
+            /** @brief Gets the id of the oldest segment in the log.
+             *  @return The id of the oldest segment.*/
+            unsigned int Oldest() const;
+
+            /** @brief Gets the edges of a segment.
+              @param[in] segment The segment id. Must be valid.
+              @param[out] numEdges The number of edges in the segment.
+              @return A pointer to the edges of the segment.*/
+            const Edge* Segment( const unsigned int segment, int& numEdges ) const;
+
+            /** @brief Asks the kernel to asynchronously read a segment ahead.
+              @param[in] segment The segment id.*/
+            void Prefetch( const unsigned int segment ) const;
+
+            /** @brief Gets the number of segments currently stored.
+             *  @return The number of segments in the log.*/
+            unsigned int NumSegments() const;
+
+            /** @brief Gets the size of the log on disk.
+             *  @return The size of the log in bytes.*/
+            size_t Bytes() const;
+
+        private:
+            /** @brief Gets the address of the slot holding a segment.
+              @param[in] segment The segment id.
+              @return The address of the slot.*/
+            unsigned char* Slot( const unsigned int segment ) const;
+
+            std::string         m_Path;         /**< @brief The path of the log file.*/
+            int                 m_File;         /**< @brief The file descriptor of the log.*/
+            unsigned char*      m_Data;         /**< @brief The mapping of the log file.*/
+            size_t              m_Size;         /**< @brief The size of the mapping in bytes.*/
+            int                 m_SlotSize;     /**< @brief The size of a segment slot in bytes.*/
+            unsigned int        m_NumSlots;     /**< @brief The number of slots in the log.*/
+            unsigned int        m_Next;         /**< @brief The id of the next segment to append.*/
+            unsigned int        m_NextSlot;     /**< @brief The slot where the next segment is written.*/
+            unsigned int        m_NumSegments;  /**< @brief The number of segments stored.*/
+            long                m_OsPageSize;   /**< @brief The page size of the system.*/
+            mutable std::atomic<unsigned int> m_Advised[FLOWING_SPILL_ADVISED_PAGES]; /**< @brief The pages recently advised to be read ahead, to avoid repeating the system call.*/
+    };
+}
+
+#endif
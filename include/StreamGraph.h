@@ -16,18 +16,34 @@
 #define STREAM_GRAPH_H
 
 #include "BufferPool.h"
+#include "EdgeReader.h"
+#include "EdgeServer.h"
+#include "EdgeSampler.h"
+#include "BatchTuner.h"
+#include "MemoryUsage.h"
+#include "NeighborCounts.h"
+#include "SharedBufferPool.h"
+#include "SpillLog.h"
 #include "Types.h"
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <map>
 #include <list>
+#include <string>
 
 
 namespace flowing {
 
 #define FLOWING_NUM_PAGES 1024*1024 
 //#define FLOWING_NUM_PAGES 1 
-#define FLOWING_PAGE_SIZE 4*sizeof(Edge)
+#define FLOWING_PAGE_SIZE 4*sizeof(flowing::Edge)
+#define FLOWING_SPILL_READAHEAD 8
+#define FLOWING_READ_CHUNK 4096
+#define FLOWING_MEMORY_CHECK_INTERVAL 4096
+#define FLOWING_MEMORY_LOW_WATER 0.9
+#define FLOWING_MEMORY_EVICT_FRACTION 16
+#define FLOWING_QUOTA_CHECK_INTERVAL 1024
 
     typedef std::map<unsigned int, unsigned int> UUMap;
     typedef std::vector<unsigned int> UVector;
@@ -44,6 +60,8 @@ namespace flowing {
                 Edge*               m_Buffer;           /**< @brief A pointer to the buffer holding the adjacencies.*/
                 int                 m_NumEdges;         /**< @brief The number of adjacencies that are in the buffer.*/
                 int                 m_MaxEdges;         /**< @brief The maximum number of adjacencies that can fit into the buffer.*/
+                unsigned int        m_Weight;           /**< @brief The weight of the adjacencies in the buffer, which all have the same.*/
+                unsigned int        m_Batch;            /**< @brief The number of batches inserted before the last adjacency was written.*/
             };
 
             /** @brief Allocates an AdjacencyPage using the given buffer.
@@ -73,11 +91,14 @@ namespace flowing {
             void             FreeAdjacencyListNode( AdjacencyListNode* adjacencyListNode );
 
 
-            /** @brief Represents a list of adjacencies.*/
+            /** @brief Represents a list of adjacencies. In DIRECTED mode the pages holding edges entering
+             *  the node are linked into a second list, so both directions share the same pages.*/
             struct AdjacencyList {
                 unsigned int        m_Node;      /**< @brief The node this adjacency list belongs to.*/
                 AdjacencyListNode*  m_First;     /**< @brief The first page of the list.*/
                 AdjacencyListNode*  m_Last;      /**< @brief The last page of the list.*/
+                AdjacencyListNode*  m_InFirst;   /**< @brief The first page holding edges entering the node. Only used in DIRECTED mode.*/
+                AdjacencyListNode*  m_InLast;    /**< @brief The last page holding edges entering the node. Only used in DIRECTED mode.*/
             };
 
             /** @brief Allocated an AdjacencyList.
@@ -96,6 +117,19 @@ namespace flowing {
                 DIRECTED
             };
 
+            /** @brief The adjacencies visited in DIRECTED mode. In UNDIRECTED mode all of them are always visited.*/
+            enum Direction {
+                OUT,                /**< @brief The heads of the edges leaving the node.*/
+                IN,                 /**< @brief The tails of the edges entering the node.*/
+                BOTH                /**< @brief Both of them. Self loops are visited once per direction.*/
+            };
+
+            /** @brief Decides how the pages spilled to disk are used.*/
+            enum SpillPolicy {
+                SPILL_ARCHIVE,      /**< @brief Spilled edges are removed from the graph, the log only keeps them around.*/
+                SPILL_EXTEND        /**< @brief Spilled edges stay in the graph and are visited by the iterators until overwritten.*/
+            };
+
             class AdjacencyIterator {
                 public:
                     ~AdjacencyIterator();
@@ -110,12 +144,21 @@ namespace flowing {
 
                 private:
                     friend class StreamGraph;
-                    AdjacencyIterator( const AdjacencyList* adjacencyList, EdgeMode mode );
+                    AdjacencyIterator( const AdjacencyList* adjacencyList, EdgeMode mode, Direction direction = OUT, const SpillLog* spillLog = NULL, const UVector* spillIndex = NULL );
 
                     const AdjacencyList* const  m_AdjacencyList;     /**< @brief The adjacency list to iterate.*/
                     const AdjacencyListNode*    m_CurrentNode;       /**< @brief The current page in the adjacency list being iterated.*/
                     int                         m_CurrentIndex;      /**< @brief The current index into the page being iterated.*/
                     EdgeMode                    m_EdgeMode;          /**< @brief The edge mode to traverse the adjacency list.*/
+                    int                         m_Match;             /**< @brief The ends of the edges where the node is looked for in the current list.*/
+                    bool                        m_VisitIn;           /**< @brief Whether the in list is visited after the current one.*/
+                    int                         m_SpillMatch;        /**< @brief The ends of the spilled edges where the node is looked for.*/
+                    const SpillLog*             m_SpillLog;          /**< @brief The log holding the spilled segments.*/
+                    const UVector*              m_SpillIndex;        /**< @brief The spilled segments of the node. NULL if they are not visited.*/
+                    unsigned int                m_SpillPosition;     /**< @brief The next position into the spilled segments.*/
+                    const Edge*                 m_SpillEdges;        /**< @brief The spilled segment being iterated.*/
+                    int                         m_SpillNumEdges;     /**< @brief The number of edges in the spilled segment being iterated.*/
+                    int                         m_SpillEdgeIndex;    /**< @brief The current index into the spilled segment being iterated.*/
 
             };
 
@@ -137,25 +180,194 @@ namespace flowing {
             /** @brief Closes the stream graph by freeing all the used resources.*/
             void Close();
 
-            /** @brief Pushes all the edges (tail,head) pairs that arrive from an input stream.
-              @param[in] stream The stream to read from. */
-            void Push( std::istream& stream );
-
-            /** @brief Pushes an edge.
+            /** @brief Configures how the buffer pool memory is mapped. Must be called before Initialize.
+              @param[in] flags A combination of BufferPool::Flags.
+              @param[in] numaNode The NUMA node to bind the pool to when BufferPool::NUMA_BIND is set.*/
+            void ConfigureBufferPool( const int flags, const int numaNode = -1 );
+
+            /** @brief Sets the number of pages of the buffer pool. Must be called before Initialize.
+              @param[in] numPages The number of pages.*/
+            void SetNumPages( const int numPages );
+
+            /** @brief Takes the pages from a pool shared with other graphs instead of a pool of its own. Must be called before Initialize.
+              @param[in] pool The shared pool, already initialized. It must outlive the graph.
+              @param[in] minPages The number of pages guaranteed to the graph, at least 1.
+              @param[in] maxPages The maximum number of pages of the graph.*/
+            void SetSharedBufferPool( SharedBufferPool* pool, const int minPages, const int maxPages );
+
+            /** @brief Enables or disables the progress messages.
+              @param[in] verbose Whether the progress is printed.*/
+            void SetVerbose( const bool verbose );
+
+            /** @brief Enables the on-disk tier where evicted pages are appended. Must be called before Initialize.
+              @param[in] path The path of the spill log.
+              @param[in] budget The maximum number of bytes the spill log can use on disk.
+              @param[in] policy How the spilled edges are used.*/
+            void ConfigureSpill( const char* path, const size_t budget, const SpillPolicy policy );
+
+            /** @brief Enables the sampling front-end, which sheds edges when they arrive faster than they are
+             *  processed and pushes the kept ones with the inverse of the sampling rate as their weight.
+              @param[in] throughput The minimum number of offered edges processed per second. 0 to ignore it.
+              @param[in] queueDepth The maximum number of blocks waiting in the EdgeReader or EdgeServer. 0 to ignore it.*/
+            void ConfigureSampling( const double throughput, const int queueDepth );
+
+            /** @brief Gets the sampling front-end, to read what was shed.
+             *  @return The sampler.*/
+            const EdgeSampler& Sampler() const;
+
+            /** @brief Enables the autotuning of the batch size, starting from the size given to the constructor,
+             *  or from the current size when it is reconfigured. When called after Initialize, the pending batch
+             *  is processed first and the batch buffer is sized again for the new bounds.
+              @param[in] minSize The smallest batch size.
+              @param[in] maxSize The largest batch size. Tuning is disabled when it is below minSize, and the size is fixed when it is equal.
+              @param[in] latency The target latency of a batch in seconds, from its first edge arriving to its insert callback returning. 0 to only maximize the throughput.*/
+            void ConfigureBatchTuning( const int minSize, const int maxSize, const double latency );
+
+            /** @brief Gets the batch size autotuner, to read the chosen sizes.
+             *  @return The tuner.*/
+            const BatchTuner& Tuner() const;
+
+            /** @brief Gets the number of edges currently passed at once to the insert callback.
+             *  @return The batch size.*/
+            int BatchSize() const;
+
+            /** @brief Enables the reclamation of the nodes whose edges have all left the graph. The callback
+             *  decides if such a node can be reclaimed and, if so, takes care of its node data, since
+             *  nodeDataFree is not called for it. Reclaimed nodes are erased from the id maps and their
+             *  internal id is handed out again to the next new node, so a node that shows up again after
+             *  being reclaimed is treated as a new node.
+              @param[in] reclaim The callback, returning true if the node can be reclaimed. NULL disables the reclamation.*/
+            void SetReclaimNodes( bool (*reclaim)( StreamGraph*, unsigned int, void* ) );
+
+            /** @brief Enables the counts of the retained adjacencies of each node by the label of the neighbour,
+             *  see NeighborCounts. The counts follow the edges as they are inserted and as they leave the graph,
+             *  evicted or overwritten in the spill log, with the label the callback gives for the neighbour at
+             *  that time. Whoever changes the label of a node must call Relabel. Must be called before Initialize.
+              @param[in] label The callback giving the label of a node. NULL disables the counts.*/
+            void SetNeighborLabels( unsigned long long (*label)( const StreamGraph*, unsigned int ) );
+
+            /** @brief Gets the counts of the adjacencies by label.
+             *  @return The counts, which are only kept when a label callback is set.*/
+            const NeighborCounts& Counts() const;
+
+            /** @brief Moves the adjacencies of the neighbours of a node from its old label to its new one, once
+             *  the label callback gives the new one. Does nothing when the counts are not kept.
+              @param[in] nodeId The node.
+              @param[in] oldLabel The label the node had.
+              @param[in] newLabel The label the node has now.*/
+            void Relabel( const unsigned int nodeId, const unsigned long long oldLabel, const unsigned long long newLabel );
+
+            /** @brief Sets a budget for the memory of the whole graph, including the node data as reported
+             *  by the usage callback. It is checked between batches, and when it is exceeded the oldest pages
+             *  are evicted, the buffer pool stops growing and the metadata is compacted, until the usage goes
+             *  below FLOWING_MEMORY_LOW_WATER of the budget.
+              @param[in] budget The budget in bytes. 0 disables it.*/
+            void SetMemoryBudget( const size_t budget );
+
+            /** @brief Sets the callback reporting the memory used by the node data and the structures the callbacks maintain.
+              @param[in] usage The callback, which adds its bytes to the given MemoryUsage.*/
+            void SetNodeDataUsage( void (*usage)( const StreamGraph*, MemoryUsage& ) );
+
+            /** @brief Gets the memory used by each subsystem, including the node data.
+              @param[out] usage Where the bytes of each subsystem are stored.*/
+            void GetMemoryUsage( MemoryUsage& usage ) const;
+
+            /** @brief Gets the number of pages evicted to stay within the memory budget.
+             *  @return The number of pages.*/
+            unsigned int NumBudgetEvictions() const;
+
+            /** @brief Passes the edges waiting in the current batch to the insert callback, so the state built by
+             *  the callbacks reflects every edge pushed so far.*/
+            void Flush();
+
+            /** @brief Tells if the memory budget could not be met even by evicting all the pages but one, in
+             *  which case the per-node metadata alone exceeds it.
+             *  @return true if the budget was exceeded after evicting.*/
+            bool BudgetUnmet() const;
+
+            /** @brief Pushes all the edges (tail,head) pairs that arrive from an input stream, one per line, which
+             *  is validated as EdgeReader validates a text file. The edges before a malformed line are pushed.
+              @param[in] stream The stream to read from.
+              @return The line where the stream is malformed, counting from 1, or 0 if every line was pushed. */
+            unsigned long long Push( std::istream& stream );
+
+            /** @brief Pushes all the edges read by an edge reader.
+              @param[in] reader The reader to read from. */
+            void Push( EdgeReader& reader );
+
+            /** @brief Pushes all the edges received by an edge server, straight from its blocks.
+              @param[in] server The server to receive from. */
+            void Push( EdgeServer& server );
+
+            /** @brief Pushes an edge, unless the sampling front-end sheds it.
               @param[in] tail The tail of the edge.
               @param[in] head The head of the edge.
-              @param[in] weight The weight of the edge.*/
+              @param[in] weight The number of edges it stands for, rounded to an integer of at least 1.
+              It is multiplied by the weight of the sampler, and reported by EdgeWeight to the callbacks.*/
             void Push( const unsigned int tail, const unsigned int head, const double weight = 1.0 );
 
+            /** @brief Gets the weight of the edges passed to the insert or remove callback being run. All the
+             *  edges of a call share it, and it is 1 unless weighted edges were pushed.
+             *  @return The weight.*/
+            unsigned int EdgeWeight() const;
+
+            /** @brief Tells if an edge with a weight other than 1 was ever pushed. Until then all the adjacencies
+             *  weigh 1 and there is no need to ask Neighbors for their weights.
+             *  @return true if weighted edges were pushed.*/
+            bool Weighted() const;
+
             /** @brief Gets the adjacency iterator of a given node.
              *  @param[in] The node to get the adjacency iterator.
+             *  @param[in] direction The adjacencies to visit in DIRECTED mode.
              *  @return The adjacency iterator.*/
-            AdjacencyIterator Iterator( const unsigned int nodeId ) const;
-
-            /** @brief Gets the number of nodes in the graph.
+            AdjacencyIterator Iterator( const unsigned int nodeId, const Direction direction = OUT ) const;
+
+            /** @brief Gets all the adjacencies of a node in a single pass. Visits the same adjacencies as Iterator.
+             *  @param[in] nodeId The node to get the adjacencies of.
+             *  @param[out] neighbors The buffer where the adjacencies are stored, starting at position 0. It
+             *  is grown when needed but never shrunk, so it can be reused across calls.
+             *  @param[in] direction The adjacencies to visit in DIRECTED mode.
+             *  @param[out] weights If not NULL, the buffer where the weight of each adjacency is stored, at the
+             *  same position as the adjacency. Grown like neighbors.
+             *  @return The number of adjacencies stored in the buffer.*/
+            unsigned int Neighbors( const unsigned int nodeId, UVector& neighbors, const Direction direction = OUT, UVector* weights = NULL ) const;
+
+            /** @brief Tells if a node has no edges left in the graph, including the spill log when its edges are visited.
+              @param[in] nodeId The node.
+              @return true if the node has no edges.*/
+            bool IsEmpty( const unsigned int nodeId ) const;
+
+            /** @brief Asks for a node to be checked for reclamation after the current batch, if it has no edges left.
+              @param[in] nodeId The node.*/
+            void AddReclaimCandidate( const unsigned int nodeId );
+
+            /** @brief Gets the number of edges of a node pushed so far, including the evicted ones.
+             *  Both the edges leaving and entering the node are counted in DIRECTED mode.
+             *  @param[in] nodeId The node.
+             *  @return The total degree of the node.*/
+            unsigned int Degree( const unsigned int nodeId ) const;
+
+            /** @brief Gets the mode of the graph.
+             *  @return UNDIRECTED or DIRECTED.*/
+            EdgeMode Mode() const;
+
+            /** @brief Gets the number of internal ids handed out, which bounds the ids of the nodes in the graph.
              *  @return The number of nodes.*/
             unsigned int NumNodes() const;
 
+            /** @brief Gets the number of nodes currently in the graph, which excludes the reclaimed ones.
+             *  @return The number of live nodes.*/
+            unsigned int NumLiveNodes() const;
+
+            /** @brief Tells if an internal id belongs to a reclaimed node that was not handed out again.
+             *  @param[in] nodeId The internal id, below NumNodes.
+             *  @return true if the id is free.*/
+            bool IsReclaimed( const unsigned int nodeId ) const;
+
+            /** @brief Gets the number of nodes reclaimed so far.
+             *  @return The number of reclaimed nodes.*/
+            unsigned int NumReclaimedNodes() const;
+
             /** @brief Gets the node data associated with a node.
              *  @param[in] id The node id.
              *  @return The node data.*/
@@ -165,6 +377,14 @@ namespace flowing {
              *  @param[in] id The node id.*/
             void SetNodeData( unsigned int id, void* nodeData );
 
+            /** @brief Gets the user data attached to the graph.
+             *  @return The user data.*/
+            void* GetUserData() const;
+
+            /** @brief Attaches user data to the graph, so the callbacks can reach their state.
+             *  @param[in] userData The user data.*/
+            void SetUserData( void* userData );
+
             /** @brief Gets the original id of a node.
              *  @param[in] id The id of the node.
              *  @return The id of the node.*/
@@ -176,12 +396,79 @@ namespace flowing {
 
             /** @brief Inserts an adjacency.
               @param[in] tail The tail of the edge.
-              @param[in] head The head of the edge.*/
-            void InsertAdjacency( const unsigned int tail, const unsigned int head );
+              @param[in] head The head of the edge.
+              @param[in] weight The weight of the edge. A page only holds edges of the same weight.*/
+            void InsertAdjacency( const unsigned int tail, const unsigned int head, const unsigned int weight );
+
+            /** @brief Counts or uncounts the adjacencies of both ends of some edges by the label of the other end.
+              @param[in] edges The edges.
+              @param[in] numEdges The number of edges.
+              @param[in] insert Whether the adjacencies are counted or uncounted.
+              @param[in] spilled Whether the edges are in the spill log, where a self loop is a single adjacency in both modes.
+              @param[in] weight The weight of the edges.*/
+            void CountAdjacencies( const Edge* edges, const int numEdges, const bool insert, const bool spilled, const unsigned int weight );
+
+            /** @brief Passes the current batch to the insert callback, and does the maintenance due between batches.*/
+            void ProcessBatch();
+
+            /** @brief Passes the current batch to the insert callback, leaving the maintenance to the next ProcessBatch.*/
+            void InsertBatch();
+
+            /** @brief Appends a page to a list of pages, unless it is already its last page.
+              @param[in,out] first The first page of the list.
+              @param[in,out] last The last page of the list.
+              @param[in] page The page to append.*/
+            void            LinkPage( AdjacencyListNode*& first, AdjacencyListNode*& last, AdjacencyPage* page );
+
+            /** @brief Removes a page from the front of a list of pages, if it is there.
+              @param[in,out] first The first page of the list.
+              @param[in,out] last The last page of the list.
+              @param[in] page The page being evicted.*/
+            void            UnlinkPage( AdjacencyListNode*& first, AdjacencyListNode*& last, const AdjacencyPage* page );
+
+            /** @brief Scans all the pages of a list of pages into a neighbour buffer.
+              @param[in] first The first page of the list.
+              @param[in] node The node to collect the adjacencies of.
+              @param[in] match The ends of the edges where the node is looked for, as a combination of ScanMatch.
+              @param[out] neighbors The buffer where the adjacencies are stored.
+              @param[in] count The number of adjacencies already in the buffer.
+              @param[out] weights If not NULL, the buffer where the weight of each adjacency is stored.
+              @return The number of adjacencies in the buffer after the scan.*/
+            static unsigned int ScanPages( const AdjacencyListNode* first, const unsigned int node, const int match, UVector& neighbors, unsigned int count, UVector* weights );
 
             /** @brief Gets a new page to use in an adjacency list.*/
             AdjacencyPage*  GetNewPage();
 
+            /** @brief Evicts the oldest page of the graph.
+              @return The evicted page, which is empty.*/
+            AdjacencyPage*  EvictPage();
+
+            /** @brief Gives a page that is no longer used back, to the shared pool if there is one.
+              @param[in] page The page, which must not be in use.*/
+            void            ReleasePage( AdjacencyPage* page );
+
+            /** @brief Gives back the pages above the quota set by the arbiter of the shared pool.*/
+            void            ShrinkToQuota();
+
+            /** @brief Evicts pages and compacts the metadata until the memory usage is below the low water mark of the budget.*/
+            void            EnforceMemoryBudget();
+
+            /** @brief Releases the memory held by the metadata that is no longer needed.*/
+            void            CompactMetadata();
+
+            /** @brief Appends an evicted page to the spill log.
+              @param[in] page The page being evicted.
+              @return The id of the spilled segment.*/
+            unsigned int    SpillPage( const AdjacencyPage* page );
+
+            /** @brief Records that a node has edges in a spilled segment.
+              @param[in] node The node.
+              @param[in] segment The spilled segment.*/
+            void            IndexSpilledSegment( const unsigned int node, const unsigned int segment );
+
+            /** @brief Reclaims the candidate nodes that have no edges left and that the callback lets go.*/
+            void            ReclaimNodes();
+
             /** @brief Gets the internal id corresponding to the given one.
               @param[in] id The id to retrieve.
               @return The internal id.*/
@@ -193,16 +480,54 @@ namespace flowing {
             BufferPool                              m_BufferPool;       /**< @brief The buffer pool.*/
             std::vector<AdjacencyList*>             m_Adjacencies;      /**< @brief The graph adjacencies.*/
             std::vector<void*>                      m_NodeData;         /**< @brief The node data.*/
+            UVector                                 m_Degrees;          /**< @brief The total degree of each node, never decremented on eviction.*/
             std::list<AdjacencyPage*>               m_Pages;            /**< @brief A list of pages in LRU to decide which to remove.*/
             UUMap                                   m_Map;              /**< @brief The old to new identifier map.*/
             UVector                                 m_Remap;            /**< @brief The new to old identifier map.*/
+            void*                                   m_UserData;         /**< @brief The user data attached to the graph.*/
             int                                     m_BatchSize;        /**< @brief The size of the batch to process.*/ 
             int                                     m_NumInBatch;       /**< @brief The number of elements in the batch.*/
             Edge*                                   m_Batch;            /**< @brief The current batch of edges.*/
+            unsigned int                            m_BatchWeight;      /**< @brief The weight of the edges in the batch.*/
+            unsigned int                            m_NumBatches;       /**< @brief The number of batches passed to the insert callback.*/
+            unsigned int                            m_CallbackWeight;   /**< @brief The weight of the edges passed to the running callback.*/
+            bool                                    m_Weighted;         /**< @brief Whether an edge with a weight other than 1 was pushed.*/
+            EdgeSampler                             m_Sampler;          /**< @brief The sampling front-end.*/
+            BatchTuner                              m_Tuner;            /**< @brief The batch size autotuner.*/
+            SpillLog                                m_Spill;            /**< @brief The log where evicted pages are spilled to.*/
+            std::string                             m_SpillPath;        /**< @brief The path of the spill log. Empty if spilling is disabled.*/
+            size_t                                  m_SpillBudget;      /**< @brief The disk budget of the spill log in bytes.*/
+            SpillPolicy                             m_SpillPolicy;      /**< @brief How the spilled edges are used.*/
+            std::vector<UVector>                    m_SpillIndex;       /**< @brief The spilled segments holding edges of each node.*/
+            std::deque<unsigned int>                m_SpillWeights;     /**< @brief The weight of each spilled segment still in the log. Only kept with SPILL_EXTEND.*/
+            NeighborCounts                          m_Counts;           /**< @brief The counts of the retained adjacencies of each node by label.*/
+            UVector                                 m_RelabelNeighbors; /**< @brief Scratch buffer for the adjacencies of a relabeled node.*/
+            UVector                                 m_RelabelWeights;   /**< @brief Scratch buffer for the weights of the adjacencies of a relabeled node.*/
+            UVector                                 m_ReclaimCandidates;/**< @brief The nodes that may have lost all their edges.*/
+            UVector                                 m_FreeIds;          /**< @brief The internal ids of the reclaimed nodes, ready to be reused.*/
+            std::vector<bool>                       m_Reclaimed;        /**< @brief Whether each internal id is currently free.*/
+            unsigned int                            m_NumReclaimed;     /**< @brief The number of nodes reclaimed so far.*/
+            size_t                                  m_MemoryBudget;     /**< @brief The memory budget in bytes. 0 if there is none.*/
+            size_t                                  m_PageLimit;        /**< @brief The maximum number of pages in use, lowered when the budget is exceeded.*/
+            std::vector<AdjacencyPage*>             m_FreePages;        /**< @brief The pages evicted to meet the budget, ready to be reused.*/
+            unsigned int                            m_NumBudgetEvictions; /**< @brief The number of pages evicted to meet the budget.*/
+            unsigned int                            m_EdgesSinceBudgetCheck; /**< @brief The number of edges processed since the memory budget was last checked.*/
+            unsigned int                            m_EdgesSinceQuotaCheck; /**< @brief The number of edges processed since the shared pool quota was last checked.*/
+            SharedBufferPool*                       m_SharedPool;       /**< @brief The pool shared with other graphs. NULL if the graph has its own.*/
+            int                                     m_PoolClient;       /**< @brief The client id of the graph in the shared pool.*/
+            int                                     m_SharedMin;        /**< @brief The number of pages guaranteed by the shared pool.*/
+            int                                     m_SharedMax;        /**< @brief The maximum number of pages from the shared pool.*/
+            bool                                    m_Verbose;          /**< @brief Whether the progress is printed.*/
+            bool                                    m_BudgetUnmet;      /**< @brief Whether the budget could not be met even after evicting all the pages.*/
+            size_t                                  m_NumListNodes;     /**< @brief The number of allocated AdjacencyListNodes.*/
+            size_t                                  m_NumSpillIndexEntries; /**< @brief The number of entries in the spill index.*/
             void (*m_Insert)( StreamGraph* graph, Edge*, int );                             /**< @brief Function pointer to the function used to process inserted edges.*/
             void (*m_Remove)( StreamGraph* graph, Edge*, int );                             /**< @brief Function pointer to the function used to process removed edges.*/
             void* (*m_NodeDataAllocate)( StreamGraph* graph, unsigned int );                /**< @brief This function is used to allocate the node data associated with each node.*/
             void (*m_NodeDataFree)( StreamGraph* graph, unsigned int, void* );              /**< @brief This function is used to free the node data associated with each node.*/
+            bool (*m_NodeReclaim)( StreamGraph* graph, unsigned int, void* );               /**< @brief This function decides if a node without edges is reclaimed. NULL if nodes are never reclaimed.*/
+            void (*m_NodeDataUsage)( const StreamGraph* graph, MemoryUsage& );              /**< @brief This function reports the memory used by the node data. NULL if it is not accounted.*/
+            unsigned long long (*m_NodeLabel)( const StreamGraph* graph, unsigned int );    /**< @brief This function gives the label of a node for the neighbour counts. NULL if they are not kept.*/
     };
 
 }
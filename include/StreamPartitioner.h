@@ -0,0 +1,167 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAM_PARTITIONER_H
+#define STREAM_PARTITIONER_H
+
+#include "Types.h"
+#include "StreamGraph.h"
+#include "MemoryUsage.h"
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace flowing {
+
+#define FLOWING_PARTITION_SLACK 1.1
+#define FLOWING_FENNEL_GAMMA 1.5
+#define FLOWING_PARTITION_MIN_DEGREE 32
+
+    /** @brief Assigns every node of a StreamGraph to one of K parts, so the parts can be used as shards. A
+     *  node is held pending from its first edge until it has FLOWING_PARTITION_MIN_DEGREE edges, or until
+     *  one of its edges is about to be evicted, so it is placed knowing more than one neighbour and before
+     *  any of them is forgotten. The part is the one holding most of the retained neighbours of the node, penalized by
+     *  its load as in LDG (Stanton and Kliot) or Fennel (Tsourakakis et al.). Since the number of nodes
+     *  is not known in advance, the capacity of the parts grows with the number of nodes assigned so far,
+     *  and no part is allowed above FLOWING_PARTITION_SLACK times the average load. Assignments are never
+     *  revised. The metrics count an edge once both its ends are placed, so the edges evicted before
+     *  that are left out of them.
+     *
+     *  The part of each node and the load of each part are kept in flat arrays indexed by the internal
+     *  ids, and an assignment is written out when its node leaves the graph. A reclaimed node keeps its
+     *  part in a map by original id, so it gets it back if it shows up again and is written only once.
+     *  The static methods can be passed as the StreamGraph callbacks when the partitioner is used on its
+     *  own, with the partitioner attached to the graph through StreamGraph::SetUserData.*/
+    class StreamPartitioner {
+        public:
+
+            enum Method {
+                LDG,            /**< @brief Neighbours in the part times the room left in it.*/
+                FENNEL          /**< @brief Neighbours in the part minus the marginal cost of its load.*/
+            };
+
+            /** @param[in] graph The graph whose nodes are assigned.*/
+            StreamPartitioner( StreamGraph* graph );
+            ~StreamPartitioner();
+
+            /** @brief StreamGraph insert callback.*/
+            static void InsertEdges( StreamGraph* graph, Edge* edges, int numEdges );
+
+            /** @brief StreamGraph remove callback. Assigns the pending ends of the evicted edges.*/
+            static void RemoveEdges( StreamGraph* graph, Edge* edges, int numEdges );
+
+            /** @brief StreamGraph node data allocation callback.*/
+            static void* NodeDataAllocate( StreamGraph* graph, unsigned int nodeId );
+
+            /** @brief StreamGraph node data free callback. Writes the assignment of the node out.*/
+            static void NodeDataFree( StreamGraph* graph, unsigned int nodeId, void* nodeData );
+
+            /** @brief Enables the partitioning. Must be called before any edge is pushed.
+             *  @param[in] numParts The number of parts. 0 disables the partitioning.
+             *  @param[in] method How the parts are scored.*/
+            void Configure( const int numParts, const Method method );
+
+            /** @brief Tells if the nodes are being partitioned.
+             *  @return true if they are.*/
+            bool Enabled() const;
+
+            /** @brief Sets where the assignments are written, as "node part" lines, when the nodes leave the graph.
+             *  @param[in] out The stream. NULL to not write them.*/
+            void SetOutput( std::ostream* out );
+
+            /** @brief Makes room for a new node, which is left unassigned unless it was reclaimed with a part.
+             *  @param[in] nodeId The node, which can already be remapped.*/
+            void ResetNode( const unsigned int nodeId );
+
+            /** @brief Accounts inserted edges in the metrics, and assigns the endpoints that are not assigned yet
+             *  once they have enough edges or have been pending for too long.
+             *  @param[in] edges The inserted edges.
+             *  @param[in] numEdges The number of inserted edges.
+             *  @param[in] weight The number of edges each of them stands for.*/
+            void Insert( const Edge* edges, const int numEdges, const unsigned int weight );
+
+            /** @brief Assigns the pending ends of edges about to be evicted, while the edges are still retained.
+             *  @param[in] edges The edges.
+             *  @param[in] numEdges The number of edges.*/
+            void Remove( const Edge* edges, const int numEdges );
+
+            /** @brief Assigns all the pending nodes.*/
+            void Flush();
+
+            /** @brief Writes the assignment of a node that leaves the graph, unless it was written when it was
+             *  reclaimed before. Its part keeps the load. A pending node is placed in the least loaded part,
+             *  since its adjacencies may already be gone.
+             *  @param[in] nodeId The node, which can still be remapped.
+             *  @param[in] reclaimed Whether the node is reclaimed and may come back, so its part is remembered.*/
+            void Retire( const unsigned int nodeId, const bool reclaimed = false );
+
+            /** @brief Gets the part of a node.
+             *  @param[in] nodeId The node.
+             *  @return The part, -1 if the node is not assigned.*/
+            int Part( const unsigned int nodeId ) const;
+
+            /** @brief Gets the number of parts.
+             *  @return The number of parts.*/
+            int NumParts() const;
+
+            /** @brief Gets the number of nodes assigned to a part, including the ones that left the graph.
+             *  @param[in] part The part.
+             *  @return The load of the part.*/
+            unsigned long long Load( const int part ) const;
+
+            /** @brief Gets the number of nodes assigned.
+             *  @return The number of nodes.*/
+            unsigned long long NumAssigned() const;
+
+            /** @brief Gets the number of edges processed.
+             *  @return The weighted number of edges.*/
+            unsigned long long NumEdges() const;
+
+            /** @brief Gets the number of edges processed whose endpoints are in different parts.
+             *  @return The weighted number of cut edges.*/
+            unsigned long long NumCutEdges() const;
+
+            /** @brief Gets the load of the most loaded part relative to the average load.
+             *  @return The imbalance, 1 for perfectly balanced parts.*/
+            double Imbalance() const;
+
+            /** @brief Adds the memory used by the partitioner.
+             *  @param[in,out] usage Where the bytes are added.*/
+            void AddMemoryUsage( MemoryUsage& usage ) const;
+
+        private:
+            /** @brief Assigns a node to the best part for its retained neighbours, and accounts the edges to
+             *  the neighbours already placed.
+             *  @param[in] nodeId The node.
+             *  @param[in] scan Whether the adjacencies of the node can be scanned.*/
+            void Assign( const unsigned int nodeId, const bool scan = true );
+
+            StreamGraph*                    m_Graph;        /**< @brief The graph whose nodes are assigned.*/
+            int                             m_NumParts;     /**< @brief The number of parts. 0 if disabled.*/
+            Method                          m_Method;       /**< @brief How the parts are scored.*/
+            std::vector<int>                m_Parts;        /**< @brief The part of each node, -1 if unassigned and -2 if pending.*/
+            std::vector<unsigned long long> m_Loads;        /**< @brief The number of nodes of each part.*/
+            std::vector<unsigned int>       m_Counts;       /**< @brief Scratch array with the neighbours of the node in each part.*/
+            std::vector<int>                m_Touched;      /**< @brief The parts with a non zero count.*/
+            UVector                         m_Neighbors;    /**< @brief Scratch buffer for the neighbours of the node.*/
+            UVector                         m_Weights;      /**< @brief Scratch buffer for the weights of the adjacencies of the node.*/
+            std::unordered_map<unsigned int, int> m_Retired;/**< @brief The part of each reclaimed node, by original id.*/
+            unsigned long long              m_NumAssigned;  /**< @brief The number of nodes assigned.*/
+            unsigned long long              m_NumEdges;     /**< @brief The weighted number of edges processed.*/
+            unsigned long long              m_NumCutEdges;  /**< @brief The weighted number of cut edges.*/
+            std::ostream*                   m_Output;       /**< @brief Where the assignments are written.*/
+    };
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRIANGLE_COUNTER_H
+#define TRIANGLE_COUNTER_H
+
+#include "Types.h"
+#include "StreamGraph.h"
+#include <vector>
+#include <unordered_map>
+
+namespace flowing {
+
+    /** @brief Counts the triangles closed by the edges of the stream. For each arriving edge the
+     *  retained neighbourhoods of its endpoints are gathered from the pages, sorted and intersected,
+     *  and every common neighbour closes a triangle, which is counted once for each of its three nodes.
+     *  Only the edges still retained by the graph are seen, so the counts are local to the window of
+     *  the stream held in memory, and an edge that arrives again closes its triangles again. In DIRECTED
+     *  mode the direction of the edges is ignored.*/
+    class TriangleCounter {
+        public:
+            /** @param[in] graph The graph whose neighbourhoods are intersected.*/
+            TriangleCounter( const StreamGraph* graph );
+            ~TriangleCounter();
+
+            /** @brief Enables or disables the counting.
+             *  @param[in] enabled Whether the triangles are counted.
+             *  @param[in] scoring Whether the community scores use the counts.*/
+            void Configure( const bool enabled, const bool scoring );
+
+            /** @brief Tells if the triangles are counted.
+             *  @return true if they are counted.*/
+            bool Enabled() const;
+
+            /** @brief Tells if the community scores use the counts.
+             *  @return true if they use them.*/
+            bool Scoring() const;
+
+            /** @brief Makes room for a node and clears its counter, since internal ids are reused.
+             *  @param[in] node The node.*/
+            void ResetNode( const unsigned int node );
+
+            /** @brief Records the edges of a batch, which are all in the graph before any of them is counted, so
+             *  each edge only closes the triangles whose other two edges arrived before it.
+             *  @param[in] edges The edges of the batch, which must then be counted in this order.
+             *  @param[in] numEdges The number of edges.*/
+            void BeginBatch( const Edge* edges, const int numEdges );
+
+            /** @brief Counts the triangles closed by an edge, which must already be in the graph.
+             *  @param[in] tail The tail of the edge.
+             *  @param[in] head The head of the edge.
+             *  @param[in] weight The number of triangles each closed triangle stands for.
+             *  @param[out] common The third nodes of the closed triangles, valid until the next call.
+             *  @return The number of closed triangles.*/
+            unsigned int Count( const unsigned int tail, const unsigned int head, const unsigned int weight, const unsigned int*& common );
+
+            /** @brief Gets the triangles a node took part in.
+             *  @param[in] node The node.
+             *  @return The weighted number of triangles.*/
+            unsigned long long NodeTriangles( const unsigned int node ) const;
+
+            /** @brief Gets the triangles closed so far.
+             *  @return The weighted number of triangles.*/
+            unsigned long long NumTriangles() const;
+
+            /** @brief Gets the number of edges whose triangles were counted.
+             *  @return The number of edges.*/
+            unsigned long long NumEdges() const;
+
+            /** @brief Gets the number of adjacencies gathered to intersect.
+             *  @return The number of adjacencies.*/
+            unsigned long long NumAdjacencies() const;
+
+            /** @brief Gets the time spent counting.
+             *  @return The time in seconds.*/
+            double Seconds() const;
+
+            /** @brief Adds the time spent counting, measured by the caller around a batch of edges.
+             *  @param[in] seconds The time in seconds.*/
+            void AddSeconds( const double seconds );
+
+            /** @brief Gets the memory used by the counters and the scratch buffers.
+             *  @return The size in bytes.*/
+            size_t Bytes() const;
+
+        private:
+            /** @brief Gathers the sorted distinct neighbours of a node.
+             *  @param[in] node The node.
+             *  @param[out] neighbors Where the neighbours are stored.
+             *  @return The number of neighbours.*/
+            unsigned int Gather( const unsigned int node, UVector& neighbors, UVector* counts );
+
+            /** @brief Tells if an edge had arrived before the edge being counted, given the adjacencies of one of its ends.
+             *  @param[in] node The end whose adjacencies are given.
+             *  @param[in] other The other end.
+             *  @param[in] neighbors The sorted distinct neighbours of the node.
+             *  @param[in] counts The number of adjacencies to each neighbour.
+             *  @param[in] numNeighbors The number of neighbours.
+             *  @return true if at least one of the adjacencies is not later in the batch.*/
+            bool Arrived( const unsigned int node, const unsigned int other, const UVector& neighbors, const UVector& counts, const unsigned int numNeighbors ) const;
+
+            /** @brief Builds the key of an undirected edge.
+             *  @param[in] tail One end.
+             *  @param[in] head The other end.
+             *  @return The key.*/
+            static unsigned long long EdgeKey( const unsigned int tail, const unsigned int head );
+
+            const StreamGraph*              m_Graph;            /**< @brief The graph whose neighbourhoods are intersected.*/
+            bool                            m_Enabled;          /**< @brief Whether the triangles are counted.*/
+            bool                            m_Scoring;          /**< @brief Whether the community scores use the counts.*/
+            std::vector<unsigned long long> m_NodeTriangles;    /**< @brief The triangles of each node.*/
+            UVector                         m_TailNeighbors;    /**< @brief Scratch buffer for the neighbours of the tail.*/
+            UVector                         m_HeadNeighbors;    /**< @brief Scratch buffer for the neighbours of the head.*/
+            UVector                         m_Common;           /**< @brief Scratch buffer for the common neighbours.*/
+            UVector                         m_TailCounts;       /**< @brief Scratch buffer for the adjacencies to each neighbour of the tail.*/
+            UVector                         m_HeadCounts;       /**< @brief Scratch buffer for the adjacencies to each neighbour of the head.*/
+            std::unordered_map<unsigned long long, unsigned int> m_Pending; /**< @brief The edges of the batch not counted yet.*/
+            unsigned long long              m_NumTriangles;     /**< @brief The triangles closed so far.*/
+            unsigned long long              m_NumEdges;         /**< @brief The number of edges counted.*/
+            unsigned long long              m_NumAdjacencies;   /**< @brief The number of adjacencies gathered.*/
+            double                          m_Seconds;          /**< @brief The time spent counting.*/
+    };
+}
+
+#endif
@@ -0,0 +1,137 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BatchTuner.h"
+
+namespace flowing {
+
+    BatchTuner::BatchTuner() :
+        m_Size( 1 ),
+        m_MinSize( 1 ),
+        m_MaxSize( 0 ),
+        m_Latency( 0.0 ),
+        m_Direction( 1 ),
+        m_LastThroughput( 0.0 ),
+        m_ObservedDepth( 0 ),
+        m_NumEdges( 0 ),
+        m_WindowEdges( 0 ),
+        m_WindowLatency( 0.0 ),
+        m_MaxLatency( 0.0 ),
+        m_NumChanges( 0 ),
+        m_NumLateWindows( 0 ),
+        m_BatchStart( std::chrono::steady_clock::now() ),
+        m_WindowStart( std::chrono::steady_clock::now() ) {
+    }
+
+    BatchTuner::~BatchTuner() {
+    }
+
+    void BatchTuner::Configure( const int size, const int minSize, const int maxSize, const double latency ) {
+        m_MinSize = minSize > 0 ? minSize : 1;
+        m_MaxSize = maxSize >= m_MinSize ? maxSize : 0;
+        m_Latency = latency > 0.0 ? latency : 0.0;
+        m_Size = size < m_MinSize ? m_MinSize : size;
+        if( Enabled() && m_Size > m_MaxSize ) m_Size = m_MaxSize;
+        m_Direction = 1;
+        m_LastThroughput = 0.0;
+        m_WindowEdges = 0;
+        m_WindowLatency = 0.0;
+        m_History.clear();
+        m_WindowStart = std::chrono::steady_clock::now();
+    }
+
+    bool BatchTuner::Enabled() const {
+        return m_MaxSize > 0;
+    }
+
+    void BatchTuner::BatchStarted() {
+        m_BatchStart = std::chrono::steady_clock::now();
+    }
+
+    void BatchTuner::BatchProcessed( const int numEdges ) {
+        double latency = std::chrono::duration<double>( std::chrono::steady_clock::now() - m_BatchStart ).count();
+        if( latency > m_WindowLatency ) m_WindowLatency = latency;
+        if( latency > m_MaxLatency ) m_MaxLatency = latency;
+        m_NumEdges += numEdges;
+        m_WindowEdges += numEdges;
+        if( m_WindowEdges >= FLOWING_TUNER_WINDOW ) Adapt();
+    }
+
+    void BatchTuner::ObserveQueueDepth( const int queueDepth ) {
+        m_ObservedDepth = queueDepth;
+    }
+
+    void BatchTuner::Adapt() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>( now - m_WindowStart ).count();
+        double throughput = seconds > 0.0 ? m_WindowEdges / seconds : m_LastThroughput;
+        int size = m_Size;
+        if( m_Latency > 0.0 && m_WindowLatency > m_Latency ) {
+            m_NumLateWindows++;
+            m_Direction = -1;
+            size = m_Size/2;
+        } else {
+            if( m_LastThroughput > 0.0 && throughput < m_LastThroughput*(1.0 - FLOWING_TUNER_TOLERANCE) ) {
+                m_Direction = -m_Direction;
+            } else if( m_ObservedDepth > 1 ) {
+                // The input is piling up, and larger batches amortize the per-batch work better.
+                m_Direction = 1;
+            }
+            size = m_Direction > 0 ? 2*m_Size : m_Size/2;
+            // The latency of a batch grows about linearly with its size.
+            if( m_Direction > 0 && m_Latency > 0.0 && 2.0*m_WindowLatency > m_Latency ) size = m_Size;
+        }
+        if( size < m_MinSize ) size = m_MinSize;
+        if( size > m_MaxSize ) size = m_MaxSize;
+        if( size != m_Size ) {
+            Step step;
+            step.m_NumEdges = m_NumEdges;
+            step.m_Size = size;
+            step.m_Throughput = throughput;
+            step.m_Latency = m_WindowLatency;
+            if( m_History.size() == FLOWING_TUNER_HISTORY ) m_History.erase( m_History.begin() );
+            m_History.push_back( step );
+            m_NumChanges++;
+            m_Size = size;
+        }
+        m_LastThroughput = throughput;
+        m_WindowEdges = 0;
+        m_WindowLatency = 0.0;
+        m_WindowStart = now;
+    }
+
+    int BatchTuner::Size() const {
+        return m_Size;
+    }
+
+    int BatchTuner::MaxSize() const {
+        return m_MaxSize;
+    }
+
+    const std::vector<BatchTuner::Step>& BatchTuner::History() const {
+        return m_History;
+    }
+
+    unsigned long long BatchTuner::NumChanges() const {
+        return m_NumChanges;
+    }
+
+    unsigned long long BatchTuner::NumLateWindows() const {
+        return m_NumLateWindows;
+    }
+
+    double BatchTuner::MaxLatency() const {
+        return m_MaxLatency;
+    }
+}
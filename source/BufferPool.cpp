@@ -15,34 +15,123 @@
 #include "BufferPool.h"
 #include <cstdlib>
 #include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define FLOWING_HUGE_PAGE_SIZE (2*1024*1024)
+#define FLOWING_MPOL_BIND 2
+#define FLOWING_MPOL_INTERLEAVE 3
+#define FLOWING_MPOL_F_MEMS_ALLOWED (1 << 2)
 
 namespace flowing {
 
-    BufferPool::BufferPool( const int numBuffers, const int bufferSize) {
+    static size_t RoundUp( const size_t size, const size_t alignment ) {
+        return ((size + alignment - 1) / alignment) * alignment;
+    }
+
+    BufferPool::BufferPool( const int numBuffers, const int bufferSize, const int flags, const int numaNode ) {
         m_NumBuffers = numBuffers;
         m_BufferSize = bufferSize;
         m_Buffers = NULL;
         m_Next = 0;
+        m_Flags = flags;
+        m_NumaNode = numaNode;
+        m_MappedSize = 0;
+        m_HugePages = false;
     }
 
     BufferPool::~BufferPool() {
 
     }
 
+    void BufferPool::Configure( const int flags, const int numaNode ) {
+        if( m_Buffers ) return;
+        m_Flags = flags;
+        m_NumaNode = numaNode;
+    }
+
+    void BufferPool::SetNumBuffers( const int numBuffers ) {
+        if( m_Buffers ) return;
+        m_NumBuffers = numBuffers;
+    }
+
     bool BufferPool::Initialize() {
-//       posix_memalign( &m_Buffers, m_NumBuffers*m_BufferSize, m_BufferSize ) == 0;
-       m_Buffers = (void*)malloc(m_NumBuffers*m_BufferSize);
-       if(!m_Buffers) return false;
-       memset(m_Buffers, 0, m_NumBuffers*m_BufferSize );
-       return true;
+        size_t size = (size_t)m_NumBuffers*m_BufferSize;
+        // Anonymous mappings are zero-filled on first touch, so there is no need to clear the pool
+        // here: pages are only committed once an adjacency page lands on them. The pool is not populated
+        // by mmap, since the pages would be placed before the NUMA policy is set.
+        if( m_Flags & HUGE_PAGES ) {
+            m_MappedSize = RoundUp( size, FLOWING_HUGE_PAGE_SIZE );
+            m_Buffers = mmap( NULL, m_MappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+            if( m_Buffers == MAP_FAILED ) m_Buffers = NULL;
+            else m_HugePages = true;
+        }
+        if( !m_Buffers ) {
+            m_MappedSize = RoundUp( size, sysconf(_SC_PAGESIZE) );
+            m_Buffers = mmap( NULL, m_MappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+            if( m_Buffers == MAP_FAILED ) {
+                m_Buffers = NULL;
+                m_MappedSize = 0;
+                return false;
+            }
+#ifdef MADV_HUGEPAGE
+            if( m_Flags & (HUGE_PAGES | TRANSPARENT_HUGE_PAGES) ) madvise( m_Buffers, m_MappedSize, MADV_HUGEPAGE );
+#endif
+        }
+        // A placement that was explicitly asked for and cannot be honoured fails the pool, rather than
+        // silently running with the pages wherever the kernel puts them.
+        if( !ApplyNumaPolicy() ) {
+            Close();
+            return false;
+        }
+        if( m_Flags & POPULATE ) Populate();
+        return true;
+    }
+
+    void BufferPool::Populate() {
+#ifdef MADV_POPULATE_WRITE
+        if( madvise( m_Buffers, m_MappedSize, MADV_POPULATE_WRITE ) == 0 ) return;
+#endif
+        // Older kernels fault the pages in by writing to each of them, which places them under the policy.
+        size_t stride = m_HugePages ? FLOWING_HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE);
+        for( size_t offset = 0; offset < m_MappedSize; offset += stride ) {
+            ((volatile unsigned char*)m_Buffers)[offset] = 0;
+        }
+    }
+
+    bool BufferPool::ApplyNumaPolicy() {
+#ifdef SYS_mbind
+        unsigned long nodeMask = 0;
+        int mode = 0;
+        if( m_Flags & NUMA_INTERLEAVE ) {
+            mode = FLOWING_MPOL_INTERLEAVE;
+            // Only the nodes the process may allocate on, since offline or missing nodes fail the call.
+            int unused;
+            if( syscall( SYS_get_mempolicy, &unused, &nodeMask, 8*sizeof(nodeMask), NULL, FLOWING_MPOL_F_MEMS_ALLOWED ) != 0 ) return false;
+        } else if( (m_Flags & NUMA_BIND) && m_NumaNode >= 0 && m_NumaNode < (int)(8*sizeof(nodeMask)) ) {
+            mode = FLOWING_MPOL_BIND;
+            nodeMask = 1UL << m_NumaNode;
+        } else {
+            return true;
+        }
+        // The policy only governs where pages are placed when first touched, which is why it can
+        // be set after the mapping is created as long as the pool has not been written yet.
+        return syscall( SYS_mbind, m_Buffers, m_MappedSize, mode, &nodeMask, 8*sizeof(nodeMask), 0 ) == 0;
+#else
+        return (m_Flags & (NUMA_BIND | NUMA_INTERLEAVE)) == 0;
+#endif
     }
 
     void BufferPool::Close() {
-        if( m_Buffers ) free(m_Buffers);        
+        if( m_Buffers ) munmap( m_Buffers, m_MappedSize );
+        m_Buffers = NULL;
+        m_MappedSize = 0;
+        m_Next = 0;
     }
 
     void* BufferPool::NextBuffer() {
-        return m_Next < m_NumBuffers ? (unsigned char*)(m_Buffers) + (m_Next++)*m_BufferSize : NULL;
+        return m_Next < m_NumBuffers ? (unsigned char*)(m_Buffers) + (size_t)(m_Next++)*m_BufferSize : NULL;
     }
 
     int BufferPool::MaxNumBuffers() {
@@ -52,4 +141,12 @@ namespace flowing {
     int BufferPool::NumFreeBuffers() {
         return m_NumBuffers - m_Next;
     }
+
+    size_t BufferPool::MappedBytes() const {
+        return m_MappedSize;
+    }
+
+    bool BufferPool::UsesHugePages() const {
+        return m_HugePages;
+    }
 }
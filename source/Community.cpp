@@ -14,10 +14,48 @@
 
 
 #include "Community.h"
+#include <new>
 #include <assert.h>
 
 namespace flowing {
 
+    /** @brief Per-thread scratch buffer where the adjacencies of the tested nodes are gathered.*/
+    static thread_local UVector t_Neighbors;
+
+    /** @brief Gets how much an internal edge adds to the internal degree of a community. An undirected
+     *  edge counts for both of its ends, while in DIRECTED mode each arc counts once, so in both cases the
+     *  internal degree of a community of size s is bounded by the s*(s-1) of the score.*/
+    static inline int InternalWeight( const StreamGraph* graph ) {
+        return graph->Mode() == StreamGraph::UNDIRECTED ? 2 : 1;
+    }
+
+    /** @brief Computes a score from its internal degree and its denominator. The size term only bounds
+     *  the internal degree of simple graphs, while repeated edges and the estimates of the evicted edges
+     *  can take it further, so the score is clamped to 1.*/
+    static inline double Ratio( const int kin, const int denom ) {
+        if( denom <= 0 ) return 0;
+        double score = kin / (double)denom;
+        return score < 1.0 ? score : 1.0;
+    }
+
+    /** @brief Per-thread scratch buffer where the weights of the gathered adjacencies are stored.*/
+    static thread_local UVector t_Weights;
+
+    /** @brief Gathers the adjacencies of a node into t_Neighbors and, once the graph holds weighted edges, their
+     *  weights into t_Weights, so each retained edge counts with the weight it was signaled with.
+     *  @param[in] graph The graph.
+     *  @param[in] nodeId The node.
+     *  @param[out] numNeighbors The number of adjacencies gathered.
+     *  @return The weights of the adjacencies, or NULL if they all weigh 1.*/
+    static inline const unsigned int* GatherNeighbors( const StreamGraph* graph, const unsigned int nodeId, unsigned int& numNeighbors ) {
+        if( !graph->Weighted() ) {
+            numNeighbors = graph->Neighbors( nodeId, t_Neighbors, StreamGraph::BOTH );
+            return NULL;
+        }
+        numNeighbors = graph->Neighbors( nodeId, t_Neighbors, StreamGraph::BOTH, &t_Weights );
+        return t_Weights.data();
+    }
+
     // COMMUNITY ITERATOR METHODS
 
     Community::CommunityIterator::CommunityIterator( const Community* community ) :
@@ -42,109 +80,322 @@ namespace flowing {
 
     // COMMUNITY METHODS
 
-    Community::Community( StreamGraph* graph, unsigned int id ) :
+    Community::Community( StreamGraph* graph, unsigned int id, const DegreeSketch* sketch, const TriangleCounter* triangles ) :
         m_CommunityId( id ), 
         m_Graph( graph ),
         m_Kin( 0 ), 
-        m_Kout( 0 ) {
+        m_Kout( 0 ),
+        m_Sketch( sketch ),
+        m_TriangleCounter( triangles ),
+        m_InternalTriangles( 0 ),
+        m_TriangleVolume( triangles != NULL ? triangles->NodeTriangles( id ) : 0 ),
+        m_Parent( this ),
+        m_Size( 1 ),
+        m_Partner( NULL ),
+        m_PartnerEdges( 0 ) {
             m_Nodes.insert( id );
     }
 
     Community::~Community() {
     }
 
+    void Community::Reset( unsigned int id, int kin, int kout ) {
+        m_CommunityId = id;
+        m_Nodes.clear();
+        m_Nodes.insert( id );
+        m_Kin = kin;
+        m_Kout = kout;
+        m_InternalTriangles = 0;
+        m_TriangleVolume = m_TriangleCounter != NULL ? m_TriangleCounter->NodeTriangles( id ) : 0;
+        m_Parent = this;
+        m_Absorbed.clear();
+        m_Size = 1;
+        m_Partner = NULL;
+        m_PartnerEdges = 0;
+    }
+
     bool Community::Exists( unsigned int id ) const {
-        return m_Nodes.find(id) != m_Nodes.end();
+        // The node data points to the community holding the node in its set, which may have been absorbed.
+        Community* community = static_cast<Community*>(m_Graph->GetNodeData( id ));
+        return community != NULL && community->Find() == this;
     }
 
     void Community::Insert( unsigned int id ) {
-        assert( m_Nodes.find(id) == m_Nodes.end());
+        assert( !Exists( id ) );
         unsigned int newKin;
         unsigned int newKout;
-        TestInsert( id, newKin, newKout );
+        unsigned long long newTriangles;
+        TestInsert( id, newKin, newKout, newTriangles );
         m_Nodes.insert( id );
+        m_Size++;
         m_Kin = newKin;
         m_Kout = newKout;
+        m_InternalTriangles = newTriangles;
+        if( m_TriangleCounter != NULL ) m_TriangleVolume += m_TriangleCounter->NodeTriangles( id );
         assert( m_Kin >= 0 );
         assert( m_Kout >= 0 );
     }
 
     void Community::Remove( unsigned int id ) {
-        assert( m_Nodes.find(id) != m_Nodes.end());
+        assert( Exists( id ) );
         unsigned int newKin;
         unsigned int newKout;
-        TestRemove( id, newKin, newKout );
-        m_Nodes.erase( id );
+        unsigned long long newTriangles;
+        TestRemove( id, newKin, newKout, newTriangles );
+        static_cast<Community*>(m_Graph->GetNodeData( id ))->m_Nodes.erase( id );
+        m_Size--;
         m_Kin = newKin;
         m_Kout = newKout;
+        m_InternalTriangles = newTriangles;
+        if( m_TriangleCounter != NULL ) {
+            unsigned long long nodeTriangles = m_TriangleCounter->NodeTriangles( id );
+            m_TriangleVolume = m_TriangleVolume > nodeTriangles ? m_TriangleVolume - nodeTriangles : 0;
+        }
         assert( m_Kin >= 0 );
         assert( m_Kout >= 0 );
     }
 
     int Community::Size() const {
-        return m_Nodes.size();
+        return m_Size;
     }
 
-    double Community::TestInsert( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout ) const {
-        assert( m_Nodes.find(nodeId) == m_Nodes.end() );
-        int nodeKin = 0;
-        int nodeKout = 0;
-        StreamGraph::AdjacencyIterator iterNode = m_Graph->Iterator( nodeId );
-        while( iterNode.HasNext() ) {
-            unsigned int neighbor = iterNode.Next();
-            assert( neighbor != nodeId );
-            if( Exists( neighbor ) ) ++nodeKin;
-            else ++nodeKout;
+    Community* Community::Find() const {
+        Community* root = m_Parent;
+        while( root->m_Parent != root ) root = root->m_Parent;
+        // Path compression, only writes while there are unreconciled merges.
+        Community* community = m_Parent;
+        while( community != root ) {
+            Community* next = community->m_Parent;
+            community->m_Parent = root;
+            community = next;
         }
-        // New score
-        newKin = m_Kin + 2*nodeKin;
-        newKout = m_Kout - nodeKin;
-        newKout += nodeKout;
+        if( m_Parent != root ) m_Parent = root;
+        return root;
+    }
+
+    void Community::Absorb( Community* other, const int cut ) {
+        assert( other != this && other->m_Parent == other );
+        int kin = m_Kin + other->m_Kin + InternalWeight( m_Graph )*cut;
+        int kout = m_Kout + other->m_Kout - 2*cut;
+        m_Kin = kin > 0 ? kin : 0;
+        m_Kout = kout > 0 ? kout : 0;
+        m_Size += other->m_Size;
+        m_InternalTriangles += other->m_InternalTriangles;
+        m_TriangleVolume += other->m_TriangleVolume;
+        m_Partner = NULL;
+        m_PartnerEdges = 0;
+        other->m_Parent = this;
+        m_Absorbed.push_back( other );
+    }
+
+    double Community::TestMerge( const Community* other, const int cut ) const {
+        int kin = m_Kin + other->m_Kin + InternalWeight( m_Graph )*cut;
+        int kout = m_Kout + other->m_Kout - 2*cut;
+        if( kin < 0 ) kin = 0;
+        if( kout < 0 ) kout = 0;
+        int size = m_Size + other->m_Size;
+        int denom = kin + kout + (size+1)*size - kin;
+        double score = Ratio( kin, denom );
+        if( m_TriangleCounter == NULL ) return score;
+        return ScoreTriangles( score, m_InternalTriangles + other->m_InternalTriangles, m_TriangleVolume + other->m_TriangleVolume );
+    }
+
+    const std::vector<Community*>& Community::Absorbed() const {
+        return m_Absorbed;
+    }
+
+    void Community::Adopt( Community* absorbed ) {
+        m_Nodes.insert( absorbed->m_Nodes.begin(), absorbed->m_Nodes.end() );
+        absorbed->m_Nodes.clear();
+        absorbed->m_Absorbed.clear();
+    }
+
+    void Community::ClearAbsorbed() {
+        m_Absorbed.clear();
+    }
+
+    int Community::Observe( const Community* other ) {
+        if( m_Partner == other ) return ++m_PartnerEdges;
+        if( m_PartnerEdges > 0 ) {
+            m_PartnerEdges--;
+            return 0;
+        }
+        m_Partner = other;
+        m_PartnerEdges = 1;
+        return 1;
+    }
+
+    double Community::TestInsert( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout, unsigned long long& newTriangles ) const {
+        assert( !Exists( nodeId ) );
+        int nodeDegree;
+        int nodeKin = RetainedKin( nodeId, nodeDegree );
+        int nodeKout = nodeDegree - nodeKin;
+        if( m_Sketch != NULL && m_Sketch->Enabled() ) {
+            m_Sketch->Combine( nodeId, m_CommunityId, nodeKin, nodeDegree, nodeKin, nodeKout );
+        }
+        // New score, clamped since the estimates of the evicted edges may overlap with the edges already counted.
+        int kin = m_Kin + InternalWeight( m_Graph )*nodeKin;
+        int kout = m_Kout - nodeKin + nodeKout;
+        newKin = kin > 0 ? kin : 0;
+        newKout = kout > 0 ? kout : 0;
+        newTriangles = m_InternalTriangles + InternalTriangles( nodeId, nodeKin, nodeKout );
         int denom = newKin + newKout + (this->Size()+1)*(this->Size()) - newKin;
-        return denom > 0 ? newKin / (double)denom : 0;
+        double score = Ratio( newKin, denom );
+        if( m_TriangleCounter == NULL ) return score;
+        return ScoreTriangles( score, newTriangles, m_TriangleVolume + m_TriangleCounter->NodeTriangles( nodeId ) );
     }
 
-    double Community::TestRemove( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout ) const {
-        assert( m_Nodes.find(nodeId) != m_Nodes.end() );
-        int nodeKin = 0;
-        int nodeKout = 0;
-        StreamGraph::AdjacencyIterator iterNode = m_Graph->Iterator( nodeId );
-//        std::cout << "NEIGHBORS node " << nodeId;
-        while( iterNode.HasNext() ) {
-            unsigned int neighbor = iterNode.Next();
-            assert( neighbor != nodeId );
- //           std::cout << " " << neighbor;
-            if( Exists( neighbor ) ) ++nodeKin;
-            else ++nodeKout;
+    double Community::TestRemove( unsigned int nodeId, unsigned int& newKin, unsigned int& newKout, unsigned long long& newTriangles ) const {
+        assert( Exists( nodeId ) );
+        int nodeDegree;
+        int nodeKin = RetainedKin( nodeId, nodeDegree );
+        int nodeKout = nodeDegree - nodeKin;
+        if( m_Sketch != NULL && m_Sketch->Enabled() ) {
+            m_Sketch->Combine( nodeId, m_CommunityId, nodeKin, nodeDegree, nodeKin, nodeKout );
         }
-  //      std::cout << std::endl;;
-        // New score
-        newKin = m_Kin - 2*nodeKin;
-        newKout = m_Kout + nodeKin;
-        newKout -= nodeKout;
+        // New score, clamped since the estimates of the evicted edges may have changed since the node was inserted.
+        int kin = m_Kin - InternalWeight( m_Graph )*nodeKin;
+        int kout = m_Kout + nodeKin - nodeKout;
+        newKin = kin > 0 ? kin : 0;
+        newKout = kout > 0 ? kout : 0;
+        unsigned long long nodeTriangles = InternalTriangles( nodeId, nodeKin, nodeKout );
+        newTriangles = m_InternalTriangles > nodeTriangles ? m_InternalTriangles - nodeTriangles : 0;
         int denom = newKin + newKout + (this->Size()-1)*(this->Size()-2) - newKin;
-        return denom > 0 ? newKin / (double)denom : 0;
+        double score = Ratio( newKin, denom );
+        if( m_TriangleCounter == NULL ) return score;
+        unsigned long long volume = m_TriangleCounter->NodeTriangles( nodeId );
+        return ScoreTriangles( score, newTriangles, m_TriangleVolume > volume ? m_TriangleVolume - volume : 0 );
     }
 
+    int Community::RetainedKin( unsigned int nodeId, int& nodeDegree ) const {
+        const NeighborCounts& counts = m_Graph->Counts();
+        if( counts.Enabled() ) {
+            nodeDegree = counts.Degree( nodeId );
+            return counts.Count( nodeId, Label( this, nodeId ) );
+        }
+        int nodeKin = 0;
+        unsigned int numNeighbors;
+        const unsigned int* weights = GatherNeighbors( m_Graph, nodeId, numNeighbors );
+        const unsigned int* neighbors = t_Neighbors.data();
+        nodeDegree = numNeighbors;
+        if( weights == NULL ) {
+            for( unsigned int i = 0; i < numNeighbors; ++i ) {
+                assert( neighbors[i] != nodeId );
+                nodeKin += Exists( neighbors[i] );
+            }
+        } else {
+            nodeDegree = 0;
+            for( unsigned int i = 0; i < numNeighbors; ++i ) {
+                assert( neighbors[i] != nodeId );
+                if( Exists( neighbors[i] ) ) nodeKin += weights[i];
+                nodeDegree += weights[i];
+            }
+        }
+        return nodeKin;
+    }
+
+
     double Community::TestInsert( unsigned int nodeId ) const {
         unsigned int kin;
         unsigned int kout;
-        return TestInsert( nodeId, kin, kout );
+        unsigned long long triangles;
+        return TestInsert( nodeId, kin, kout, triangles );
     }
 
     double Community::TestRemove( unsigned int nodeId ) const {
         unsigned int kin;
         unsigned int kout;
-        return TestRemove( nodeId, kin, kout );
+        unsigned long long triangles;
+        return TestRemove( nodeId, kin, kout, triangles );
     }
 
     double Community::Score() const {
         int denom = m_Kin + m_Kout + (Size()+1)*(Size()) - m_Kin;
-        double score = denom > 0 ? m_Kin / (double)denom : 0;
+        double score = Ratio( m_Kin, denom );
+        score = ScoreTriangles( score, m_InternalTriangles, m_TriangleVolume );
         assert((score <= 1.0) && (score >= 0.0));
         return score;
     }
 
+    unsigned long long Community::InternalTriangles( unsigned int nodeId, int nodeKin, int nodeKout ) const {
+        if( m_TriangleCounter == NULL || !m_TriangleCounter->Enabled() ) return 0;
+        int degree = nodeKin + nodeKout;
+        if( degree <= 0 ) return 0;
+        // A triangle of the node is inside the community when both of its other nodes are.
+        double share = nodeKin / (double)degree;
+        return (unsigned long long)(m_TriangleCounter->NodeTriangles( nodeId )*share*share);
+    }
+
+    double Community::ScoreTriangles( double score, unsigned long long internal, unsigned long long volume ) const {
+        if( m_TriangleCounter == NULL || !m_TriangleCounter->Scoring() || volume == 0 ) return score;
+        // Every internal triangle adds to the triangles of three members.
+        double closed = 3.0*internal/volume;
+        if( closed > 1.0 ) closed = 1.0;
+        return score + (1.0 - score)*score*closed;
+    }
+
+    double Community::TestInsertSingleton( const StreamGraph* graph, const DegreeSketch* sketch, unsigned int singleton, int kout, unsigned int nodeId ) {
+        assert( singleton != nodeId );
+        int nodeKin = 0;
+        int nodeDegree;
+        const NeighborCounts& counts = graph->Counts();
+        if( counts.Enabled() ) {
+            nodeDegree = counts.Degree( nodeId );
+            nodeKin = counts.Count( nodeId, Label( NULL, singleton ) );
+        } else {
+            unsigned int numNeighbors;
+            const unsigned int* weights = GatherNeighbors( graph, nodeId, numNeighbors );
+            const unsigned int* neighbors = t_Neighbors.data();
+            nodeDegree = numNeighbors;
+            if( weights == NULL ) {
+                for( unsigned int i = 0; i < numNeighbors; ++i ) {
+                    nodeKin += neighbors[i] == singleton;
+                }
+            } else {
+                nodeDegree = 0;
+                for( unsigned int i = 0; i < numNeighbors; ++i ) {
+                    if( neighbors[i] == singleton ) nodeKin += weights[i];
+                    nodeDegree += weights[i];
+                }
+            }
+        }
+        int nodeKout = nodeDegree - nodeKin;
+        if( sketch != NULL && sketch->Enabled() ) {
+            sketch->Combine( nodeId, singleton, nodeKin, nodeDegree, nodeKin, nodeKout );
+        }
+        // Same as TestInsert with a community of size 1 and no internal edges.
+        int newKin = InternalWeight( graph )*nodeKin;
+        int newKout = kout - nodeKin + nodeKout;
+        if( newKout < 0 ) newKout = 0;
+        int denom = newKin + newKout + 2*1 - newKin;
+        return Ratio( newKin, denom );
+    }
+
+    unsigned long long Community::Label( const Community* community, unsigned int nodeId ) {
+        return community != NULL ? (unsigned long long)community : ((1ULL << 63) | nodeId);
+    }
+
+    int Community::Kin() const {
+        return m_Kin;
+    }
+
+    int Community::Kout() const {
+        return m_Kout;
+    }
+
+    unsigned long long Community::InternalTriangles() const {
+        return m_InternalTriangles;
+    }
+
+    unsigned long long Community::TriangleVolume() const {
+        return m_TriangleVolume;
+    }
+
+    void Community::SignalTriangle( const unsigned long long weight, const bool internal ) {
+        m_TriangleVolume += weight;
+        if( internal ) m_InternalTriangles += weight;
+    }
+
     unsigned int Community::Id() const {
         return m_CommunityId;
     }
@@ -153,21 +404,76 @@ namespace flowing {
         return CommunityIterator( this );
     }
 
-    void Community::SignalInsertInternalEdge() {
-        m_Kin += 2;
+    void Community::SignalInsertInternalEdge( const int weight ) {
+        m_Kin += InternalWeight( m_Graph )*weight;
         assert( m_Kin >= 0 );
     }
 
-    void Community::SignalInsertExternalEdge() {
-        m_Kout += 1;
+    void Community::SignalInsertExternalEdge( const int weight ) {
+        m_Kout += weight;
     }
 
-    void Community::SignalRemoveInternalEdge() {
-        m_Kin -= 2;
+    void Community::SignalRemoveInternalEdge( const int weight ) {
+        m_Kin -= InternalWeight( m_Graph )*weight;
         assert( m_Kin >= 0 );
     }
 
-    void Community::SignalRemoveExternalEdge() {
-        m_Kout -= 1;
+    void Community::SignalRemoveExternalEdge( const int weight ) {
+        m_Kout -= weight;
+        assert( m_Kout >= 0 );
+    }
+
+    // COMMUNITY POOL METHODS
+
+    CommunityPool::CommunityPool( StreamGraph* graph, const DegreeSketch* sketch, const TriangleCounter* triangles, const int chunkSize ) :
+        m_Graph( graph ),
+        m_Sketch( sketch ),
+        m_Triangles( triangles ),
+        m_ChunkSize( chunkSize > 0 ? chunkSize : 1 ),
+        m_NumInChunk( 0 ) {
+    }
+
+    CommunityPool::~CommunityPool() {
+        for( unsigned int i = 0; i < m_Chunks.size(); ++i ) {
+            int numConstructed = i + 1 < m_Chunks.size() ? m_ChunkSize : m_NumInChunk;
+            for( int j = 0; j < numConstructed; ++j ) {
+                m_Chunks[i][j].~Community();
+            }
+            ::operator delete( m_Chunks[i] );
+        }
+    }
+
+    Community* CommunityPool::Allocate( unsigned int id, int kin, int kout ) {
+        if( !m_Free.empty() ) {
+            Community* community = m_Free.back();
+            m_Free.pop_back();
+            community->Reset( id, kin, kout );
+            return community;
+        }
+        if( m_Chunks.empty() || m_NumInChunk == m_ChunkSize ) {
+            m_Chunks.push_back( static_cast<Community*>( ::operator new( sizeof(Community)*m_ChunkSize ) ) );
+            m_NumInChunk = 0;
+        }
+        Community* community = new (&m_Chunks.back()[m_NumInChunk++]) Community( m_Graph, id, m_Sketch, m_Triangles );
+        community->m_Kin = kin;
+        community->m_Kout = kout;
+        return community;
+    }
+
+    void CommunityPool::Free( Community* community ) {
+        m_Free.push_back( community );
+    }
+
+    int CommunityPool::NumUsed() const {
+        return NumConstructed() - m_Free.size();
+    }
+
+    int CommunityPool::NumConstructed() const {
+        return m_Chunks.empty() ? 0 : (m_Chunks.size() - 1)*m_ChunkSize + m_NumInChunk;
+    }
+
+    size_t CommunityPool::Bytes() const {
+        return m_Chunks.size()*(m_ChunkSize*sizeof(Community) + FLOWING_MALLOC_OVERHEAD) +
+               (m_Chunks.capacity() + m_Free.capacity())*sizeof(Community*);
     }
 }
@@ -0,0 +1,184 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CommunityDetector.h"
+
+namespace flowing {
+
+    CommunityDetector::CommunityDetector( const StreamGraph::EdgeMode mode, const int batchSize ) :
+        m_Graph( mode,
+                 InsertEdges,
+                 RemoveEdges,
+                 NodeDataAllocate,
+                 NodeDataFree,
+                 batchSize ),
+        m_Structure( &m_Graph ),
+        m_Partitioner( &m_Graph ),
+        m_Initialized( false ) {
+        m_Graph.SetUserData( this );
+        m_Graph.SetNodeDataUsage( NodeDataUsage );
+    }
+
+    CommunityDetector::~CommunityDetector() {
+        Close();
+    }
+
+    void CommunityDetector::InsertEdges( StreamGraph* graph, Edge* edges, int numEdges ) {
+        CommunityDetector* detector = static_cast<CommunityDetector*>(graph->GetUserData());
+        detector->m_Structure.Insert( edges, numEdges );
+        detector->m_Partitioner.Insert( edges, numEdges, graph->EdgeWeight() );
+    }
+
+    void CommunityDetector::RemoveEdges( StreamGraph* graph, Edge* edges, int numEdges ) {
+        CommunityDetector* detector = static_cast<CommunityDetector*>(graph->GetUserData());
+        detector->m_Structure.Remove( edges, numEdges );
+        detector->m_Partitioner.Remove( edges, numEdges );
+    }
+
+    void* CommunityDetector::NodeDataAllocate( StreamGraph* graph, unsigned int nodeId ) {
+        CommunityDetector* detector = static_cast<CommunityDetector*>(graph->GetUserData());
+        detector->m_Partitioner.ResetNode( nodeId );
+        return detector->m_Structure.AllocateNode( nodeId );
+    }
+
+    void CommunityDetector::NodeDataFree( StreamGraph* graph, unsigned int nodeId, void* nodeData ) {
+        CommunityDetector* detector = static_cast<CommunityDetector*>(graph->GetUserData());
+        detector->m_Structure.FreeNode( nodeId );
+        detector->m_Partitioner.Retire( nodeId );
+    }
+
+    bool CommunityDetector::NodeReclaim( StreamGraph* graph, unsigned int nodeId, void* nodeData ) {
+        CommunityDetector* detector = static_cast<CommunityDetector*>(graph->GetUserData());
+        if( !detector->m_Structure.Reclaim( nodeId ) ) return false;
+        detector->m_Partitioner.Retire( nodeId, true );
+        return true;
+    }
+
+    unsigned long long CommunityDetector::NodeLabel( const StreamGraph* graph, unsigned int nodeId ) {
+        return static_cast<const CommunityDetector*>(graph->GetUserData())->m_Structure.CommunityKey( nodeId );
+    }
+
+    void CommunityDetector::NodeDataUsage( const StreamGraph* graph, MemoryUsage& usage ) {
+        const CommunityDetector* detector = static_cast<const CommunityDetector*>(graph->GetUserData());
+        detector->m_Structure.AddMemoryUsage( usage );
+        detector->m_Partitioner.AddMemoryUsage( usage );
+    }
+
+    StreamGraph& CommunityDetector::Graph() {
+        return m_Graph;
+    }
+
+    CommunityStructure& CommunityDetector::Structure() {
+        return m_Structure;
+    }
+
+    void CommunityDetector::SetWriter( CommunityWriter* writer ) {
+        m_Structure.SetWriter( writer );
+    }
+
+    void CommunityDetector::SetReclaimNodes( const bool reclaim ) {
+        m_Graph.SetReclaimNodes( reclaim ? NodeReclaim : NULL );
+    }
+
+    void CommunityDetector::SetNeighborCounts( const bool enabled ) {
+        m_Graph.SetNeighborLabels( enabled ? NodeLabel : NULL );
+    }
+
+    void CommunityDetector::EnablePartitioning( const int numParts, const StreamPartitioner::Method method ) {
+        m_Partitioner.Configure( numParts, method );
+    }
+
+    StreamPartitioner& CommunityDetector::Partitioner() {
+        return m_Partitioner;
+    }
+
+    bool CommunityDetector::Initialize() {
+        m_Initialized = m_Graph.Initialize();
+        return m_Initialized;
+    }
+
+    void CommunityDetector::Push( const Edge* edges, const size_t numEdges ) {
+        for( size_t i = 0; i < numEdges; ++i ) {
+            m_Graph.Push( edges[i].m_Tail, edges[i].m_Head );
+        }
+    }
+
+    void CommunityDetector::Push( const unsigned int* tails, const unsigned int* heads, const size_t numEdges ) {
+        for( size_t i = 0; i < numEdges; ++i ) {
+            m_Graph.Push( tails[i], heads[i] );
+        }
+    }
+
+    void CommunityDetector::Push( EdgeReader& reader ) {
+        m_Graph.Push( reader );
+    }
+
+    void CommunityDetector::Push( EdgeServer& server ) {
+        m_Graph.Push( server );
+    }
+
+    size_t CommunityDetector::NumNodes() const {
+        return m_Graph.NumLiveNodes();
+    }
+
+    size_t CommunityDetector::Assignments( unsigned int* nodes, unsigned int* communities, const size_t maxNodes ) {
+        m_Graph.Flush();
+        size_t count = 0;
+        unsigned int numNodes = m_Graph.NumNodes();
+        for( unsigned int i = 0; i < numNodes && count < maxNodes; ++i ) {
+            if( m_Graph.IsReclaimed( i ) ) continue;
+            Community* community = m_Structure.GetCommunity( i );
+            if( community != NULL ) m_Structure.Reconcile( community );
+            // The members are sorted, so the first one is the smallest.
+            unsigned int representative = community != NULL ? community->Iterator().Next() : i;
+            nodes[count] = m_Graph.Remap( i );
+            communities[count] = m_Graph.Remap( representative );
+            count++;
+        }
+        return count;
+    }
+
+    size_t CommunityDetector::Partitions( unsigned int* nodes, int* parts, const size_t maxNodes ) {
+        Flush();
+        size_t count = 0;
+        unsigned int numNodes = m_Graph.NumNodes();
+        for( unsigned int i = 0; i < numNodes && count < maxNodes; ++i ) {
+            if( m_Graph.IsReclaimed( i ) ) continue;
+            nodes[count] = m_Graph.Remap( i );
+            parts[count] = m_Partitioner.Part( i );
+            count++;
+        }
+        return count;
+    }
+
+    CommunityStructure::RefineStats CommunityDetector::Refine( const double timeBudget, const int numThreads ) {
+        // The refinement scans the adjacencies, so the edges they hold must all be in the community counters.
+        m_Graph.Flush();
+        return m_Structure.Refine( timeBudget, numThreads, FLOWING_REFINE_MAX_ROUNDS );
+    }
+
+    void CommunityDetector::Flush() {
+        m_Graph.Flush();
+        m_Partitioner.Flush();
+    }
+
+    void CommunityDetector::Close() {
+        if( !m_Initialized ) return;
+        // The pending nodes are placed while their adjacencies are still there.
+        Flush();
+        m_Graph.Close();
+        m_Structure.Flush();
+        m_Initialized = false;
+    }
+}
@@ -0,0 +1,646 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CommunityStructure.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unordered_set>
+#include <assert.h>
+
+namespace flowing {
+
+    CommunityStructure::CommunityStructure( StreamGraph* graph ) :
+        m_Graph( graph ),
+        m_Sketch( graph ),
+        m_Triangles( graph ),
+        m_Pool( graph, &m_Sketch, &m_Triangles ),
+        m_NumMembers( 0 ),
+        m_Writer( NULL ),
+        m_NumCompacted( 0 ),
+        m_NumLabels( 0 ),
+        m_MergeEvidence( 0 ),
+        m_NumMerges( 0 ),
+        m_NumAbsorbed( 0 ) {
+    }
+
+    CommunityStructure::~CommunityStructure() {
+    }
+
+    void CommunityStructure::InsertEdges( StreamGraph* graph, Edge* edges, int numEdges ) {
+        static_cast<CommunityStructure*>(graph->GetUserData())->Insert( edges, numEdges );
+    }
+
+    void CommunityStructure::RemoveEdges( StreamGraph* graph, Edge* edges, int numEdges ) {
+        static_cast<CommunityStructure*>(graph->GetUserData())->Remove( edges, numEdges );
+    }
+
+    void* CommunityStructure::NodeDataAllocate( StreamGraph* graph, unsigned int nodeId ) {
+        return static_cast<CommunityStructure*>(graph->GetUserData())->AllocateNode( nodeId );
+    }
+
+    void CommunityStructure::NodeDataFree( StreamGraph* graph, unsigned int nodeId, void* nodeData ) {
+        static_cast<CommunityStructure*>(graph->GetUserData())->FreeNode( nodeId );
+    }
+
+    bool CommunityStructure::NodeReclaim( StreamGraph* graph, unsigned int nodeId, void* nodeData ) {
+        return static_cast<CommunityStructure*>(graph->GetUserData())->Reclaim( nodeId );
+    }
+
+    void* CommunityStructure::AllocateNode( unsigned int nodeId ) {
+        if( nodeId >= m_SingletonKout.size() ) m_SingletonKout.resize( nodeId + 1 );
+        m_SingletonKout[nodeId] = 0;
+        if( nodeId >= m_Written.size() ) m_Written.resize( nodeId + 1 );
+        m_Written[nodeId] = false;
+        m_Triangles.ResetNode( nodeId );
+        return NULL;
+    }
+
+    void CommunityStructure::FreeNode( unsigned int nodeId ) {
+        if( m_Writer == NULL ) return;
+        if( m_Reclaimed.empty() ) {
+            Write( nodeId );
+            return;
+        }
+        // A node may have been written with an earlier label, so the live ones wait for Flush.
+        Community* community = GetCommunity( nodeId );
+        if( community != NULL ) Reconcile( community );
+        LiveNode live;
+        live.m_Node = m_Graph->Remap( nodeId );
+        live.m_Label = ~0U;
+        unsigned int representative = community != NULL ? community->Iterator().Next() : nodeId;
+        live.m_Key = (1ULL << 32) | representative;
+        m_Live.push_back( live );
+    }
+
+    unsigned long long CommunityStructure::NodeLabel( const StreamGraph* graph, unsigned int nodeId ) {
+        return static_cast<const CommunityStructure*>(graph->GetUserData())->CommunityKey( nodeId );
+    }
+
+    void CommunityStructure::NodeDataUsage( const StreamGraph* graph, MemoryUsage& usage ) {
+        static_cast<const CommunityStructure*>(graph->GetUserData())->AddMemoryUsage( usage );
+    }
+
+    void CommunityStructure::AddMemoryUsage( MemoryUsage& usage ) const {
+        usage.m_Bytes[MEMORY_COMMUNITIES] += m_Pool.Bytes() + m_NumMembers*FLOWING_TREE_NODE_BYTES +
+                                             m_SingletonKout.capacity()*sizeof(int) + m_Written.capacity()/8 +
+                                             m_Reclaimed.capacity()*sizeof(LabeledNode) + m_Live.capacity()*sizeof(LiveNode);
+        usage.m_Bytes[MEMORY_SKETCH] += m_Sketch.Bytes();
+        usage.m_Bytes[MEMORY_TRIANGLES] += m_Triangles.Bytes();
+    }
+
+    void CommunityStructure::EnableFullDegree( const unsigned int width, const unsigned int depth ) {
+        m_Sketch.Configure( true, width, depth );
+    }
+
+    void CommunityStructure::EnableTriangles( const bool scoring ) {
+        m_Triangles.Configure( true, scoring );
+    }
+
+    void CommunityStructure::EnableMerging( const int evidence ) {
+        m_MergeEvidence = evidence > 0 ? evidence : 0;
+    }
+
+    unsigned long long CommunityStructure::NumMerges() const {
+        return m_NumMerges;
+    }
+
+    void CommunityStructure::Reconcile( Community* community ) {
+        if( community->Absorbed().empty() ) return;
+        m_Pending.assign( community->Absorbed().begin(), community->Absorbed().end() );
+        community->ClearAbsorbed();
+        while( !m_Pending.empty() ) {
+            Community* absorbed = const_cast<Community*>(m_Pending.back());
+            m_Pending.pop_back();
+            m_Pending.insert( m_Pending.end(), absorbed->Absorbed().begin(), absorbed->Absorbed().end() );
+            Community::CommunityIterator members = absorbed->Iterator();
+            while( members.HasNext() ) {
+                m_Graph->SetNodeData( members.Next(), community );
+            }
+            community->Adopt( absorbed );
+            m_Pool.Free( absorbed );
+            m_NumAbsorbed--;
+        }
+    }
+
+    const TriangleCounter& CommunityStructure::Triangles() const {
+        return m_Triangles;
+    }
+
+    void CommunityStructure::SetWriter( CommunityWriter* writer ) {
+        m_Writer = writer;
+    }
+
+    void CommunityStructure::Insert( const Edge* edges, int numEdges ) {
+        int weight = m_Graph->EdgeWeight();
+        // The whole batch is already in the adjacencies, so it is counted before any of its edges moves a
+        // node, and every retained edge is in the sketch when RekeySketch moves it.
+        for( int i = 0; m_Sketch.Enabled() && i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            if( tail != head ) {
+                m_Sketch.Count( tail, CommunityId( head ), weight );
+                m_Sketch.Count( head, CommunityId( tail ), weight );
+            }
+        }
+        // A move recomputes the degrees of the node from its adjacencies, where the whole batch already is,
+        // so every edge of the batch is accounted before any node moves.
+        if( m_Triangles.Enabled() ) m_Triangles.BeginBatch( edges, numEdges );
+        for( int i = 0; i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            if( m_Triangles.Enabled() ) CountTriangles( tail, head, weight );
+            Community* tailCommunity = GetCommunity( tail );
+            Community* headCommunity = GetCommunity( head );
+            if( tail == head && tailCommunity == NULL ) {
+                tailCommunity = headCommunity = Materialize( tail );
+            }
+            if( (tailCommunity != headCommunity) || (tailCommunity == NULL) ) {
+                SignalExternalEdge( tail, tailCommunity, weight );
+                SignalExternalEdge( head, headCommunity, weight );
+            } else {
+                tailCommunity->SignalInsertInternalEdge( weight );
+            }
+        }
+        for( int i = 0; i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            Community* tailCommunity = GetCommunity( tail );
+            Community* headCommunity = GetCommunity( head );
+            if( (tailCommunity != headCommunity) || (tailCommunity == NULL) ) {
+                if( m_MergeEvidence > 0 && tailCommunity != NULL && headCommunity != NULL ) {
+                    int evidence = tailCommunity->Observe( headCommunity );
+                    int headEvidence = headCommunity->Observe( tailCommunity );
+                    if( headEvidence > evidence ) evidence = headEvidence;
+                    if( evidence >= m_MergeEvidence && TryMerge( tailCommunity, headCommunity ) ) continue;
+                }
+                double currentStore = Score( tail ) + Score( head );
+                double tailToHead = TestRemove( tail ) + TestInsert( head, tail );
+                double headToTail = TestInsert( tail, head ) + TestRemove( head );
+                if( ( currentStore < headToTail ) || ( currentStore < tailToHead ) ) {
+                    if( tailToHead > headToTail ) {
+                        Move( tail, head );
+                    } else {
+                        Move( head, tail );
+                    }
+                }
+            }
+        }
+    }
+
+    void CommunityStructure::Remove( const Edge* edges, int numEdges ) {
+        // With full degree scoring the evicted edges still count towards the community degrees.
+        if( m_Sketch.Enabled() ) return;
+        int weight = m_Graph->EdgeWeight();
+        for( int i = 0; i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            Community* tailCommunity = GetCommunity( tail );
+            Community* headCommunity = GetCommunity( head );
+            if( (tailCommunity != headCommunity) || (tailCommunity == NULL) ) {
+                SignalExternalEdge( tail, tailCommunity, -weight );
+                SignalExternalEdge( head, headCommunity, -weight );
+            } else {
+                tailCommunity->SignalRemoveInternalEdge( weight );
+            }
+        }
+    }
+
+    Community* CommunityStructure::GetCommunity( unsigned int nodeId ) const {
+        Community* community = static_cast<Community*>(m_Graph->GetNodeData( nodeId ));
+        return community != NULL ? community->Find() : NULL;
+    }
+
+    double CommunityStructure::Score( unsigned int nodeId ) const {
+        // A singleton has no internal edges, so its score is always 0.
+        Community* community = GetCommunity( nodeId );
+        return community != NULL ? community->Score() : 0.0;
+    }
+
+    double CommunityStructure::TestRemove( unsigned int nodeId ) const {
+        // Removing the only node of a singleton leaves an empty community, whose score is 0.
+        Community* community = GetCommunity( nodeId );
+        return community != NULL ? community->TestRemove( nodeId ) : 0.0;
+    }
+
+    double CommunityStructure::TestInsert( unsigned int target, unsigned int nodeId ) const {
+        Community* community = GetCommunity( target );
+        if( community != NULL ) return community->TestInsert( nodeId );
+        return Community::TestInsertSingleton( m_Graph, &m_Sketch, target, m_SingletonKout[target], nodeId );
+    }
+
+    void CommunityStructure::Move( unsigned int nodeId, unsigned int target ) {
+        // Taken first, since releasing the old community may return it to the pool.
+        unsigned long long label = CommunityKey( nodeId );
+        unsigned int id = CommunityId( nodeId );
+        Community* to = Materialize( target );
+        Community* from = GetCommunity( nodeId );
+        assert( from != to );
+        if( from != NULL ) {
+            from->Remove( nodeId );
+            m_NumMembers--;
+            Release( from );
+        }
+        to->Insert( nodeId );
+        m_NumMembers++;
+        m_Graph->SetNodeData( nodeId, to );
+        m_Graph->Relabel( nodeId, label, Community::Label( to, nodeId ) );
+        RekeySketch( nodeId, id, to->Id() );
+    }
+
+    int CommunityStructure::NumCommunities() const {
+        return m_Pool.NumUsed() - m_NumAbsorbed;
+    }
+
+    bool CommunityStructure::TryMerge( Community* first, Community* second ) {
+        Community* large = first->Size() >= second->Size() ? first : second;
+        Community* small = large == first ? second : first;
+        int size = large->Size() + small->Size();
+        double apart = large->Size()*large->Score() + small->Size()*small->Score();
+        // Every edge between the communities is external to both, which bounds the cut before scanning it.
+        int bound = large->Kout() < small->Kout() ? large->Kout() : small->Kout();
+        if( size*large->TestMerge( small, bound ) <= apart ) return false;
+        int cut = CountCut( small, large, bound );
+        if( size*large->TestMerge( small, cut ) <= apart ) return false;
+        if( m_Graph->Counts().Enabled() || m_Sketch.Counting() ) RelabelMembers( small, large );
+        large->Absorb( small, cut );
+        m_NumAbsorbed++;
+        m_NumMerges++;
+        return true;
+    }
+
+    int CommunityStructure::CountCut( const Community* community, const Community* other, const int bound ) {
+        int cut = 0;
+        UVector& neighbors = m_CutNeighbors;
+        UVector* weights = m_Graph->Weighted() ? &m_CutWeights : NULL;
+        const NeighborCounts& counts = m_Graph->Counts();
+        m_Pending.assign( 1, community );
+        while( !m_Pending.empty() ) {
+            const Community* current = m_Pending.back();
+            m_Pending.pop_back();
+            m_Pending.insert( m_Pending.end(), current->Absorbed().begin(), current->Absorbed().end() );
+            Community::CommunityIterator members = current->Iterator();
+            while( members.HasNext() ) {
+                unsigned int member = members.Next();
+                int memberDegree = 0;
+                int memberKin = 0;
+                if( counts.Enabled() ) {
+                    memberDegree = counts.Degree( member );
+                    memberKin = counts.Count( member, Community::Label( other, member ) );
+                } else {
+                    unsigned int numNeighbors = m_Graph->Neighbors( member, neighbors, StreamGraph::BOTH, weights );
+                    for( unsigned int i = 0; i < numNeighbors; ++i ) {
+                        unsigned int weight = weights != NULL ? (*weights)[i] : 1;
+                        if( GetCommunity( neighbors[i] ) == other ) memberKin += weight;
+                        memberDegree += weight;
+                    }
+                }
+                if( m_Sketch.Enabled() ) {
+                    int memberKout;
+                    m_Sketch.Combine( member, other->Id(), memberKin, memberDegree, memberKin, memberKout );
+                }
+                cut += memberKin;
+                // The sketch corrects the count of every member, but the exact count cannot grow past the bound.
+                if( cut >= bound && !m_Sketch.Enabled() ) return bound;
+            }
+        }
+        return cut;
+    }
+
+    void CommunityStructure::RelabelMembers( const Community* community, const Community* other ) {
+        unsigned long long label = Community::Label( community, 0 );
+        unsigned long long otherLabel = Community::Label( other, 0 );
+        m_Pending.assign( 1, community );
+        while( !m_Pending.empty() ) {
+            const Community* current = m_Pending.back();
+            m_Pending.pop_back();
+            m_Pending.insert( m_Pending.end(), current->Absorbed().begin(), current->Absorbed().end() );
+            Community::CommunityIterator members = current->Iterator();
+            while( members.HasNext() ) {
+                unsigned int member = members.Next();
+                m_Graph->Relabel( member, label, otherLabel );
+                RekeySketch( member, community->Id(), other->Id() );
+            }
+        }
+    }
+
+    CommunityStructure::RefineStats CommunityStructure::Refine( const double timeBudget, const int numThreads, const int maxRounds ) {
+        RefineStats stats;
+        stats.m_NumRounds = 0;
+        stats.m_NumMoves = 0;
+        stats.m_NumConflicts = 0;
+        double start = Now();
+        double deadline = start + timeBudget;
+        unsigned int numWorkers = numThreads > 0 ? numThreads : 1;
+        std::vector< std::vector<MoveCandidate> > moves( numWorkers );
+        // The evaluation threads only read the communities, so no merge may be left to reconcile.
+        for( unsigned int i = 0; m_NumAbsorbed > 0 && i < m_Graph->NumNodes(); ++i ) {
+            Community* community = GetCommunity( i );
+            if( community != NULL ) Reconcile( community );
+        }
+        while( stats.m_NumRounds < maxRounds && Now() < deadline ) {
+            stats.m_NumRounds++;
+
+            // Evaluation phase: the communities are only read, so the nodes are split among the threads.
+            std::vector<std::thread> workers;
+            for( unsigned int i = 1; i < numWorkers; ++i ) {
+                workers.push_back( std::thread( &CommunityStructure::EvaluateMoves, this, i, numWorkers, deadline, &moves[i] ) );
+            }
+            EvaluateMoves( 0, numWorkers, deadline, &moves[0] );
+            for( unsigned int i = 0; i < workers.size(); ++i ) {
+                workers[i].join();
+            }
+            std::vector<MoveCandidate> candidates;
+            for( unsigned int i = 0; i < numWorkers; ++i ) {
+                candidates.insert( candidates.end(), moves[i].begin(), moves[i].end() );
+            }
+            std::sort( candidates.begin(), candidates.end(), []( const MoveCandidate& a, const MoveCandidate& b ) { return a.m_Gain > b.m_Gain; } );
+
+            // Apply phase: a move is only valid while its source and destination communities are
+            // the ones it was evaluated against, so each community takes part in one move per round.
+            std::unordered_set<unsigned long long> touched;
+            int numApplied = 0;
+            for( unsigned int i = 0; i < candidates.size(); ++i ) {
+                if( (i % FLOWING_REFINE_CHECK_INTERVAL == 0) && Now() >= deadline ) break;
+                const MoveCandidate& move = candidates[i];
+                unsigned long long from = CommunityKey( move.m_Node );
+                unsigned long long to = CommunityKey( move.m_Target );
+                if( from == to || touched.count( from ) > 0 || touched.count( to ) > 0 ) {
+                    stats.m_NumConflicts++;
+                    continue;
+                }
+                Move( move.m_Node, move.m_Target );
+                touched.insert( from );
+                touched.insert( to );
+                // A singleton target is materialized into a community whose key no candidate was evaluated against.
+                touched.insert( CommunityKey( move.m_Node ) );
+                touched.insert( CommunityKey( move.m_Target ) );
+                numApplied++;
+            }
+            stats.m_NumMoves += numApplied;
+            if( numApplied == 0 ) break;
+        }
+        stats.m_Seconds = Now() - start;
+        return stats;
+    }
+
+    bool CommunityStructure::BestMove( unsigned int nodeId, UVector& neighbors, MoveCandidate& move ) const {
+        unsigned int numNeighbors = m_Graph->Neighbors( nodeId, neighbors, StreamGraph::BOTH );
+        if( numNeighbors == 0 ) return false;
+        unsigned long long own = CommunityKey( nodeId );
+        double current = Score( nodeId );
+        double removed = TestRemove( nodeId );
+        unsigned long long candidates[FLOWING_REFINE_MAX_CANDIDATES];
+        int numCandidates = 0;
+        move.m_Gain = 0.0;
+        for( unsigned int i = 0; i < numNeighbors && numCandidates < FLOWING_REFINE_MAX_CANDIDATES; ++i ) {
+            unsigned int target = neighbors[i];
+            unsigned long long key = CommunityKey( target );
+            if( key == own ) continue;
+            bool seen = false;
+            for( int j = 0; j < numCandidates && !seen; ++j ) seen = candidates[j] == key;
+            if( seen ) continue;
+            candidates[numCandidates++] = key;
+            double gain = (removed + TestInsert( target, nodeId )) - (current + Score( target ));
+            if( gain > move.m_Gain ) {
+                move.m_Node = nodeId;
+                move.m_Target = target;
+                move.m_Gain = gain;
+            }
+        }
+        return move.m_Gain > 0.0;
+    }
+
+    void CommunityStructure::EvaluateMoves( unsigned int first, unsigned int step, double deadline, std::vector<MoveCandidate>* moves ) const {
+        UVector neighbors;
+        moves->clear();
+        unsigned int numNodes = m_Graph->NumNodes();
+        unsigned int numEvaluated = 0;
+        for( unsigned int node = first; node < numNodes; node += step ) {
+            if( (++numEvaluated % FLOWING_REFINE_CHECK_INTERVAL == 0) && Now() >= deadline ) break;
+            MoveCandidate move;
+            if( BestMove( node, neighbors, move ) ) moves->push_back( move );
+        }
+    }
+
+    unsigned long long CommunityStructure::CommunityKey( unsigned int nodeId ) const {
+        return Community::Label( GetCommunity( nodeId ), nodeId );
+    }
+
+    unsigned int CommunityStructure::CommunityId( unsigned int nodeId ) const {
+        Community* community = GetCommunity( nodeId );
+        return community != NULL ? community->Id() : nodeId;
+    }
+
+    double CommunityStructure::Now() {
+        return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    Community* CommunityStructure::Materialize( unsigned int nodeId ) {
+        Community* community = GetCommunity( nodeId );
+        if( community == NULL ) {
+            community = m_Pool.Allocate( nodeId, 0, m_SingletonKout[nodeId] );
+            m_NumMembers++;
+            m_Graph->SetNodeData( nodeId, community );
+            m_Graph->Relabel( nodeId, Community::Label( NULL, nodeId ), Community::Label( community, nodeId ) );
+        }
+        return community;
+    }
+
+    void CommunityStructure::Release( Community* community ) {
+        if( community->Size() <= 1 ) Reconcile( community );
+        if( community->Size() == 0 ) {
+            m_Pool.Free( community );
+        } else if( community->Size() == 1 && community->Kin() == 0 ) {
+            Community::CommunityIterator iterCom = community->Iterator();
+            unsigned int node = iterCom.Next();
+            m_SingletonKout[node] = community->Kout();
+            m_Graph->SetNodeData( node, NULL );
+            m_Graph->Relabel( node, Community::Label( community, node ), Community::Label( NULL, node ) );
+            RekeySketch( node, community->Id(), node );
+            m_NumMembers--;
+            m_Pool.Free( community );
+        }
+    }
+
+    void CommunityStructure::RekeySketch( unsigned int nodeId, unsigned int oldId, unsigned int newId ) {
+        if( !m_Sketch.Counting() || oldId == newId ) return;
+        UVector* weights = m_Graph->Weighted() ? &m_RekeyWeights : NULL;
+        unsigned int numNeighbors = m_Graph->Neighbors( nodeId, m_RekeyNeighbors, StreamGraph::BOTH, weights );
+        for( unsigned int i = 0; i < numNeighbors; ++i ) {
+            unsigned int neighbor = m_RekeyNeighbors[i];
+            // Self loops are not counted.
+            if( neighbor == nodeId ) continue;
+            unsigned int weight = weights != NULL ? m_RekeyWeights[i] : 1;
+            m_Sketch.Uncount( neighbor, oldId, weight );
+            m_Sketch.Count( neighbor, newId, weight );
+        }
+    }
+
+    void CommunityStructure::SignalExternalEdge( unsigned int nodeId, Community* community, int delta ) {
+        if( community == NULL ) {
+            m_SingletonKout[nodeId] += delta;
+            assert( m_SingletonKout[nodeId] >= 0 );
+        } else if( delta > 0 ) {
+            community->SignalInsertExternalEdge( delta );
+        } else {
+            community->SignalRemoveExternalEdge( -delta );
+        }
+    }
+
+    void CommunityStructure::CountTriangles( unsigned int tail, unsigned int head, unsigned int weight ) {
+        double start = Now();
+        // A triangle survives the sampling only if its three edges are kept.
+        unsigned long long triangleWeight = (unsigned long long)weight*weight*weight;
+        const unsigned int* common;
+        unsigned int numTriangles = m_Triangles.Count( tail, head, triangleWeight, common );
+        Community* tailCommunity = GetCommunity( tail );
+        Community* headCommunity = GetCommunity( head );
+        for( unsigned int i = 0; i < numTriangles; ++i ) {
+            Community* community = GetCommunity( common[i] );
+            bool internal = tailCommunity != NULL && tailCommunity == headCommunity && tailCommunity == community;
+            if( tailCommunity != NULL ) tailCommunity->SignalTriangle( triangleWeight, internal );
+            if( headCommunity != NULL ) headCommunity->SignalTriangle( triangleWeight, false );
+            if( community != NULL ) community->SignalTriangle( triangleWeight, false );
+        }
+        m_Triangles.AddSeconds( Now() - start );
+    }
+
+    bool CommunityStructure::Reclaim( unsigned int nodeId ) {
+        Community* community = GetCommunity( nodeId );
+        if( community == NULL ) {
+            if( !m_Written[nodeId] ) Retire( nodeId, m_NumLabels++ );
+            m_Written[nodeId] = true;
+            return true;
+        }
+        Reconcile( community );
+        Community::CommunityIterator iterCom = community->Iterator();
+        while( iterCom.HasNext() ) {
+            if( !m_Graph->IsEmpty( iterCom.Next() ) ) return false;
+        }
+        // Without edges the community cannot change anymore, so its label is final and all its members let go.
+        unsigned int label = m_NumLabels++;
+        m_NumMembers -= community->Size();
+        Community::CommunityIterator members = community->Iterator();
+        while( members.HasNext() ) {
+            unsigned int member = members.Next();
+            Retire( member, label );
+            m_Graph->SetNodeData( member, NULL );
+            m_SingletonKout[member] = 0;
+            m_Written[member] = true;
+            if( member != nodeId ) m_Graph->AddReclaimCandidate( member );
+        }
+        m_Pool.Free( community );
+        return true;
+    }
+
+    void CommunityStructure::Write( unsigned int nodeId ) {
+        if( m_Writer == NULL || m_Written[nodeId] ) return;
+        Community* community = GetCommunity( nodeId );
+        if( community == NULL ) {
+            m_Writer->BeginCommunity();
+            m_Writer->Add( m_Graph->Remap( nodeId ) );
+            m_Writer->EndCommunity();
+            return;
+        }
+        // The members are sorted, so the community is written exactly once, when its smallest member is freed.
+        Reconcile( community );
+        if( community->Iterator().Next() != nodeId ) return;
+        WriteMembers( community );
+    }
+
+    void CommunityStructure::WriteMembers( const Community* community ) {
+        if( m_Writer == NULL ) return;
+        Community::CommunityIterator iterCom = community->Iterator();
+        m_Writer->BeginCommunity();
+        while( iterCom.HasNext() ) {
+            m_Writer->Add( m_Graph->Remap( iterCom.Next() ) );
+        }
+        m_Writer->EndCommunity();
+    }
+
+    void CommunityStructure::Retire( unsigned int nodeId, unsigned int label ) {
+        if( m_Writer == NULL ) return;
+        LabeledNode node;
+        node.m_Node = m_Graph->Remap( nodeId );
+        node.m_Label = label;
+        m_Reclaimed.push_back( node );
+        // Nodes that keep coming back pile up records, so the stale ones are dropped once they may be half.
+        if( m_Reclaimed.size() >= 2*std::max( m_NumCompacted, (size_t)FLOWING_RECLAIM_COMPACT_MIN ) ) CompactReclaimed();
+    }
+
+    void CommunityStructure::CompactReclaimed() {
+        std::stable_sort( m_Reclaimed.begin(), m_Reclaimed.end(),
+                          []( const LabeledNode& a, const LabeledNode& b ) { return a.m_Node < b.m_Node; } );
+        size_t numKept = 0;
+        for( size_t i = 0; i < m_Reclaimed.size(); ++i ) {
+            if( i + 1 < m_Reclaimed.size() && m_Reclaimed[i + 1].m_Node == m_Reclaimed[i].m_Node ) continue;
+            m_Reclaimed[numKept++] = m_Reclaimed[i];
+        }
+        m_Reclaimed.resize( numKept );
+        m_NumCompacted = numKept;
+    }
+
+    void CommunityStructure::Flush() {
+        if( m_Writer == NULL || m_Reclaimed.empty() ) return;
+        CompactReclaimed();
+        std::vector<LiveNode> nodes;
+        nodes.swap( m_Live );
+        for( size_t i = 0; i < nodes.size(); ++i ) {
+            LabeledNode key;
+            key.m_Node = nodes[i].m_Node;
+            std::vector<LabeledNode>::iterator it = std::lower_bound( m_Reclaimed.begin(), m_Reclaimed.end(), key,
+                                                   []( const LabeledNode& a, const LabeledNode& b ) { return a.m_Node < b.m_Node; } );
+            if( it == m_Reclaimed.end() || it->m_Node != key.m_Node ) continue;
+            nodes[i].m_Label = it->m_Label;
+            it->m_Label = ~0U;
+        }
+        // A live community mostly made of nodes that came back from one reclaimed community rejoins it.
+        // Reclaimed labels stay below 2^32 and live communities above, so both sort into one sequence.
+        std::sort( nodes.begin(), nodes.end(), []( const LiveNode& a, const LiveNode& b ) {
+            return a.m_Key != b.m_Key ? a.m_Key < b.m_Key : a.m_Label < b.m_Label;
+        } );
+        for( size_t begin = 0, end = 0; begin < nodes.size(); begin = end ) {
+            unsigned int label = ~0U;
+            size_t best = 0;
+            for( size_t run = begin; run < nodes.size() && nodes[run].m_Key == nodes[begin].m_Key; run = end ) {
+                for( end = run; end < nodes.size() && nodes[end].m_Key == nodes[begin].m_Key && nodes[end].m_Label == nodes[run].m_Label; ++end );
+                if( nodes[run].m_Label != ~0U && end - run > best ) {
+                    best = end - run;
+                    label = nodes[run].m_Label;
+                }
+            }
+            if( 2*best <= end - begin ) continue;
+            for( size_t i = begin; i < end; ++i ) nodes[i].m_Key = label;
+        }
+        for( size_t i = 0; i < m_Reclaimed.size(); ++i ) {
+            if( m_Reclaimed[i].m_Label == ~0U ) continue;
+            LiveNode node;
+            node.m_Node = m_Reclaimed[i].m_Node;
+            node.m_Key = m_Reclaimed[i].m_Label;
+            node.m_Label = m_Reclaimed[i].m_Label;
+            nodes.push_back( node );
+        }
+        std::vector<LabeledNode>().swap( m_Reclaimed );
+        m_NumCompacted = 0;
+        std::sort( nodes.begin(), nodes.end(), []( const LiveNode& a, const LiveNode& b ) {
+            return a.m_Key != b.m_Key ? a.m_Key < b.m_Key : a.m_Node < b.m_Node;
+        } );
+        for( size_t i = 0; i < nodes.size(); ++i ) {
+            if( i == 0 || nodes[i].m_Key != nodes[i - 1].m_Key ) m_Writer->BeginCommunity();
+            m_Writer->Add( nodes[i].m_Node );
+            if( i + 1 == nodes.size() || nodes[i + 1].m_Key != nodes[i].m_Key ) m_Writer->EndCommunity();
+        }
+    }
+}
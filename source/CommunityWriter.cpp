@@ -0,0 +1,211 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CommunityWriter.h"
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace flowing {
+
+    /** @brief The decimal representation of all the numbers from 00 to 99.*/
+    static const char s_Digits[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    /** @brief Writes the decimal representation of a number.
+      @param[in] value The number to write.
+      @param[out] out Where the digits are written. Must have room for 10 characters.
+      @return The number of characters written.*/
+    static inline int FormatUnsigned( unsigned int value, char* out ) {
+        char digits[10];
+        int position = 10;
+        while( value >= 100 ) {
+            unsigned int pair = (value % 100)*2;
+            value /= 100;
+            digits[--position] = s_Digits[pair + 1];
+            digits[--position] = s_Digits[pair];
+        }
+        if( value >= 10 ) {
+            digits[--position] = s_Digits[value*2 + 1];
+            digits[--position] = s_Digits[value*2];
+        } else {
+            digits[--position] = '0' + value;
+        }
+        int length = 10 - position;
+        memcpy( out, &digits[position], length );
+        return length;
+    }
+
+    CommunityWriter::CommunityWriter( const int bufferSize ) :
+        m_File( -1 ),
+        m_Format( TEXT ),
+        m_BufferSize( bufferSize > 64 ? bufferSize : 64 ),
+        m_NumCommunities( 0 ),
+        m_NumMembers( 0 ),
+        m_Failed( false ),
+        m_Background( false ),
+        m_Done( false ) {
+        m_Current.m_Data = NULL;
+        m_Current.m_Size = 0;
+    }
+
+    CommunityWriter::~CommunityWriter() {
+        Close();
+    }
+
+    bool CommunityWriter::Open( const char* path, const Format format, const bool background ) {
+        if( m_File >= 0 ) return false;
+        m_File = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if( m_File < 0 ) return false;
+        m_Format = format;
+        m_Background = background;
+        m_Done = false;
+        m_Failed = false;
+        m_NumCommunities = 0;
+        int numBuffers = m_Background ? FLOWING_WRITER_NUM_BUFFERS : 1;
+        for( int i = 0; i < numBuffers; ++i ) {
+            Buffer buffer;
+            buffer.m_Data = new char[m_BufferSize];
+            buffer.m_Size = 0;
+            m_Allocated.push_back( buffer.m_Data );
+            m_Free.push_back( buffer );
+        }
+        m_Current = m_Free.back();
+        m_Free.pop_back();
+        if( m_Format == BINARY ) {
+            unsigned int header[2] = { FLOWING_BINARY_MAGIC, FLOWING_BINARY_VERSION };
+            memcpy( m_Current.m_Data, header, sizeof(header) );
+            m_Current.m_Size = sizeof(header);
+        }
+        if( m_Background ) {
+            m_Thread = std::thread( &CommunityWriter::Run, this );
+        }
+        return true;
+    }
+
+    bool CommunityWriter::Close() {
+        if( m_File < 0 ) return !m_Failed;
+        if( m_Background ) {
+            {
+                std::unique_lock<std::mutex> lock( m_Mutex );
+                if( m_Current.m_Size > 0 ) m_Full.push_back( m_Current );
+                m_Done = true;
+            }
+            m_Condition.notify_all();
+            m_Thread.join();
+        } else if( m_Current.m_Size > 0 ) {
+            WriteBuffer( m_Current.m_Data, m_Current.m_Size );
+        }
+        m_Current.m_Data = NULL;
+        m_Current.m_Size = 0;
+        m_Full.clear();
+        m_Free.clear();
+        for( unsigned int i = 0; i < m_Allocated.size(); ++i ) {
+            delete [] m_Allocated[i];
+        }
+        m_Allocated.clear();
+        if( close( m_File ) != 0 ) m_Failed = true;
+        m_File = -1;
+        return !m_Failed;
+    }
+
+    void CommunityWriter::BeginCommunity() {
+        m_NumMembers = 0;
+    }
+
+    void CommunityWriter::Add( const unsigned int node ) {
+        if( m_Format == TEXT ) {
+            Reserve( 11 );
+            char* out = &m_Current.m_Data[m_Current.m_Size];
+            if( m_NumMembers > 0 ) *out++ = ' ';
+            out += FormatUnsigned( node, out );
+            m_Current.m_Size = out - m_Current.m_Data;
+        } else {
+            Reserve( 2*sizeof(unsigned int) );
+            unsigned int pair[2] = { node, m_NumCommunities };
+            memcpy( &m_Current.m_Data[m_Current.m_Size], pair, sizeof(pair) );
+            m_Current.m_Size += sizeof(pair);
+        }
+        m_NumMembers++;
+    }
+
+    void CommunityWriter::EndCommunity() {
+        if( m_Format == TEXT ) {
+            Reserve( 1 );
+            m_Current.m_Data[m_Current.m_Size++] = '\n';
+        }
+        m_NumCommunities++;
+    }
+
+    unsigned int CommunityWriter::NumCommunities() const {
+        return m_NumCommunities;
+    }
+
+    void CommunityWriter::Reserve( const int size ) {
+        if( m_Current.m_Size + size > m_BufferSize ) Flush();
+    }
+
+    void CommunityWriter::Flush() {
+        if( !m_Background ) {
+            WriteBuffer( m_Current.m_Data, m_Current.m_Size );
+            m_Current.m_Size = 0;
+            return;
+        }
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        m_Full.push_back( m_Current );
+        m_Condition.notify_all();
+        while( m_Free.empty() ) m_Condition.wait( lock );
+        m_Current = m_Free.back();
+        m_Free.pop_back();
+        m_Current.m_Size = 0;
+    }
+
+    void CommunityWriter::WriteBuffer( const char* buffer, const int size ) {
+        int written = 0;
+        while( written < size && !m_Failed ) {
+            ssize_t result = write( m_File, buffer + written, size - written );
+            if( result < 0 ) {
+                if( errno == EINTR ) continue;
+                m_Failed = true;
+            } else {
+                written += result;
+            }
+        }
+    }
+
+    void CommunityWriter::Run() {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        while( true ) {
+            while( m_Full.empty() && !m_Done ) m_Condition.wait( lock );
+            if( m_Full.empty() ) break;
+            Buffer buffer = m_Full.front();
+            m_Full.pop_front();
+            lock.unlock();
+            WriteBuffer( buffer.m_Data, buffer.m_Size );
+            lock.lock();
+            m_Free.push_back( buffer );
+            m_Condition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,119 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DegreeSketch.h"
+
+namespace flowing {
+
+    DegreeSketch::DegreeSketch( const StreamGraph* graph ) :
+        m_Graph( graph ),
+        m_Enabled( false ),
+        m_Width( 0 ),
+        m_WidthBits( 0 ),
+        m_Depth( 0 ) {
+    }
+
+    DegreeSketch::~DegreeSketch() {
+    }
+
+    void DegreeSketch::Configure( const bool enabled, const unsigned int width, const unsigned int depth ) {
+        m_Enabled = enabled;
+        m_Width = 0;
+        m_WidthBits = 0;
+        m_Depth = 0;
+        m_Counters.clear();
+        m_Seeds.clear();
+        if( !enabled || width == 0 || depth == 0 ) return;
+        m_Width = 1;
+        while( m_Width < width ) {
+            m_Width <<= 1;
+            m_WidthBits++;
+        }
+        m_Depth = depth;
+        m_Counters.assign( (size_t)m_Width*m_Depth, 0 );
+        unsigned long long seed = 0x9e3779b97f4a7c15ULL;
+        for( unsigned int i = 0; i < m_Depth; ++i ) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            m_Seeds.push_back( seed | 1 );
+        }
+    }
+
+    bool DegreeSketch::Enabled() const {
+        return m_Enabled;
+    }
+
+    void DegreeSketch::Count( const unsigned int node, const unsigned int community, const unsigned int weight ) {
+        if( m_Depth == 0 ) return;
+        unsigned long long key = ((unsigned long long)node << 32) | community;
+        for( unsigned int i = 0; i < m_Depth; ++i ) {
+            unsigned int& counter = m_Counters[(size_t)i*m_Width + Index( i, key )];
+            counter = counter <= ~0U - weight ? counter + weight : ~0U;
+        }
+    }
+
+    void DegreeSketch::Uncount( const unsigned int node, const unsigned int community, const unsigned int weight ) {
+        if( m_Depth == 0 ) return;
+        unsigned long long key = ((unsigned long long)node << 32) | community;
+        for( unsigned int i = 0; i < m_Depth; ++i ) {
+            unsigned int& counter = m_Counters[(size_t)i*m_Width + Index( i, key )];
+            // A saturated counter no longer knows what it holds, so it stays saturated.
+            if( counter != ~0U ) counter = counter >= weight ? counter - weight : 0;
+        }
+    }
+
+    bool DegreeSketch::Counting() const {
+        return m_Depth > 0;
+    }
+
+    unsigned int DegreeSketch::Estimate( const unsigned int node, const unsigned int community ) const {
+        if( m_Depth == 0 ) return 0;
+        unsigned long long key = ((unsigned long long)node << 32) | community;
+        unsigned int estimate = ~0U;
+        for( unsigned int i = 0; i < m_Depth; ++i ) {
+            unsigned int counter = m_Counters[(size_t)i*m_Width + Index( i, key )];
+            if( counter < estimate ) estimate = counter;
+        }
+        return estimate;
+    }
+
+    void DegreeSketch::Combine( const unsigned int node, const unsigned int community, const int retainedKin, const int retainedDegree, int& nodeKin, int& nodeKout ) const {
+        int degree = m_Graph->Degree( node );
+        if( degree < retainedDegree ) degree = retainedDegree;
+        // The retained adjacencies are exact but partial, the sketch covers the whole history but may
+        // overestimate, so the estimate is bounded from below by the former and from above by the degree.
+        int kin;
+        if( m_Depth > 0 ) {
+            kin = Estimate( node, community );
+        } else {
+            // Without the sketch, the evicted edges are assumed to go where the retained ones do.
+            kin = retainedDegree > 0 ? (int)((long long)retainedKin*degree/retainedDegree) : 0;
+        }
+        if( kin < retainedKin ) kin = retainedKin;
+        if( kin > degree ) kin = degree;
+        int kout = degree - kin;
+        if( kout < retainedDegree - retainedKin ) kout = retainedDegree - retainedKin;
+        nodeKin = kin;
+        nodeKout = kout;
+    }
+
+    size_t DegreeSketch::Bytes() const {
+        return m_Counters.size()*sizeof(unsigned int);
+    }
+
+    size_t DegreeSketch::Index( const unsigned int row, const unsigned long long key ) const {
+        // Multiply-shift hashing, the top bits of the product are the best mixed.
+        unsigned long long hash = (key ^ (key >> 29))*m_Seeds[row];
+        return m_WidthBits > 0 ? (size_t)(hash >> (64 - m_WidthBits)) : 0;
+    }
+}
@@ -0,0 +1,522 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EdgeReader.h"
+#include <climits>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef FLOWING_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef FLOWING_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace flowing {
+
+    EdgeReader::EdgeReader( const int blockSize, const int numBlocks ) :
+        m_File( -1 ),
+        m_OwnsFile( false ),
+        m_Format( TEXT ),
+        m_Compression( NONE ),
+        m_BlockSize( blockSize > (int)sizeof(Edge) ? blockSize : (int)sizeof(Edge) ),
+        m_NumBlocks( numBlocks > 1 ? numBlocks : 2 ),
+        m_NumFull( 0 ),
+        m_ReadBlock( 0 ),
+        m_WriteBlock( 0 ),
+        m_End( false ),
+        m_Stop( false ),
+        m_Failed( false ),
+        m_MagicSize( 0 ),
+        m_MagicPosition( 0 ),
+        m_Input( NULL ),
+        m_InputSize( 0 ),
+        m_InputPosition( 0 ),
+        m_InputEnd( false ),
+        m_InFrame( false ),
+        m_Stream( NULL ),
+        m_Truncated( false ) {
+    }
+
+    EdgeReader::~EdgeReader() {
+        Close();
+    }
+
+    bool EdgeReader::Supports( const Compression compression ) {
+        switch( compression ) {
+            case GZIP:
+#ifdef FLOWING_HAVE_ZLIB
+                return true;
+#else
+                return false;
+#endif
+            case ZSTD:
+#ifdef FLOWING_HAVE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+            default:
+                return true;
+        }
+    }
+
+    int EdgeReader::ParseLine( const char* line, Edge& edge ) {
+        if( line[0] == '#' || line[0] == '%' ) return 0;
+        unsigned int numbers[2];
+        int numNumbers = 0;
+        const char* c = line;
+        while( *c != '\0' ) {
+            if( *c == ' ' || *c == '\t' || *c == '\r' ) {
+                ++c;
+                continue;
+            }
+            if( *c < '0' || *c > '9' || numNumbers == 2 ) return -1;
+            unsigned int number = 0;
+            for( ; *c >= '0' && *c <= '9'; ++c ) {
+                unsigned int digit = *c - '0';
+                if( number > (UINT_MAX - digit)/10 ) return -1;
+                number = number*10 + digit;
+            }
+            numbers[numNumbers++] = number;
+        }
+        if( numNumbers == 0 ) return 0;
+        if( numNumbers == 1 ) return -1;
+        edge.m_Tail = numbers[0];
+        edge.m_Head = numbers[1];
+        return 1;
+    }
+
+    bool EdgeReader::Open( const char* path, const Format format, const Compression compression ) {
+        if( m_File >= 0 ) return false;
+        m_OwnsFile = strcmp( path, "-" ) != 0;
+        m_File = m_OwnsFile ? open( path, O_RDONLY ) : 0;
+        if( m_File < 0 ) return false;
+        posix_fadvise( m_File, 0, 0, POSIX_FADV_SEQUENTIAL );
+        m_Format = format;
+        m_Compression = compression;
+        m_MagicSize = 0;
+        m_MagicPosition = 0;
+        if( m_Compression == AUTO ) {
+            // The bytes read here are served again by ReadRaw, so this also works on pipes.
+            while( m_MagicSize < (int)sizeof(m_Magic) ) {
+                ssize_t result = read( m_File, &m_Magic[m_MagicSize], sizeof(m_Magic) - m_MagicSize );
+                if( result < 0 && errno == EINTR ) continue;
+                if( result <= 0 ) break;
+                m_MagicSize += result;
+            }
+            const unsigned char* magic = (const unsigned char*)m_Magic;
+            m_Compression = NONE;
+            if( m_MagicSize >= 2 && magic[0] == 0x1f && magic[1] == 0x8b ) m_Compression = GZIP;
+            if( m_MagicSize >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd ) m_Compression = ZSTD;
+        }
+        if( !Supports( m_Compression ) ) {
+            Close();
+            return false;
+        }
+#ifdef FLOWING_HAVE_ZLIB
+        if( m_Compression == GZIP ) {
+            z_stream* stream = new z_stream;
+            memset( stream, 0, sizeof(z_stream) );
+            // 16 + MAX_WBITS makes zlib expect a gzip header and trailer.
+            if( inflateInit2( stream, 16 + MAX_WBITS ) != Z_OK ) {
+                delete stream;
+                Close();
+                return false;
+            }
+            m_Stream = stream;
+        }
+#endif
+#ifdef FLOWING_HAVE_ZSTD
+        if( m_Compression == ZSTD ) {
+            ZSTD_DStream* stream = ZSTD_createDStream();
+            if( stream == NULL || ZSTD_isError( ZSTD_initDStream( stream ) ) ) {
+                if( stream != NULL ) ZSTD_freeDStream( stream );
+                Close();
+                return false;
+            }
+            m_Stream = stream;
+        }
+#endif
+        if( m_Compression != NONE ) m_Input = new char[m_BlockSize];
+        m_InputSize = 0;
+        m_InputPosition = 0;
+        m_InputEnd = false;
+        m_InFrame = false;
+        for( int i = 0; i < m_NumBlocks; ++i ) {
+            m_Blocks.push_back( new char[m_BlockSize] );
+            m_BlockSizes.push_back( 0 );
+        }
+        m_NumFull = 0;
+        m_ReadBlock = 0;
+        m_WriteBlock = 0;
+        m_End = false;
+        m_Stop = false;
+        m_Failed = false;
+        m_HasBlock = false;
+        m_Position = 0;
+        m_Number = 0;
+        m_InNumber = false;
+        m_InComment = false;
+        m_LineStart = true;
+        m_HasTail = false;
+        m_HasEdge = false;
+        m_Tail = 0;
+        m_Line = 1;
+        m_MalformedLine = 0;
+        m_PartialSize = 0;
+        m_Truncated = false;
+        m_Thread = std::thread( &EdgeReader::Run, this );
+        return true;
+    }
+
+    void EdgeReader::Close() {
+        if( m_Thread.joinable() ) {
+            {
+                std::unique_lock<std::mutex> lock( m_Mutex );
+                m_Stop = true;
+            }
+            m_Condition.notify_all();
+            m_Thread.join();
+        }
+#ifdef FLOWING_HAVE_ZLIB
+        if( m_Compression == GZIP && m_Stream != NULL ) {
+            inflateEnd( (z_stream*)m_Stream );
+            delete (z_stream*)m_Stream;
+        }
+#endif
+#ifdef FLOWING_HAVE_ZSTD
+        if( m_Compression == ZSTD && m_Stream != NULL ) {
+            ZSTD_freeDStream( (ZSTD_DStream*)m_Stream );
+        }
+#endif
+        m_Stream = NULL;
+        delete [] m_Input;
+        m_Input = NULL;
+        for( unsigned int i = 0; i < m_Blocks.size(); ++i ) {
+            delete [] m_Blocks[i];
+        }
+        m_Blocks.clear();
+        m_BlockSizes.clear();
+        if( m_File >= 0 && m_OwnsFile ) close( m_File );
+        m_File = -1;
+    }
+
+    bool EdgeReader::Failed() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_Failed || m_MalformedLine > 0;
+    }
+
+    unsigned long long EdgeReader::MalformedLine() const {
+        return m_MalformedLine;
+    }
+
+    bool EdgeReader::Truncated() const {
+        return m_Truncated;
+    }
+
+    int EdgeReader::QueueDepth() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_NumFull;
+    }
+
+    int EdgeReader::Read( Edge* edges, const int maxEdges ) {
+        if( m_Blocks.empty() ) return 0;
+        return m_Format == TEXT ? ParseText( edges, maxEdges ) : ParseBinary( edges, maxEdges );
+    }
+
+    void EdgeReader::Run() {
+        while( true ) {
+            {
+                std::unique_lock<std::mutex> lock( m_Mutex );
+                while( m_NumFull == m_NumBlocks && !m_Stop ) m_Condition.wait( lock );
+                if( m_Stop ) break;
+            }
+            // The block at m_WriteBlock is not visible to the parser until m_NumFull is increased.
+            int size = Fill( m_Blocks[m_WriteBlock] );
+            std::unique_lock<std::mutex> lock( m_Mutex );
+            if( size <= 0 ) {
+                m_Failed = size < 0;
+                break;
+            }
+            m_BlockSizes[m_WriteBlock] = size;
+            m_WriteBlock = (m_WriteBlock + 1) % m_NumBlocks;
+            m_NumFull++;
+            m_Condition.notify_all();
+        }
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        m_End = true;
+        m_Condition.notify_all();
+    }
+
+    int EdgeReader::ReadRaw( char* buffer, const int size ) {
+        if( m_MagicPosition < m_MagicSize ) {
+            int length = m_MagicSize - m_MagicPosition < size ? m_MagicSize - m_MagicPosition : size;
+            memcpy( buffer, &m_Magic[m_MagicPosition], length );
+            m_MagicPosition += length;
+            return length;
+        }
+        while( true ) {
+            ssize_t result = read( m_File, buffer, size );
+            if( result < 0 && errno == EINTR ) continue;
+            return result;
+        }
+    }
+
+    int EdgeReader::Fill( char* block ) {
+        switch( m_Compression ) {
+            case GZIP:
+                return FillGzip( block );
+            case ZSTD:
+                return FillZstd( block );
+            default:
+                return FillNone( block );
+        }
+    }
+
+    int EdgeReader::FillNone( char* block ) {
+        int filled = 0;
+        while( filled < m_BlockSize ) {
+            int result = ReadRaw( &block[filled], m_BlockSize - filled );
+            if( result < 0 ) return -1;
+            if( result == 0 ) break;
+            filled += result;
+        }
+        return filled;
+    }
+
+    int EdgeReader::FillGzip( char* block ) {
+#ifdef FLOWING_HAVE_ZLIB
+        z_stream* stream = (z_stream*)m_Stream;
+        stream->next_out = (Bytef*)block;
+        stream->avail_out = m_BlockSize;
+        while( stream->avail_out > 0 ) {
+            if( m_InputPosition == m_InputSize ) {
+                if( m_InputEnd ) break;
+                int result = ReadRaw( m_Input, m_BlockSize );
+                if( result < 0 ) return -1;
+                if( result == 0 ) {
+                    m_InputEnd = true;
+                    break;
+                }
+                m_InputSize = result;
+                m_InputPosition = 0;
+            }
+            stream->next_in = (Bytef*)&m_Input[m_InputPosition];
+            stream->avail_in = m_InputSize - m_InputPosition;
+            int result = inflate( stream, Z_NO_FLUSH );
+            m_InputPosition = m_InputSize - stream->avail_in;
+            m_InFrame = true;
+            if( result == Z_STREAM_END ) {
+                // Concatenated gzip members are decompressed one after the other.
+                inflateReset( stream );
+                m_InFrame = false;
+            } else if( result != Z_OK && result != Z_BUF_ERROR ) {
+                return -1;
+            }
+        }
+        int produced = m_BlockSize - stream->avail_out;
+        // A member that was started but not finished means the file is truncated, which is
+        // reported once the data decompressed so far has been handed out.
+        if( produced == 0 && m_InputEnd && m_InFrame ) return -1;
+        return produced;
+#else
+        return -1;
+#endif
+    }
+
+    int EdgeReader::FillZstd( char* block ) {
+#ifdef FLOWING_HAVE_ZSTD
+        ZSTD_outBuffer output = { block, (size_t)m_BlockSize, 0 };
+        while( output.pos < output.size ) {
+            if( m_InputPosition == m_InputSize ) {
+                if( m_InputEnd ) break;
+                int result = ReadRaw( m_Input, m_BlockSize );
+                if( result < 0 ) return -1;
+                if( result == 0 ) {
+                    m_InputEnd = true;
+                    break;
+                }
+                m_InputSize = result;
+                m_InputPosition = 0;
+            }
+            ZSTD_inBuffer input = { m_Input, (size_t)m_InputSize, (size_t)m_InputPosition };
+            size_t result = ZSTD_decompressStream( (ZSTD_DStream*)m_Stream, &output, &input );
+            if( ZSTD_isError( result ) ) return -1;
+            m_InputPosition = input.pos;
+            m_InFrame = result != 0;
+        }
+        // A frame that was started but not finished means the file is truncated, which is
+        // reported once the data decompressed so far has been handed out.
+        if( output.pos == 0 && m_InputEnd && m_InFrame ) return -1;
+        return output.pos;
+#else
+        return -1;
+#endif
+    }
+
+    bool EdgeReader::AcquireBlock() {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        while( m_NumFull == 0 && !m_End ) m_Condition.wait( lock );
+        if( m_NumFull == 0 ) return false;
+        m_HasBlock = true;
+        m_Position = 0;
+        return true;
+    }
+
+    void EdgeReader::ReleaseBlock() {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        m_HasBlock = false;
+        m_ReadBlock = (m_ReadBlock + 1) % m_NumBlocks;
+        m_NumFull--;
+        m_Condition.notify_all();
+    }
+
+    int EdgeReader::EndNumber( Edge* edges ) {
+        unsigned int number = m_Number;
+        m_Number = 0;
+        m_InNumber = false;
+        if( m_HasEdge ) {
+            SetMalformed();
+            return 0;
+        }
+        if( !m_HasTail ) {
+            m_Tail = number;
+            m_HasTail = true;
+            return 0;
+        }
+        edges->m_Tail = m_Tail;
+        edges->m_Head = number;
+        m_HasTail = false;
+        m_HasEdge = true;
+        return 1;
+    }
+
+    void EdgeReader::SetMalformed() {
+        m_MalformedLine = m_Line;
+        m_InNumber = false;
+        m_HasTail = false;
+    }
+
+    int EdgeReader::ParseText( Edge* edges, const int maxEdges ) {
+        if( m_MalformedLine > 0 ) return 0;
+        int count = 0;
+        while( count < maxEdges ) {
+            if( !m_HasBlock && !AcquireBlock() ) {
+                // A number at the very end of the file is not followed by any delimiter.
+                if( m_InNumber ) count += EndNumber( &edges[count] );
+                if( m_HasTail ) SetMalformed();
+                return count;
+            }
+            const char* data = m_Blocks[m_ReadBlock];
+            const int size = m_BlockSizes[m_ReadBlock];
+            int position = m_Position;
+            while( position < size && count < maxEdges ) {
+                char c = data[position++];
+                if( m_InComment ) {
+                    if( c == '\n' ) {
+                        m_InComment = false;
+                        m_LineStart = true;
+                        m_Line++;
+                    }
+                    continue;
+                }
+                if( c >= '0' && c <= '9' ) {
+                    unsigned int digit = c - '0';
+                    if( m_Number > (UINT_MAX - digit)/10 ) {
+                        SetMalformed();
+                        break;
+                    }
+                    m_Number = m_Number*10 + digit;
+                    m_InNumber = true;
+                    m_LineStart = false;
+                    continue;
+                }
+                if( m_LineStart && (c == '#' || c == '%') ) {
+                    m_InComment = true;
+                    continue;
+                }
+                if( c != ' ' && c != '\t' && c != '\n' && c != '\r' ) {
+                    // Signs, letters and any other delimiter would silently turn into different nodes.
+                    SetMalformed();
+                    break;
+                }
+                if( m_InNumber ) count += EndNumber( &edges[count] );
+                if( m_MalformedLine > 0 ) break;
+                m_LineStart = c == '\n';
+                if( m_LineStart ) {
+                    // Each edge is on its own line, so a line ending with a single number is malformed.
+                    if( m_HasTail ) {
+                        SetMalformed();
+                        break;
+                    }
+                    m_HasEdge = false;
+                    m_Line++;
+                }
+            }
+            if( m_MalformedLine > 0 ) return count;
+            m_Position = position;
+            if( position == size ) ReleaseBlock();
+        }
+        return count;
+    }
+
+    int EdgeReader::ParseBinary( Edge* edges, const int maxEdges ) {
+        int count = 0;
+        while( count < maxEdges ) {
+            if( !m_HasBlock && !AcquireBlock() ) {
+                if( m_PartialSize > 0 ) {
+                    // The file ended in the middle of an edge.
+                    std::unique_lock<std::mutex> lock( m_Mutex );
+                    m_Failed = true;
+                    m_Truncated = true;
+                    m_PartialSize = 0;
+                }
+                return count;
+            }
+            const char* data = m_Blocks[m_ReadBlock];
+            const int size = m_BlockSizes[m_ReadBlock];
+            int position = m_Position;
+            if( m_PartialSize > 0 ) {
+                // Complete an edge split between the previous block and this one.
+                int length = (int)sizeof(Edge) - m_PartialSize;
+                if( length > size - position ) length = size - position;
+                memcpy( &m_Partial[m_PartialSize], &data[position], length );
+                m_PartialSize += length;
+                position += length;
+                if( m_PartialSize == (int)sizeof(Edge) ) {
+                    memcpy( &edges[count++], m_Partial, sizeof(Edge) );
+                    m_PartialSize = 0;
+                }
+            }
+            int numEdges = (size - position) / sizeof(Edge);
+            if( numEdges > maxEdges - count ) numEdges = maxEdges - count;
+            memcpy( &edges[count], &data[position], numEdges*sizeof(Edge) );
+            count += numEdges;
+            position += numEdges*sizeof(Edge);
+            if( m_PartialSize == 0 && size - position < (int)sizeof(Edge) ) {
+                memcpy( m_Partial, &data[position], size - position );
+                m_PartialSize = size - position;
+                position = size;
+            }
+            m_Position = position;
+            if( position == size ) ReleaseBlock();
+        }
+        return count;
+    }
+}
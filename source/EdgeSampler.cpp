@@ -0,0 +1,116 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EdgeSampler.h"
+#include <cmath>
+
+namespace flowing {
+
+    EdgeSampler::EdgeSampler() :
+        m_Throughput( 0.0 ),
+        m_QueueDepth( 0 ),
+        m_ObservedDepth( 0 ),
+        m_Weight( 1 ),
+        m_MaxWeight( 1 ),
+        m_NumOffered( 0 ),
+        m_NumKept( 0 ),
+        m_NumSheddingWindows( 0 ),
+        m_State( 0x9e3779b97f4a7c15ULL ),
+        m_WindowStart( std::chrono::steady_clock::now() ) {
+    }
+
+    EdgeSampler::~EdgeSampler() {
+    }
+
+    void EdgeSampler::Configure( const double throughput, const int queueDepth ) {
+        m_Throughput = throughput > 0.0 ? throughput : 0.0;
+        m_QueueDepth = queueDepth > 0 ? queueDepth : 0;
+        m_WindowStart = std::chrono::steady_clock::now();
+    }
+
+    bool EdgeSampler::Enabled() const {
+        return m_Throughput > 0.0 || m_QueueDepth > 0;
+    }
+
+    bool EdgeSampler::Sample() {
+        if( m_NumOffered > 0 && m_NumOffered % FLOWING_SAMPLER_WINDOW == 0 ) Adapt();
+        m_NumOffered++;
+        if( m_Weight > 1 ) {
+            // xorshift64, only the decision has to be cheap and unbiased enough.
+            m_State ^= m_State << 13;
+            m_State ^= m_State >> 7;
+            m_State ^= m_State << 17;
+            if( m_State % m_Weight != 0 ) return false;
+        }
+        m_NumKept++;
+        return true;
+    }
+
+    void EdgeSampler::ObserveQueueDepth( const int queueDepth ) {
+        m_ObservedDepth = queueDepth;
+    }
+
+    void EdgeSampler::Adapt() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>( now - m_WindowStart ).count();
+        m_WindowStart = now;
+        if( m_Weight > 1 ) m_NumSheddingWindows++;
+        unsigned int weight = m_Weight;
+        bool relax = true;
+        if( m_Throughput > 0.0 ) {
+            double rate = seconds > 0.0 ? FLOWING_SAMPLER_WINDOW / seconds : m_Throughput*FLOWING_SAMPLER_HYSTERESIS;
+            if( rate < m_Throughput ) {
+                // Most of the cost is in the kept edges, so the weight scales with the missing throughput,
+                // but at most doubles per window so a single slow window does not shed everything.
+                double scaled = std::ceil( m_Weight*m_Throughput/rate );
+                unsigned int target = scaled < 2.0*m_Weight ? (unsigned int)scaled : 2*m_Weight;
+                if( target > weight ) weight = target;
+            }
+            if( rate < m_Throughput*FLOWING_SAMPLER_HYSTERESIS ) relax = false;
+        }
+        if( m_QueueDepth > 0 ) {
+            if( m_ObservedDepth > m_QueueDepth && 2*m_Weight > weight ) weight = 2*m_Weight;
+            if( m_ObservedDepth >= m_QueueDepth ) relax = false;
+        }
+        if( weight == m_Weight && relax ) weight = m_Weight/2;
+        if( weight < 1 ) weight = 1;
+        if( weight > FLOWING_SAMPLER_MAX_WEIGHT ) weight = FLOWING_SAMPLER_MAX_WEIGHT;
+        m_Weight = weight;
+        if( m_Weight > m_MaxWeight ) m_MaxWeight = m_Weight;
+    }
+
+    unsigned int EdgeSampler::Weight() const {
+        return m_Weight;
+    }
+
+    unsigned long long EdgeSampler::NumOffered() const {
+        return m_NumOffered;
+    }
+
+    unsigned long long EdgeSampler::NumKept() const {
+        return m_NumKept;
+    }
+
+    unsigned long long EdgeSampler::NumShed() const {
+        return m_NumOffered - m_NumKept;
+    }
+
+    unsigned long long EdgeSampler::NumSheddingWindows() const {
+        return m_NumSheddingWindows;
+    }
+
+    unsigned int EdgeSampler::MaxWeight() const {
+        return m_MaxWeight;
+    }
+}
@@ -0,0 +1,279 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EdgeServer.h"
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace flowing {
+
+    EdgeServer::EdgeServer( const int blockSize, const int numBlocks ) :
+        m_Listener( -1 ),
+        m_Epoll( -1 ),
+        m_Wake( -1 ),
+        m_NumProducers( 1 ),
+        m_NumAccepted( 0 ),
+        m_BlockSize( blockSize > (int)sizeof(Edge) ? blockSize / (int)sizeof(Edge) : 1 ),
+        m_NumBlocks( numBlocks > 1 ? numBlocks : 2 ),
+        m_NumFull( 0 ),
+        m_ReadBlock( 0 ),
+        m_WriteBlock( 0 ),
+        m_HasBlock( false ),
+        m_End( false ),
+        m_Stop( false ),
+        m_Failed( false ),
+        m_NumEdges( 0 ),
+        m_NumStalls( 0 ),
+        m_NumDroppedBytes( 0 ) {
+    }
+
+    EdgeServer::~EdgeServer() {
+        Close();
+    }
+
+    bool EdgeServer::Open( const char* path, const int numProducers ) {
+        if( m_Listener >= 0 ) return false;
+        struct sockaddr_un address;
+        memset( &address, 0, sizeof(address) );
+        address.sun_family = AF_UNIX;
+        if( strlen( path ) >= sizeof(address.sun_path) ) return false;
+        strcpy( address.sun_path, path );
+        // Only a socket is replaced, so a wrong path cannot remove a regular file.
+        struct stat status;
+        if( stat( path, &status ) == 0 && S_ISSOCK( status.st_mode ) ) unlink( path );
+        m_Listener = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        if( m_Listener < 0 ) return false;
+        m_Path = path;
+        if( bind( m_Listener, (struct sockaddr*)&address, sizeof(address) ) != 0 || listen( m_Listener, SOMAXCONN ) != 0 ) {
+            close( m_Listener );
+            m_Listener = -1;
+            return false;
+        }
+        m_Epoll = epoll_create1( EPOLL_CLOEXEC );
+        m_Wake = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = &m_Listener;
+        bool registered = m_Epoll >= 0 && m_Wake >= 0 && epoll_ctl( m_Epoll, EPOLL_CTL_ADD, m_Listener, &event ) == 0;
+        event.data.ptr = &m_Wake;
+        if( !registered || epoll_ctl( m_Epoll, EPOLL_CTL_ADD, m_Wake, &event ) != 0 ) {
+            Close();
+            return false;
+        }
+        for( int i = 0; i < m_NumBlocks; ++i ) {
+            m_Blocks.push_back( new Edge[m_BlockSize] );
+            m_BlockSizes.push_back( 0 );
+        }
+        m_NumProducers = numProducers > 1 ? numProducers : 1;
+        m_NumAccepted = 0;
+        m_NumFull = 0;
+        m_ReadBlock = 0;
+        m_WriteBlock = 0;
+        m_HasBlock = false;
+        m_End = false;
+        m_Stop = false;
+        m_Failed = false;
+        m_NumEdges = 0;
+        m_NumStalls = 0;
+        m_NumDroppedBytes = 0;
+        m_Thread = std::thread( &EdgeServer::Run, this );
+        return true;
+    }
+
+    void EdgeServer::Close() {
+        if( m_Thread.joinable() ) {
+            {
+                std::unique_lock<std::mutex> lock( m_Mutex );
+                m_Stop = true;
+            }
+            m_Condition.notify_all();
+            uint64_t one = 1;
+            if( write( m_Wake, &one, sizeof(one) ) < 0 ) {}
+            m_Thread.join();
+        }
+        while( !m_Connections.empty() ) {
+            Disconnect( m_Connections.back() );
+        }
+        if( m_Wake >= 0 ) close( m_Wake );
+        m_Wake = -1;
+        if( m_Epoll >= 0 ) close( m_Epoll );
+        m_Epoll = -1;
+        if( m_Listener >= 0 ) {
+            close( m_Listener );
+            unlink( m_Path.c_str() );
+        }
+        m_Listener = -1;
+        for( unsigned int i = 0; i < m_Blocks.size(); ++i ) {
+            delete [] m_Blocks[i];
+        }
+        m_Blocks.clear();
+        m_BlockSizes.clear();
+    }
+
+    int EdgeServer::Read( const Edge*& edges ) {
+        if( m_Blocks.empty() ) return 0;
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        if( m_HasBlock ) {
+            m_HasBlock = false;
+            m_ReadBlock = (m_ReadBlock + 1) % m_NumBlocks;
+            m_NumFull--;
+            m_Condition.notify_all();
+        }
+        while( m_NumFull == 0 && !m_End ) m_Condition.wait( lock );
+        if( m_NumFull == 0 ) return 0;
+        m_HasBlock = true;
+        edges = m_Blocks[m_ReadBlock];
+        return m_BlockSizes[m_ReadBlock];
+    }
+
+    bool EdgeServer::Failed() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_Failed;
+    }
+
+    int EdgeServer::QueueDepth() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_NumFull;
+    }
+
+    int EdgeServer::NumProducers() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_NumAccepted;
+    }
+
+    unsigned long long EdgeServer::NumEdges() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_NumEdges;
+    }
+
+    unsigned long long EdgeServer::NumStalls() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_NumStalls;
+    }
+
+    unsigned long long EdgeServer::NumDroppedBytes() const {
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        return m_NumDroppedBytes;
+    }
+
+    void EdgeServer::Run() {
+        struct epoll_event events[FLOWING_SERVER_MAX_EVENTS];
+        bool done = false;
+        while( !done ) {
+            int numEvents = epoll_wait( m_Epoll, events, FLOWING_SERVER_MAX_EVENTS, -1 );
+            if( numEvents < 0 && errno == EINTR ) continue;
+            if( numEvents < 0 ) {
+                std::unique_lock<std::mutex> lock( m_Mutex );
+                m_Failed = true;
+                break;
+            }
+            for( int i = 0; i < numEvents && !done; ++i ) {
+                void* source = events[i].data.ptr;
+                if( source == &m_Wake ) {
+                    done = true;
+                } else if( source == &m_Listener ) {
+                    if( !Accept() ) {
+                        std::unique_lock<std::mutex> lock( m_Mutex );
+                        m_Failed = true;
+                        done = true;
+                    }
+                } else {
+                    Connection* connection = static_cast<Connection*>(source);
+                    if( !Receive( connection ) ) Disconnect( connection );
+                }
+            }
+            std::unique_lock<std::mutex> lock( m_Mutex );
+            done = done || m_Stop || (m_NumAccepted >= m_NumProducers && m_Connections.empty());
+        }
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        m_End = true;
+        m_Condition.notify_all();
+    }
+
+    bool EdgeServer::Accept() {
+        while( true ) {
+            int producer = accept4( m_Listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+            if( producer < 0 && (errno == EINTR || errno == ECONNABORTED) ) continue;
+            if( producer < 0 ) return errno == EAGAIN || errno == EWOULDBLOCK;
+            Connection* connection = new Connection;
+            connection->m_Socket = producer;
+            connection->m_PartialSize = 0;
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = connection;
+            if( epoll_ctl( m_Epoll, EPOLL_CTL_ADD, producer, &event ) != 0 ) {
+                close( producer );
+                delete connection;
+                return false;
+            }
+            m_Connections.push_back( connection );
+            std::unique_lock<std::mutex> lock( m_Mutex );
+            m_NumAccepted++;
+        }
+    }
+
+    bool EdgeServer::Receive( Connection* connection ) {
+        {
+            // Not receiving while the ring is full is what pushes back on the producers.
+            std::unique_lock<std::mutex> lock( m_Mutex );
+            if( m_NumFull == m_NumBlocks ) m_NumStalls++;
+            while( m_NumFull == m_NumBlocks && !m_Stop ) m_Condition.wait( lock );
+            if( m_Stop ) return true;
+        }
+        // The block at m_WriteBlock is not visible to the consumer until m_NumFull is increased. It is
+        // filled with everything the producer already sent, so small batches still make large blocks.
+        char* block = (char*)m_Blocks[m_WriteBlock];
+        const size_t capacity = m_BlockSize*sizeof(Edge);
+        size_t size = connection->m_PartialSize;
+        memcpy( block, connection->m_Partial, size );
+        bool open = true;
+        while( size < capacity ) {
+            ssize_t result = recv( connection->m_Socket, block + size, capacity - size, 0 );
+            if( result < 0 && errno == EINTR ) continue;
+            if( result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ) break;
+            if( result <= 0 ) {
+                open = false;
+                break;
+            }
+            size += result;
+        }
+        int numEdges = size / sizeof(Edge);
+        connection->m_PartialSize = size % sizeof(Edge);
+        memcpy( connection->m_Partial, block + numEdges*sizeof(Edge), connection->m_PartialSize );
+        std::unique_lock<std::mutex> lock( m_Mutex );
+        if( !open ) m_NumDroppedBytes += connection->m_PartialSize;
+        if( numEdges > 0 ) {
+            m_BlockSizes[m_WriteBlock] = numEdges;
+            m_WriteBlock = (m_WriteBlock + 1) % m_NumBlocks;
+            m_NumFull++;
+            m_NumEdges += numEdges;
+            m_Condition.notify_all();
+        }
+        return open;
+    }
+
+    void EdgeServer::Disconnect( Connection* connection ) {
+        epoll_ctl( m_Epoll, EPOLL_CTL_DEL, connection->m_Socket, NULL );
+        close( connection->m_Socket );
+        m_Connections.erase( std::find( m_Connections.begin(), m_Connections.end(), connection ) );
+        delete connection;
+    }
+}
@@ -0,0 +1,275 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Kernels.h"
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLOWING_X86
+#endif
+
+namespace flowing {
+
+    // The adjacent of a node in an edge where it takes part is always tail ^ head ^ node, so the
+    // kernels compute it for every edge without branching and only decide how far to advance.
+
+    int ScanEdgesScalar( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        const int tailMask = match & MATCH_TAIL ? 1 : 0;
+        const int headMask = match & MATCH_HEAD ? 1 : 0;
+        int count = 0;
+        for( int i = 0; i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            out[count] = tail ^ head ^ node;
+            count += ((tail == node) & tailMask) | ((head == node) & headMask);
+        }
+        return count;
+    }
+
+    int IntersectSortedScalar( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        int count = 0;
+        int i = 0;
+        int j = 0;
+        while( i < numA && j < numB ) {
+            unsigned int x = a[i];
+            unsigned int y = b[j];
+            out[count] = x;
+            count += x == y;
+            i += x <= y;
+            j += y <= x;
+        }
+        return count;
+    }
+
+#ifdef FLOWING_X86
+
+#ifdef __SSE2__
+    static int ScanEdgesSSE2( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        const __m128i nodes = _mm_set1_epi32( node );
+        const int tailMask = match & MATCH_TAIL ? 1 : 0;
+        const int headMask = match & MATCH_HEAD ? 1 : 0;
+        int count = 0;
+        int i = 0;
+        for( ; i + 2 <= numEdges; i += 2 ) {
+            __m128i data = _mm_loadu_si128( (const __m128i*)&edges[i] );
+            __m128i swapped = _mm_shuffle_epi32( data, _MM_SHUFFLE(2,3,0,1) );
+            __m128i adjacents = _mm_xor_si128( _mm_xor_si128( data, swapped ), nodes );
+            int bits = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( data, nodes ) ) );
+            out[count] = _mm_cvtsi128_si32( adjacents );
+            count += (bits & tailMask) | ((bits >> 1) & headMask);
+            out[count] = _mm_cvtsi128_si32( _mm_shuffle_epi32( adjacents, _MM_SHUFFLE(2,2,2,2) ) );
+            count += ((bits >> 2) & tailMask) | ((bits >> 3) & headMask);
+        }
+        return count + ScanEdgesScalar( &edges[i], numEdges - i, node, match, &out[count] );
+    }
+#endif
+
+    /** @brief For each combination of four matching edges, the lanes holding their adjacents.*/
+    static const int s_CompressTable[16][8] __attribute__((aligned(32))) = {
+        {0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {2,0,0,0,0,0,0,0}, {0,2,0,0,0,0,0,0},
+        {4,0,0,0,0,0,0,0}, {0,4,0,0,0,0,0,0}, {2,4,0,0,0,0,0,0}, {0,2,4,0,0,0,0,0},
+        {6,0,0,0,0,0,0,0}, {0,6,0,0,0,0,0,0}, {2,6,0,0,0,0,0,0}, {0,2,6,0,0,0,0,0},
+        {4,6,0,0,0,0,0,0}, {0,4,6,0,0,0,0,0}, {2,4,6,0,0,0,0,0}, {0,2,4,6,0,0,0,0}
+    };
+
+    __attribute__((target("avx2")))
+    static int ScanEdgesAVX2( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        const __m256i nodes = _mm256_set1_epi32( node );
+        const int tailMask = match & MATCH_TAIL ? 0x55 : 0;
+        const int headMask = match & MATCH_HEAD ? 0x55 : 0;
+        int count = 0;
+        int i = 0;
+        for( ; i + 4 <= numEdges; i += 4 ) {
+            __m256i data = _mm256_loadu_si256( (const __m256i*)&edges[i] );
+            __m256i swapped = _mm256_shuffle_epi32( data, _MM_SHUFFLE(2,3,0,1) );
+            __m256i adjacents = _mm256_xor_si256( _mm256_xor_si256( data, swapped ), nodes );
+            int bits = _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( data, nodes ) ) );
+            int valid = (bits & tailMask) | ((bits >> 1) & headMask);
+            int mask = (valid & 1) | ((valid >> 1) & 2) | ((valid >> 2) & 4) | ((valid >> 3) & 8);
+            __m256i lanes = _mm256_load_si256( (const __m256i*)s_CompressTable[mask] );
+            _mm256_storeu_si256( (__m256i*)&out[count], _mm256_permutevar8x32_epi32( adjacents, lanes ) );
+            count += __builtin_popcount( mask );
+        }
+        return count + ScanEdgesScalar( &edges[i], numEdges - i, node, match, &out[count] );
+    }
+
+    // The intersection kernels compare a block of each array against all the rotations of a block of the
+    // other, and then advance the block whose largest value is the smallest, as in Schlegel et al.
+    // Since the values are not repeated, each common value is found exactly once.
+
+#ifdef __SSE2__
+    static int IntersectSortedSSE2( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        int count = 0;
+        int i = 0;
+        int j = 0;
+        while( i + 4 <= numA && j + 4 <= numB ) {
+            __m128i va = _mm_loadu_si128( (const __m128i*)&a[i] );
+            __m128i vb = _mm_loadu_si128( (const __m128i*)&b[j] );
+            __m128i found = _mm_cmpeq_epi32( va, vb );
+            found = _mm_or_si128( found, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE(0,3,2,1) ) ) );
+            found = _mm_or_si128( found, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE(1,0,3,2) ) ) );
+            found = _mm_or_si128( found, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE(2,1,0,3) ) ) );
+            int bits = _mm_movemask_ps( _mm_castsi128_ps( found ) );
+            for( int k = 0; k < 4; ++k ) {
+                out[count] = a[i + k];
+                count += (bits >> k) & 1;
+            }
+            unsigned int maxA = a[i + 3];
+            unsigned int maxB = b[j + 3];
+            i += maxA <= maxB ? 4 : 0;
+            j += maxB <= maxA ? 4 : 0;
+        }
+        return count + IntersectSortedScalar( &a[i], numA - i, &b[j], numB - j, &out[count] );
+    }
+#endif
+
+    /** @brief For each combination of eight lanes, the lanes packed at the front.*/
+    static int s_PackTable[256][8] __attribute__((aligned(32)));
+
+    static bool InitializePackTable() {
+        for( int mask = 0; mask < 256; ++mask ) {
+            int count = 0;
+            for( int lane = 0; lane < 8; ++lane ) {
+                s_PackTable[mask][lane] = 0;
+            }
+            for( int lane = 0; lane < 8; ++lane ) {
+                if( mask & (1 << lane) ) s_PackTable[mask][count++] = lane;
+            }
+        }
+        return true;
+    }
+
+    __attribute__((target("avx2")))
+    static int IntersectSortedAVX2( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        const __m256i rotate = _mm256_setr_epi32( 1, 2, 3, 4, 5, 6, 7, 0 );
+        int count = 0;
+        int i = 0;
+        int j = 0;
+        while( i + 8 <= numA && j + 8 <= numB ) {
+            __m256i va = _mm256_loadu_si256( (const __m256i*)&a[i] );
+            __m256i vb = _mm256_loadu_si256( (const __m256i*)&b[j] );
+            __m256i found = _mm256_cmpeq_epi32( va, vb );
+            for( int k = 1; k < 8; ++k ) {
+                vb = _mm256_permutevar8x32_epi32( vb, rotate );
+                found = _mm256_or_si256( found, _mm256_cmpeq_epi32( va, vb ) );
+            }
+            int mask = _mm256_movemask_ps( _mm256_castsi256_ps( found ) );
+            __m256i lanes = _mm256_load_si256( (const __m256i*)s_PackTable[mask] );
+            _mm256_storeu_si256( (__m256i*)&out[count], _mm256_permutevar8x32_epi32( va, lanes ) );
+            count += __builtin_popcount( mask );
+            unsigned int maxA = a[i + 7];
+            unsigned int maxB = b[j + 7];
+            i += maxA <= maxB ? 8 : 0;
+            j += maxB <= maxA ? 8 : 0;
+        }
+        return count + IntersectSortedScalar( &a[i], numA - i, &b[j], numB - j, &out[count] );
+    }
+
+    typedef int (*IntersectSortedFunction)( const unsigned int*, const int, const unsigned int*, const int, unsigned int* );
+
+    static IntersectSortedFunction SelectIntersectSorted() {
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports( "avx2" ) && InitializePackTable() ) return IntersectSortedAVX2;
+#ifdef __SSE2__
+        return IntersectSortedSSE2;
+#else
+        return IntersectSortedScalar;
+#endif
+    }
+
+    static const IntersectSortedFunction s_IntersectSorted = SelectIntersectSorted();
+
+    int IntersectSorted( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        return s_IntersectSorted( a, numA, b, numB, out );
+    }
+
+    typedef int (*ScanEdgesFunction)( const Edge*, const int, const unsigned int, const int, unsigned int* );
+
+    static ScanEdgesFunction SelectScanEdges() {
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports( "avx2" ) ) return ScanEdgesAVX2;
+#ifdef __SSE2__
+        return ScanEdgesSSE2;
+#else
+        return ScanEdgesScalar;
+#endif
+    }
+
+    static const ScanEdgesFunction s_ScanEdges = SelectScanEdges();
+
+    int ScanEdges( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        return s_ScanEdges( edges, numEdges, node, match, out );
+    }
+
+    bool KernelSupported( const KernelLevel level ) {
+        switch( level ) {
+            case KERNEL_AVX2:
+                // The pack table of IntersectSortedAVX2 was filled when the kernel was selected.
+                return __builtin_cpu_supports( "avx2" );
+            case KERNEL_SSE2:
+#ifdef __SSE2__
+                return true;
+#else
+                return false;
+#endif
+            default:
+                return true;
+        }
+    }
+
+    int ScanEdgesWith( const KernelLevel level, const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        assert( KernelSupported( level ) );
+        if( level == KERNEL_AVX2 ) return ScanEdgesAVX2( edges, numEdges, node, match, out );
+#ifdef __SSE2__
+        if( level == KERNEL_SSE2 ) return ScanEdgesSSE2( edges, numEdges, node, match, out );
+#endif
+        return ScanEdgesScalar( edges, numEdges, node, match, out );
+    }
+
+    int IntersectSortedWith( const KernelLevel level, const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        assert( KernelSupported( level ) );
+        if( level == KERNEL_AVX2 ) return IntersectSortedAVX2( a, numA, b, numB, out );
+#ifdef __SSE2__
+        if( level == KERNEL_SSE2 ) return IntersectSortedSSE2( a, numA, b, numB, out );
+#endif
+        return IntersectSortedScalar( a, numA, b, numB, out );
+    }
+
+#else
+
+    int ScanEdges( const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        return ScanEdgesScalar( edges, numEdges, node, match, out );
+    }
+
+    int IntersectSorted( const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        return IntersectSortedScalar( a, numA, b, numB, out );
+    }
+
+    bool KernelSupported( const KernelLevel level ) {
+        return level == KERNEL_SCALAR;
+    }
+
+    int ScanEdgesWith( const KernelLevel level, const Edge* edges, const int numEdges, const unsigned int node, const int match, unsigned int* out ) {
+        assert( KernelSupported( level ) );
+        return ScanEdgesScalar( edges, numEdges, node, match, out );
+    }
+
+    int IntersectSortedWith( const KernelLevel level, const unsigned int* a, const int numA, const unsigned int* b, const int numB, unsigned int* out ) {
+        assert( KernelSupported( level ) );
+        return IntersectSortedScalar( a, numA, b, numB, out );
+    }
+
+#endif
+}
@@ -0,0 +1,49 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MemoryUsage.h"
+
+namespace flowing {
+
+    MemoryUsage::MemoryUsage() {
+        for( int i = 0; i < MEMORY_NUM_SUBSYSTEMS; ++i ) {
+            m_Bytes[i] = 0;
+        }
+    }
+
+    size_t MemoryUsage::Total() const {
+        size_t total = 0;
+        for( int i = 0; i < MEMORY_NUM_SUBSYSTEMS; ++i ) {
+            total += m_Bytes[i];
+        }
+        return total;
+    }
+
+    const char* MemoryUsage::Name( const int subsystem ) {
+        static const char* names[MEMORY_NUM_SUBSYSTEMS] = {
+            "buffer pool",
+            "pages",
+            "adjacency lists",
+            "id maps",
+            "node state",
+            "spill index",
+            "communities",
+            "sketch",
+            "triangles",
+            "partitions",
+            "neighbor counts"
+        };
+        return subsystem >= 0 && subsystem < MEMORY_NUM_SUBSYSTEMS ? names[subsystem] : "unknown";
+    }
+}
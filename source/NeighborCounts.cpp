@@ -0,0 +1,115 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "NeighborCounts.h"
+#include "MemoryUsage.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace flowing {
+
+    NeighborCounts::NeighborCounts() :
+        m_Enabled( false ),
+        m_NumLabels( 0 ),
+        m_EntryBytes( 0 ),
+        m_NumUpdates( 0 ) {
+    }
+
+    NeighborCounts::~NeighborCounts() {
+    }
+
+    void NeighborCounts::Configure( const bool enabled ) {
+        m_Enabled = enabled;
+    }
+
+    bool NeighborCounts::Enabled() const {
+        return m_Enabled;
+    }
+
+    void NeighborCounts::AddNode() {
+        m_Entries.push_back( Entries() );
+        m_Degrees.push_back( 0 );
+    }
+
+    void NeighborCounts::ClearNode( const unsigned int node ) {
+        Entries& entries = m_Entries[node];
+        assert( entries.empty() && m_Degrees[node] == 0 );
+        if( entries.capacity() > 0 ) m_EntryBytes -= entries.capacity()*sizeof(Entry) + FLOWING_MALLOC_OVERHEAD;
+        Entries().swap( entries );
+    }
+
+    size_t NeighborCounts::Find( const Entries& entries, const unsigned long long label ) {
+        return std::lower_bound( entries.begin(), entries.end(), label,
+                                 []( const Entry& entry, const unsigned long long value ) { return entry.m_Label < value; } ) - entries.begin();
+    }
+
+    void NeighborCounts::Add( const unsigned int node, const unsigned long long label, const unsigned int weight ) {
+        m_NumUpdates++;
+        m_Degrees[node] += weight;
+        Entries& entries = m_Entries[node];
+        size_t position = Find( entries, label );
+        if( position < entries.size() && entries[position].m_Label == label ) {
+            entries[position].m_Count += weight;
+            return;
+        }
+        size_t capacity = entries.capacity();
+        Entry entry;
+        entry.m_Label = label;
+        entry.m_Count = weight;
+        entries.insert( entries.begin() + position, entry );
+        m_NumLabels++;
+        if( entries.capacity() != capacity ) {
+            if( capacity > 0 ) m_EntryBytes -= capacity*sizeof(Entry) + FLOWING_MALLOC_OVERHEAD;
+            m_EntryBytes += entries.capacity()*sizeof(Entry) + FLOWING_MALLOC_OVERHEAD;
+        }
+    }
+
+    void NeighborCounts::Subtract( const unsigned int node, const unsigned long long label, const unsigned int weight ) {
+        m_NumUpdates++;
+        assert( m_Degrees[node] >= weight );
+        m_Degrees[node] -= weight;
+        Entries& entries = m_Entries[node];
+        size_t position = Find( entries, label );
+        assert( position < entries.size() && entries[position].m_Label == label && entries[position].m_Count >= weight );
+        // The emptied entries are erased, so that the labels of freed communities never linger, and
+        // the capacity is kept for the labels that come next.
+        entries[position].m_Count -= weight;
+        if( entries[position].m_Count == 0 ) {
+            entries.erase( entries.begin() + position );
+            m_NumLabels--;
+        }
+    }
+
+    unsigned int NeighborCounts::Count( const unsigned int node, const unsigned long long label ) const {
+        const Entries& entries = m_Entries[node];
+        size_t position = Find( entries, label );
+        return position < entries.size() && entries[position].m_Label == label ? entries[position].m_Count : 0;
+    }
+
+    unsigned int NeighborCounts::Degree( const unsigned int node ) const {
+        return m_Degrees[node];
+    }
+
+    size_t NeighborCounts::NumLabels() const {
+        return m_NumLabels;
+    }
+
+    unsigned long long NeighborCounts::NumUpdates() const {
+        return m_NumUpdates;
+    }
+
+    size_t NeighborCounts::Bytes() const {
+        return m_Entries.capacity()*sizeof(Entries) + m_Degrees.capacity()*sizeof(unsigned int) + m_EntryBytes;
+    }
+}
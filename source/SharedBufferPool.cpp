@@ -0,0 +1,148 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SharedBufferPool.h"
+#include <assert.h>
+
+namespace flowing {
+
+    SharedBufferPool::SharedBufferPool( const int numBuffers, const int bufferSize, const int flags, const int numaNode ) :
+        m_Pool( numBuffers, bufferSize, flags, numaNode ),
+        m_NumRequests( 0 ) {
+    }
+
+    SharedBufferPool::~SharedBufferPool() {
+    }
+
+    bool SharedBufferPool::Initialize() {
+        return m_Pool.Initialize();
+    }
+
+    void SharedBufferPool::Close() {
+        m_Free.clear();
+        m_Clients.clear();
+        m_Pool.Close();
+    }
+
+    int SharedBufferPool::Register( const int minBuffers, const int maxBuffers ) {
+        std::lock_guard<std::mutex> lock( m_Mutex );
+        int reserved = minBuffers;
+        for( unsigned int i = 0; i < m_Clients.size(); ++i ) {
+            if( m_Clients[i].m_Active ) reserved += m_Clients[i].m_Min;
+        }
+        if( reserved > m_Pool.MaxNumBuffers() ) return -1;
+        Client client;
+        client.m_Active = true;
+        client.m_Min = minBuffers;
+        client.m_Max = maxBuffers > minBuffers ? maxBuffers : minBuffers;
+        client.m_Used = 0;
+        client.m_Quota = client.m_Max;
+        client.m_Demand = 0.0;
+        for( unsigned int i = 0; i < m_Clients.size(); ++i ) {
+            if( !m_Clients[i].m_Active ) {
+                m_Clients[i] = client;
+                return i;
+            }
+        }
+        m_Clients.push_back( client );
+        return m_Clients.size() - 1;
+    }
+
+    void SharedBufferPool::Unregister( const int client ) {
+        std::lock_guard<std::mutex> lock( m_Mutex );
+        assert( m_Clients[client].m_Used == 0 );
+        m_Clients[client].m_Active = false;
+    }
+
+    void* SharedBufferPool::Acquire( const int client ) {
+        std::lock_guard<std::mutex> lock( m_Mutex );
+        Client& self = m_Clients[client];
+        self.m_Demand += 1.0;
+        if( ++m_NumRequests == FLOWING_ARBITER_EPOCH ) {
+            // Old requests count less, so the quotas follow the changes in the load of the streams.
+            for( unsigned int i = 0; i < m_Clients.size(); ++i ) {
+                m_Clients[i].m_Demand /= 2;
+            }
+            m_NumRequests = 0;
+        }
+        if( self.m_Used >= self.m_Max ) return NULL;
+        if( self.m_Used >= self.m_Min ) {
+            // A client at its quota may have become busier than the others since the last arbitration.
+            if( self.m_Used >= self.m_Quota ) Arbitrate();
+            if( self.m_Used >= self.m_Quota ) return NULL;
+            if( Unreserved( client ) == 0 ) {
+                // The pool is exhausted, so the client reuses its own buffers while the others shrink to their quotas.
+                Arbitrate();
+                return NULL;
+            }
+        }
+        void* buffer = NULL;
+        if( !m_Free.empty() ) {
+            buffer = m_Free.back();
+            m_Free.pop_back();
+        } else {
+            buffer = m_Pool.NextBuffer();
+        }
+        if( buffer != NULL ) self.m_Used++;
+        return buffer;
+    }
+
+    void SharedBufferPool::Release( const int client, void* buffer ) {
+        std::lock_guard<std::mutex> lock( m_Mutex );
+        assert( m_Clients[client].m_Used > 0 );
+        m_Clients[client].m_Used--;
+        m_Free.push_back( buffer );
+    }
+
+    int SharedBufferPool::Excess( const int client ) {
+        std::lock_guard<std::mutex> lock( m_Mutex );
+        const Client& self = m_Clients[client];
+        return self.m_Used > self.m_Quota ? self.m_Used - self.m_Quota : 0;
+    }
+
+    int SharedBufferPool::NumUsed( const int client ) {
+        std::lock_guard<std::mutex> lock( m_Mutex );
+        return m_Clients[client].m_Used;
+    }
+
+    int SharedBufferPool::BufferSize() const {
+        return m_Pool.m_BufferSize;
+    }
+
+    int SharedBufferPool::Unreserved( const int client ) const {
+        int available = m_Free.size() + m_Pool.m_NumBuffers - m_Pool.m_Next;
+        for( unsigned int i = 0; i < m_Clients.size(); ++i ) {
+            const Client& other = m_Clients[i];
+            if( (int)i != client && other.m_Active && other.m_Used < other.m_Min ) available -= other.m_Min - other.m_Used;
+        }
+        return available > 0 ? available : 0;
+    }
+
+    void SharedBufferPool::Arbitrate() {
+        int spare = m_Pool.MaxNumBuffers();
+        double demand = 0.0;
+        for( unsigned int i = 0; i < m_Clients.size(); ++i ) {
+            if( !m_Clients[i].m_Active ) continue;
+            spare -= m_Clients[i].m_Min;
+            demand += m_Clients[i].m_Demand;
+        }
+        for( unsigned int i = 0; i < m_Clients.size(); ++i ) {
+            Client& client = m_Clients[i];
+            if( !client.m_Active ) continue;
+            int share = demand > 0.0 ? (int)(spare*(client.m_Demand / demand)) : 0;
+            client.m_Quota = client.m_Min + share;
+            if( client.m_Quota > client.m_Max ) client.m_Quota = client.m_Max;
+        }
+    }
+}
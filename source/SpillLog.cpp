@@ -0,0 +1,144 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SpillLog.h"
+#include <cstring>
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace flowing {
+
+    SpillLog::SpillLog() :
+        m_File( -1 ),
+        m_Data( NULL ),
+        m_Size( 0 ),
+        m_SlotSize( 0 ),
+        m_NumSlots( 0 ),
+        m_Next( 0 ),
+        m_NextSlot( 0 ),
+        m_NumSegments( 0 ),
+        m_OsPageSize( sysconf(_SC_PAGESIZE) ) {
+        for( int i = 0; i < FLOWING_SPILL_ADVISED_PAGES; ++i ) m_Advised[i].store( 0, std::memory_order_relaxed );
+    }
+
+    SpillLog::~SpillLog() {
+        Close();
+    }
+
+    bool SpillLog::Open( const char* path, const size_t budget, const int maxEdges ) {
+        assert( m_Data == NULL );
+        // Each slot starts with a header record holding the number of edges in the segment.
+        m_SlotSize = (maxEdges + 1)*sizeof(Edge);
+        m_NumSlots = budget / m_SlotSize;
+        if( m_NumSlots == 0 ) return false;
+        m_Size = (size_t)m_NumSlots*m_SlotSize;
+        m_File = open( path, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+        if( m_File < 0 ) return false;
+        m_Path = path;
+        if( ftruncate( m_File, m_Size ) != 0 ) {
+            Close();
+            return false;
+        }
+        void* data = mmap( NULL, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0 );
+        if( data == MAP_FAILED ) {
+            Close();
+            return false;
+        }
+        m_Data = (unsigned char*)data;
+        madvise( m_Data, m_Size, MADV_RANDOM );
+        m_Next = 0;
+        m_NextSlot = 0;
+        m_NumSegments = 0;
+        for( int i = 0; i < FLOWING_SPILL_ADVISED_PAGES; ++i ) m_Advised[i].store( 0, std::memory_order_relaxed );
+        return true;
+    }
+
+    void SpillLog::Close() {
+        if( m_Data ) munmap( m_Data, m_Size );
+        if( m_File >= 0 ) {
+            close( m_File );
+            unlink( m_Path.c_str() );
+        }
+        m_Data = NULL;
+        m_File = -1;
+        m_Size = 0;
+        m_NumSegments = 0;
+    }
+
+    bool SpillLog::IsOpen() const {
+        return m_Data != NULL;
+    }
+
+    bool SpillLog::IsFull() const {
+        return m_NumSegments == m_NumSlots;
+    }
+
+    unsigned int SpillLog::Append( const Edge* edges, const int numEdges ) {
+        assert( (int)((numEdges + 1)*sizeof(Edge)) <= m_SlotSize );
+        unsigned int segment = m_Next++;
+        Edge* slot = (Edge*)(m_Data + (size_t)m_NextSlot*m_SlotSize);
+        m_NextSlot = (m_NextSlot + 1) % m_NumSlots;
+        slot[0].m_Tail = numEdges;
+        slot[0].m_Head = segment;
+        memcpy( &slot[1], edges, numEdges*sizeof(Edge) );
+        if( m_NumSegments < m_NumSlots ) m_NumSegments++;
+        return segment;
+    }
+
+    bool SpillLog::IsValid( const unsigned int segment ) const {
+        // Unsigned arithmetic keeps this correct when the segment ids wrap around.
+        return (m_Next - segment - 1) < m_NumSegments;
+    }
+
+    unsigned int SpillLog::Oldest() const {
+        return m_Next - m_NumSegments;
+    }
+
+    const Edge* SpillLog::Segment( const unsigned int segment, int& numEdges ) const {
+        assert( IsValid( segment ) );
+        const Edge* slot = (const Edge*)Slot( segment );
+        numEdges = slot[0].m_Tail;
+        return &slot[1];
+    }
+
+    void SpillLog::Prefetch( const unsigned int segment ) const {
+        unsigned char* slot = Slot( segment );
+        size_t pageIndex = (slot - m_Data) / m_OsPageSize;
+        // The advice is only a hint, so a page advised recently is not advised again. This keeps
+        // the system calls away from segments that were just written or read.
+        std::atomic<unsigned int>& advised = m_Advised[pageIndex % FLOWING_SPILL_ADVISED_PAGES];
+        if( advised.load( std::memory_order_relaxed ) == pageIndex + 1 ) return;
+        advised.store( pageIndex + 1, std::memory_order_relaxed );
+        unsigned char* page = m_Data + pageIndex*m_OsPageSize;
+        size_t length = (slot + m_SlotSize) - page;
+        madvise( page, length, MADV_WILLNEED );
+    }
+
+    unsigned int SpillLog::NumSegments() const {
+        return m_NumSegments;
+    }
+
+    size_t SpillLog::Bytes() const {
+        return m_Size;
+    }
+
+    unsigned char* SpillLog::Slot( const unsigned int segment ) const {
+        // Slots are addressed by the age of the segment so the mapping survives the id wrapping around.
+        unsigned int age = m_Next - segment;
+        unsigned int slot = (m_NextSlot + m_NumSlots - age) % m_NumSlots;
+        return m_Data + (size_t)slot*m_SlotSize;
+    }
+}
@@ -14,7 +14,10 @@
 
 #include "Types.h"
 #include "StreamGraph.h"
+#include "Kernels.h"
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include <assert.h>
 
 namespace flowing {
@@ -28,6 +31,8 @@ namespace flowing {
         page->m_Buffer = (Edge*)buffer; 
         page->m_NumEdges = 0;
         page->m_MaxEdges = size / sizeof(Edge);
+        page->m_Weight = 1;
+        page->m_Batch = 0;
         return page;
     }
 
@@ -41,6 +46,7 @@ namespace flowing {
     StreamGraph::AdjacencyListNode* StreamGraph::AllocateAdjacencyListNode() {
         AdjacencyListNode* node = (AdjacencyListNode*)malloc(sizeof(AdjacencyListNode));
         if( node == NULL ) return NULL;
+        m_NumListNodes++;
         node->m_Next = NULL;
         node->m_Previous = NULL;
         node->m_Page = NULL;
@@ -49,6 +55,8 @@ namespace flowing {
 
     void StreamGraph::FreeAdjacencyListNode( AdjacencyListNode* adjacencyListNode ) {
         assert(adjacencyListNode);
+        m_NumListNodes--;
+        free(adjacencyListNode);
     }
 
     /// ADJACENCY LIST METHODS
@@ -59,6 +67,8 @@ namespace flowing {
         list->m_Node = id;
         list->m_First = NULL;
         list->m_Last = NULL;
+        list->m_InFirst = NULL;
+        list->m_InLast = NULL;
         return list;
     }
 
@@ -68,11 +78,39 @@ namespace flowing {
 
     /// ADJACENCY ITERATOR METHODS
 
-    StreamGraph::AdjacencyIterator::AdjacencyIterator( const AdjacencyList* adjacencyList, StreamGraph::EdgeMode mode ) :
+    StreamGraph::AdjacencyIterator::AdjacencyIterator( const AdjacencyList* adjacencyList, StreamGraph::EdgeMode mode, StreamGraph::Direction direction, const SpillLog* spillLog, const UVector* spillIndex ) :
             m_AdjacencyList( adjacencyList ),
-            m_EdgeMode( mode ) {
-            m_CurrentNode = m_AdjacencyList != NULL ? m_AdjacencyList->m_First : NULL;
+            m_EdgeMode( mode ),
+            m_SpillLog( spillLog ),
+            m_SpillIndex( spillIndex ) {
+            m_CurrentNode = NULL;
+            m_VisitIn = false;
+            if( m_EdgeMode == UNDIRECTED ) {
+                m_Match = MATCH_ANY;
+                m_SpillMatch = MATCH_ANY;
+            } else if( direction == IN ) {
+                m_Match = MATCH_HEAD;
+                m_SpillMatch = MATCH_HEAD;
+            } else {
+                // Both directions visit the out list first and then the in list.
+                m_Match = MATCH_TAIL;
+                m_SpillMatch = direction == BOTH ? MATCH_ANY : MATCH_TAIL;
+                m_VisitIn = direction == BOTH;
+            }
+            if( m_AdjacencyList != NULL ) {
+                m_CurrentNode = m_Match == MATCH_HEAD ? m_AdjacencyList->m_InFirst : m_AdjacencyList->m_First;
+            }
             m_CurrentIndex = 0;
+            m_SpillPosition = 0;
+            m_SpillEdges = NULL;
+            m_SpillNumEdges = 0;
+            m_SpillEdgeIndex = 0;
+            if( m_SpillIndex != NULL ) {
+                // Start reading the spilled segments in the background while the pages in memory are visited.
+                for( unsigned int i = 0; i < m_SpillIndex->size() && i < FLOWING_SPILL_READAHEAD; ++i ) {
+                    if( m_SpillLog->IsValid( (*m_SpillIndex)[i] ) ) m_SpillLog->Prefetch( (*m_SpillIndex)[i] );
+                }
+            }
     }
 
     StreamGraph::AdjacencyIterator::~AdjacencyIterator() {
@@ -80,25 +118,48 @@ namespace flowing {
     }
 
     bool StreamGraph::AdjacencyIterator::HasNext() {
-        if( (m_AdjacencyList == NULL) || (m_AdjacencyList->m_First == NULL) ) return false;
-        while( m_CurrentNode != NULL ) {
-            for( ; m_CurrentIndex < m_CurrentNode->m_Page->m_NumEdges; ++m_CurrentIndex ) {
-                Edge* edge = &m_CurrentNode->m_Page->m_Buffer[m_CurrentIndex];
-                if( (edge->m_Tail == m_AdjacencyList->m_Node) )  {
+        if( m_AdjacencyList == NULL ) return false;
+        while( true ) {
+            while( m_CurrentNode != NULL ) {
+                for( ; m_CurrentIndex < m_CurrentNode->m_Page->m_NumEdges; ++m_CurrentIndex ) {
+                    Edge* edge = &m_CurrentNode->m_Page->m_Buffer[m_CurrentIndex];
+                    if( (m_Match & MATCH_TAIL) && (edge->m_Tail == m_AdjacencyList->m_Node) )  {
+                        return true;
+                    }
+                    if( (m_Match & MATCH_HEAD) && (edge->m_Head == m_AdjacencyList->m_Node) ) {
+                        return true;
+                    }
+                }
+                m_CurrentNode = m_CurrentNode->m_Next;
+                m_CurrentIndex = 0;
+            }
+            if( !m_VisitIn ) break;
+            m_VisitIn = false;
+            m_Match = MATCH_HEAD;
+            m_CurrentNode = m_AdjacencyList->m_InFirst;
+        }
+        if( m_SpillIndex == NULL ) return false;
+        while( true ) {
+            for( ; m_SpillEdgeIndex < m_SpillNumEdges; ++m_SpillEdgeIndex ) {
+                const Edge* edge = &m_SpillEdges[m_SpillEdgeIndex];
+                if( (m_SpillMatch & MATCH_TAIL) && (edge->m_Tail == m_AdjacencyList->m_Node) )  {
                     return true;
                 }
-                if( m_EdgeMode == UNDIRECTED && (edge->m_Head == m_AdjacencyList->m_Node) ) {
+                if( (m_SpillMatch & MATCH_HEAD) && (edge->m_Head == m_AdjacencyList->m_Node) ) {
                     return true;
                 }
             }
-            m_CurrentNode = m_CurrentNode->m_Next;
-            m_CurrentIndex = 0;
+            while( m_SpillPosition < m_SpillIndex->size() && !m_SpillLog->IsValid( (*m_SpillIndex)[m_SpillPosition] ) ) ++m_SpillPosition;
+            if( m_SpillPosition >= m_SpillIndex->size() ) return false;
+            unsigned int ahead = m_SpillPosition + FLOWING_SPILL_READAHEAD;
+            if( ahead < m_SpillIndex->size() && m_SpillLog->IsValid( (*m_SpillIndex)[ahead] ) ) m_SpillLog->Prefetch( (*m_SpillIndex)[ahead] );
+            m_SpillEdges = m_SpillLog->Segment( (*m_SpillIndex)[m_SpillPosition++], m_SpillNumEdges );
+            m_SpillEdgeIndex = 0;
         }
-        return false;
     }
 
     unsigned int StreamGraph::AdjacencyIterator::Next() {
-        Edge* edge = &m_CurrentNode->m_Page->m_Buffer[m_CurrentIndex++];
+        const Edge* edge = m_CurrentNode != NULL ? &m_CurrentNode->m_Page->m_Buffer[m_CurrentIndex++] : &m_SpillEdges[m_SpillEdgeIndex++];
         return edge->m_Tail == m_AdjacencyList->m_Node ? edge->m_Head : edge->m_Tail;
     }
 
@@ -120,9 +181,33 @@ namespace flowing {
         m_Remove = remove;
         m_NodeDataAllocate = nodeDataAllocate;
         m_NodeDataFree = nodeDataFree;
+        m_UserData = NULL;
         m_BatchSize = batchSize > 0 ? batchSize : 1;
         m_Batch = NULL;
         m_NumInBatch = 0;
+        m_BatchWeight = 1;
+        m_NumBatches = 0;
+        m_CallbackWeight = 1;
+        m_Weighted = false;
+        m_SpillBudget = 0;
+        m_SpillPolicy = SPILL_ARCHIVE;
+        m_NodeReclaim = NULL;
+        m_NodeDataUsage = NULL;
+        m_NodeLabel = NULL;
+        m_NumReclaimed = 0;
+        m_MemoryBudget = 0;
+        m_PageLimit = std::numeric_limits<size_t>::max();
+        m_NumBudgetEvictions = 0;
+        m_EdgesSinceBudgetCheck = 0;
+        m_EdgesSinceQuotaCheck = 0;
+        m_BudgetUnmet = false;
+        m_SharedPool = NULL;
+        m_PoolClient = -1;
+        m_SharedMin = 1;
+        m_SharedMax = 1;
+        m_Verbose = true;
+        m_NumListNodes = 0;
+        m_NumSpillIndexEntries = 0;
     }
 
     StreamGraph::~StreamGraph() {
@@ -130,49 +215,262 @@ namespace flowing {
     }
 
     bool StreamGraph::Initialize() {
-        m_Batch = (Edge*)malloc(sizeof(Edge)*m_BatchSize); 
+        m_Batch = (Edge*)malloc(sizeof(Edge)*(m_Tuner.Enabled() ? m_Tuner.MaxSize() : m_BatchSize));
+        if( !m_SpillPath.empty() && !m_Spill.Open( m_SpillPath.c_str(), m_SpillBudget, FLOWING_PAGE_SIZE / sizeof(Edge) ) ) {
+            return false;
+        }
+        if( m_SharedPool != NULL ) {
+            m_PoolClient = m_SharedPool->Register( m_SharedMin, m_SharedMax );
+            return m_PoolClient >= 0;
+        }
         return m_BufferPool.Initialize();
     }
 
     void StreamGraph::Close() {
         if(m_NumInBatch > 0) {
           //  std::cout << "Processing batch ..." << std::endl;
+            m_CallbackWeight = m_BatchWeight;
             m_Insert( this, m_Batch, m_NumInBatch);
         }
 
         // FREE MEMORY
         free(m_Batch);
+        m_Batch = NULL;
         for( std::list<AdjacencyPage*>::iterator it = m_Pages.begin(); it != m_Pages.end(); ++it ) {
+            if( m_SharedPool != NULL ) m_SharedPool->Release( m_PoolClient, (*it)->m_Buffer );
             FreeAdjacencyPage(*it);
         }
+        m_Pages.clear();
+        for( unsigned int i = 0; i < m_FreePages.size(); ++i ) {
+            FreeAdjacencyPage( m_FreePages[i] );
+        }
+        m_FreePages.clear();
 
         for( unsigned int i = 0; i < m_Adjacencies.size(); ++i ) {
+            if( m_Reclaimed[i] ) {
+                FreeAdjacencyList( m_Adjacencies[i] );
+                continue;
+            }
             AdjacencyListNode* node = m_Adjacencies[i]->m_First;
             while( node != NULL ) {
                 AdjacencyListNode* aux = node;
                 node = node->m_Next;
                 FreeAdjacencyListNode(aux);
             };
+            node = m_Adjacencies[i]->m_InFirst;
+            while( node != NULL ) {
+                AdjacencyListNode* aux = node;
+                node = node->m_Next;
+                FreeAdjacencyListNode(aux);
+            };
             FreeAdjacencyList( m_Adjacencies[i] );
             m_NodeDataFree( this, i, m_NodeData[i] );
         }
+        m_SpillIndex.clear();
+        m_SpillWeights.clear();
+        m_NumSpillIndexEntries = 0;
+        m_Spill.Close();
+        if( m_SharedPool != NULL && m_PoolClient >= 0 ) {
+            m_SharedPool->Unregister( m_PoolClient );
+            m_PoolClient = -1;
+        }
         m_BufferPool.Close();
     }
 
-    void StreamGraph::Push( std::istream& stream ) {
-        unsigned int tail;
-        while( stream >> tail ) {
-            unsigned int head;
-            stream >> head;
-            Push(tail,head);
+    void StreamGraph::ConfigureBufferPool( const int flags, const int numaNode ) {
+        m_BufferPool.Configure( flags, numaNode );
+    }
+
+    void StreamGraph::SetNumPages( const int numPages ) {
+        m_BufferPool.SetNumBuffers( numPages );
+    }
+
+    void StreamGraph::SetSharedBufferPool( SharedBufferPool* pool, const int minPages, const int maxPages ) {
+        m_SharedPool = pool;
+        m_SharedMin = minPages > 0 ? minPages : 1;
+        m_SharedMax = maxPages > m_SharedMin ? maxPages : m_SharedMin;
+    }
+
+    void StreamGraph::SetVerbose( const bool verbose ) {
+        m_Verbose = verbose;
+    }
+
+    void StreamGraph::ConfigureSpill( const char* path, const size_t budget, const SpillPolicy policy ) {
+        m_SpillPath = path != NULL ? path : "";
+        m_SpillBudget = budget;
+        m_SpillPolicy = policy;
+    }
+
+    void StreamGraph::ConfigureSampling( const double throughput, const int queueDepth ) {
+        m_Sampler.Configure( throughput, queueDepth );
+    }
+
+    void StreamGraph::ConfigureBatchTuning( const int minSize, const int maxSize, const double latency ) {
+        // Once initialized, the batch was sized for the old bounds, so it is processed and sized again.
+        if( m_Batch != NULL && m_NumInBatch > 0 ) ProcessBatch();
+        m_Tuner.Configure( m_BatchSize, minSize, maxSize, latency );
+        if( m_Tuner.Enabled() ) m_BatchSize = m_Tuner.Size();
+        if( m_Batch != NULL ) {
+            free(m_Batch);
+            m_Batch = (Edge*)malloc(sizeof(Edge)*(m_Tuner.Enabled() ? m_Tuner.MaxSize() : m_BatchSize));
+        }
+    }
+
+    const BatchTuner& StreamGraph::Tuner() const {
+        return m_Tuner;
+    }
+
+    int StreamGraph::BatchSize() const {
+        return m_BatchSize;
+    }
+
+    const EdgeSampler& StreamGraph::Sampler() const {
+        return m_Sampler;
+    }
+
+    void StreamGraph::SetReclaimNodes( bool (*reclaim)( StreamGraph*, unsigned int, void* ) ) {
+        m_NodeReclaim = reclaim;
+    }
+
+    void StreamGraph::SetNeighborLabels( unsigned long long (*label)( const StreamGraph*, unsigned int ) ) {
+        m_NodeLabel = label;
+        m_Counts.Configure( label != NULL );
+    }
+
+    const NeighborCounts& StreamGraph::Counts() const {
+        return m_Counts;
+    }
+
+    void StreamGraph::Relabel( const unsigned int nodeId, const unsigned long long oldLabel, const unsigned long long newLabel ) {
+        if( m_NodeLabel == NULL || oldLabel == newLabel ) return;
+        // A node shows up among the neighbours of each of its neighbours once per adjacency, so the
+        // adjacencies of the node itself tell which counts carry its label.
+        UVector* weights = m_Weighted ? &m_RelabelWeights : NULL;
+        unsigned int numNeighbors = Neighbors( nodeId, m_RelabelNeighbors, BOTH, weights );
+        for( unsigned int i = 0; i < numNeighbors; ++i ) {
+            unsigned int weight = weights != NULL ? m_RelabelWeights[i] : 1;
+            m_Counts.Subtract( m_RelabelNeighbors[i], oldLabel, weight );
+            m_Counts.Add( m_RelabelNeighbors[i], newLabel, weight );
+        }
+    }
+
+    void StreamGraph::CountAdjacencies( const Edge* edges, const int numEdges, const bool insert, const bool spilled, const unsigned int weight ) {
+        // Neighbors visits a self loop once in UNDIRECTED mode and in the spill log, and once per list otherwise.
+        bool doubleLoops = m_EdgeMode == DIRECTED && !spilled;
+        for( int i = 0; i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            bool both = tail != head || doubleLoops;
+            if( insert ) {
+                m_Counts.Add( tail, m_NodeLabel( this, head ), weight );
+                if( both ) m_Counts.Add( head, m_NodeLabel( this, tail ), weight );
+            } else {
+                m_Counts.Subtract( tail, m_NodeLabel( this, head ), weight );
+                if( both ) m_Counts.Subtract( head, m_NodeLabel( this, tail ), weight );
+            }
+        }
+    }
+
+    void StreamGraph::SetMemoryBudget( const size_t budget ) {
+        m_MemoryBudget = budget;
+    }
+
+    void StreamGraph::SetNodeDataUsage( void (*usage)( const StreamGraph*, MemoryUsage& ) ) {
+        m_NodeDataUsage = usage;
+    }
+
+    void StreamGraph::GetMemoryUsage( MemoryUsage& usage ) const {
+        usage = MemoryUsage();
+        size_t numNodes = m_Adjacencies.size();
+        size_t numPages = m_Pages.size() + m_FreePages.size();
+        if( m_SharedPool != NULL ) {
+            usage.m_Bytes[MEMORY_BUFFER_POOL] = m_Pages.size()*FLOWING_PAGE_SIZE;
+        } else {
+            usage.m_Bytes[MEMORY_BUFFER_POOL] = (size_t)(m_BufferPool.m_Next)*m_BufferPool.m_BufferSize;
+        }
+        usage.m_Bytes[MEMORY_PAGES] = numPages*(sizeof(AdjacencyPage) + FLOWING_MALLOC_OVERHEAD) + m_Pages.size()*FLOWING_LIST_NODE_BYTES +
+                                      m_FreePages.capacity()*sizeof(AdjacencyPage*);
+        usage.m_Bytes[MEMORY_ADJACENCY_LISTS] = numNodes*(sizeof(AdjacencyList) + FLOWING_MALLOC_OVERHEAD + sizeof(AdjacencyList*)) +
+                                                m_NumListNodes*(sizeof(AdjacencyListNode) + FLOWING_MALLOC_OVERHEAD);
+        usage.m_Bytes[MEMORY_ID_MAPS] = m_Map.size()*FLOWING_TREE_NODE_BYTES + m_Remap.capacity()*sizeof(unsigned int) +
+                                        m_FreeIds.capacity()*sizeof(unsigned int);
+        usage.m_Bytes[MEMORY_NODE_STATE] = m_NodeData.capacity()*sizeof(void*) + m_Degrees.capacity()*sizeof(unsigned int) +
+                                           m_Reclaimed.capacity()/8 + m_ReclaimCandidates.capacity()*sizeof(unsigned int);
+        usage.m_Bytes[MEMORY_SPILL_INDEX] = m_SpillIndex.capacity()*sizeof(UVector) + m_NumSpillIndexEntries*sizeof(unsigned int) +
+                                            m_SpillWeights.size()*sizeof(unsigned int);
+        usage.m_Bytes[MEMORY_NEIGHBOR_COUNTS] = m_Counts.Bytes() + (m_RelabelNeighbors.capacity() + m_RelabelWeights.capacity())*sizeof(unsigned int);
+        if( m_NodeDataUsage != NULL ) m_NodeDataUsage( this, usage );
+    }
+
+    unsigned int StreamGraph::NumBudgetEvictions() const {
+        return m_NumBudgetEvictions;
+    }
+
+    void StreamGraph::Flush() {
+        if( m_NumInBatch > 0 ) ProcessBatch();
+    }
+
+    bool StreamGraph::BudgetUnmet() const {
+        return m_BudgetUnmet;
+    }
+
+    unsigned long long StreamGraph::Push( std::istream& stream ) {
+        std::string line;
+        unsigned long long numLines = 0;
+        while( std::getline( stream, line ) ) {
+            numLines++;
+            Edge edge;
+            int result = EdgeReader::ParseLine( line.c_str(), edge );
+            if( result < 0 ) return numLines;
+            if( result > 0 ) Push( edge.m_Tail, edge.m_Head );
+        }
+        return 0;
+    }
+
+    void StreamGraph::Push( EdgeReader& reader ) {
+        Edge edges[FLOWING_READ_CHUNK];
+        int numEdges;
+        while( (numEdges = reader.Read( edges, FLOWING_READ_CHUNK )) > 0 ) {
+            if( m_Sampler.Enabled() ) m_Sampler.ObserveQueueDepth( reader.QueueDepth() );
+            if( m_Tuner.Enabled() ) m_Tuner.ObserveQueueDepth( reader.QueueDepth() );
+            for( int i = 0; i < numEdges; ++i ) {
+                Push( edges[i].m_Tail, edges[i].m_Head );
+            }
+        }
+    }
+
+    void StreamGraph::Push( EdgeServer& server ) {
+        const Edge* edges;
+        int numEdges;
+        while( (numEdges = server.Read( edges )) > 0 ) {
+            if( m_Sampler.Enabled() ) m_Sampler.ObserveQueueDepth( server.QueueDepth() );
+            if( m_Tuner.Enabled() ) m_Tuner.ObserveQueueDepth( server.QueueDepth() );
+            for( int i = 0; i < numEdges; ++i ) {
+                Push( edges[i].m_Tail, edges[i].m_Head );
+            }
         }
     }
 
     void StreamGraph::Push( const unsigned int tail, const unsigned int head, const double weight ) {
+        // Shed edges are dropped before touching any structure, so shedding is as cheap as possible.
+        double scaled = weight;
+        if( m_Sampler.Enabled() ) {
+            if( !m_Sampler.Sample() ) return;
+            scaled *= m_Sampler.Weight();
+        }
+        unsigned int multiplicity = scaled > 1.0 ? (unsigned int)(scaled + 0.5) : 1;
+        // The callbacks get a single weight per call, so a change of weight closes the batch.
+        if( m_NumInBatch > 0 && multiplicity != m_BatchWeight ) ProcessBatch();
+        m_BatchWeight = multiplicity;
+        if( multiplicity != 1 ) m_Weighted = true;
+
         unsigned int internalTail = GetInternalId(tail);
         unsigned int internalHead = GetInternalId(head);
-        InsertAdjacency( internalTail, internalHead );
+        InsertAdjacency( internalTail, internalHead, multiplicity );
+        m_Degrees[internalTail] += multiplicity;
+        m_Degrees[internalHead] += multiplicity;
 
+        if( m_NumInBatch == 0 && m_Tuner.Enabled() ) m_Tuner.BatchStarted();
         if( m_NumInBatch < m_BatchSize ) {
             m_Batch[m_NumInBatch].m_Tail = internalTail;
             m_Batch[m_NumInBatch].m_Head = internalHead;
@@ -181,26 +479,154 @@ namespace flowing {
         
         if( m_NumInBatch == m_BatchSize ) {
 //            std::cout << "Processing batch ..." << std::endl;
-            m_Insert( this, m_Batch, m_NumInBatch ); 
-            m_NumInBatch = 0;
+            ProcessBatch();
         }
 
         m_NumPushedEdges++;
-        if( m_NumPushedEdges % 10000  == 0 ) {
+        if( m_Verbose && m_NumPushedEdges % 10000  == 0 ) {
+            MemoryUsage usage;
+            GetMemoryUsage( usage );
             std::cout << "Number of edges read: " << m_NumPushedEdges << std::endl;
-            std::cout << "\t " << m_BufferPool.NumFreeBuffers() << "/" << m_BufferPool.MaxNumBuffers() << std::endl;
+            if( m_SharedPool != NULL ) {
+                std::cout << "\t " << m_Pages.size() << " shared pages " << usage.Total()/(1024*1024) << " MB" << std::endl;
+            } else {
+                std::cout << "\t " << m_BufferPool.NumFreeBuffers() << "/" << m_BufferPool.MaxNumBuffers() << " " << usage.Total()/(1024*1024) << " MB" << std::endl;
+            }
+            if( m_Sampler.Enabled() ) {
+                std::cout << "\t " << m_Sampler.NumShed() << "/" << m_Sampler.NumOffered() << " shed, weight " << m_Sampler.Weight() << std::endl;
+            }
+        }
+    }
+
+    void StreamGraph::ProcessBatch() {
+        InsertBatch();
+        // Only done between batches, since the pending edges may refer to the candidates.
+        if( !m_ReclaimCandidates.empty() ) ReclaimNodes();
+        if( m_MemoryBudget > 0 && m_EdgesSinceBudgetCheck >= FLOWING_MEMORY_CHECK_INTERVAL ) {
+            m_EdgesSinceBudgetCheck = 0;
+            EnforceMemoryBudget();
+        }
+        if( m_SharedPool != NULL && m_EdgesSinceQuotaCheck >= FLOWING_QUOTA_CHECK_INTERVAL ) {
+            m_EdgesSinceQuotaCheck = 0;
+            ShrinkToQuota();
         }
     }
 
-    StreamGraph::AdjacencyIterator StreamGraph::Iterator( const unsigned int nodeId ) const {
-        AdjacencyIterator iterator( m_Adjacencies[nodeId], m_EdgeMode );
+    void StreamGraph::InsertBatch() {
+        m_CallbackWeight = m_BatchWeight;
+        m_Insert( this, m_Batch, m_NumInBatch ); 
+        if( m_Tuner.Enabled() ) {
+            m_Tuner.BatchProcessed( m_NumInBatch );
+            m_BatchSize = m_Tuner.Size();
+        }
+        // The batches may be of any size, so the checks count the edges instead of looking at the total.
+        m_EdgesSinceBudgetCheck += m_NumInBatch;
+        m_EdgesSinceQuotaCheck += m_NumInBatch;
+        m_NumInBatch = 0;
+        m_NumBatches++;
+    }
+
+    unsigned int StreamGraph::EdgeWeight() const {
+        return m_CallbackWeight;
+    }
+
+    bool StreamGraph::Weighted() const {
+        return m_Weighted;
+    }
+
+    StreamGraph::AdjacencyIterator StreamGraph::Iterator( const unsigned int nodeId, const Direction direction ) const {
+        if( m_Spill.IsOpen() && m_SpillPolicy == SPILL_EXTEND ) {
+            AdjacencyIterator iterator( m_Adjacencies[nodeId], m_EdgeMode, direction, &m_Spill, &m_SpillIndex[nodeId] );
+            return iterator;
+        }
+        AdjacencyIterator iterator( m_Adjacencies[nodeId], m_EdgeMode, direction );
         return iterator;
     }
 
+    /** @brief Scans a run of edges into a neighbour buffer, growing it when needed.*/
+    static inline unsigned int ScanIntoBuffer( const Edge* edges, const int numEdges, const unsigned int node, const int match, UVector& neighbors, const unsigned int count ) {
+        if( neighbors.size() < count + numEdges + FLOWING_SCAN_SLACK ) {
+            neighbors.resize( 2*(count + numEdges + FLOWING_SCAN_SLACK) );
+        }
+        return ScanEdges( edges, numEdges, node, match, &neighbors[count] );
+    }
+
+    /** @brief Gives the same weight to a run of adjacencies just scanned, growing the weight buffer along with the neighbour one.*/
+    static inline void FillWeights( UVector* weights, const UVector& neighbors, const unsigned int from, const unsigned int to, const unsigned int weight ) {
+        if( weights == NULL ) return;
+        if( weights->size() < neighbors.size() ) weights->resize( neighbors.size() );
+        std::fill( weights->begin() + from, weights->begin() + to, weight );
+    }
+
+    unsigned int StreamGraph::ScanPages( const AdjacencyListNode* first, const unsigned int node, const int match, UVector& neighbors, unsigned int count, UVector* weights ) {
+        for( const AdjacencyListNode* page = first; page != NULL; page = page->m_Next ) {
+            // Bring in the next page and its list node while the current one is being scanned.
+            const AdjacencyListNode* next = page->m_Next;
+            if( next != NULL ) {
+                __builtin_prefetch( next->m_Page->m_Buffer );
+                __builtin_prefetch( next->m_Next );
+            }
+            unsigned int numFound = ScanIntoBuffer( page->m_Page->m_Buffer, page->m_Page->m_NumEdges, node, match, neighbors, count );
+            FillWeights( weights, neighbors, count, count + numFound, page->m_Page->m_Weight );
+            count += numFound;
+        }
+        return count;
+    }
+
+    unsigned int StreamGraph::Neighbors( const unsigned int nodeId, UVector& neighbors, const Direction direction, UVector* weights ) const {
+        const AdjacencyList* list = m_Adjacencies[nodeId];
+        unsigned int count = 0;
+        int spillMatch = MATCH_ANY;
+        if( m_EdgeMode == UNDIRECTED ) {
+            count = ScanPages( list->m_First, nodeId, MATCH_ANY, neighbors, count, weights );
+        } else {
+            if( direction != IN ) count = ScanPages( list->m_First, nodeId, MATCH_TAIL, neighbors, count, weights );
+            if( direction != OUT ) count = ScanPages( list->m_InFirst, nodeId, MATCH_HEAD, neighbors, count, weights );
+            if( direction == OUT ) spillMatch = MATCH_TAIL;
+            if( direction == IN ) spillMatch = MATCH_HEAD;
+        }
+        if( m_Spill.IsOpen() && m_SpillPolicy == SPILL_EXTEND ) {
+            const UVector& segments = m_SpillIndex[nodeId];
+            for( unsigned int i = 0; i < segments.size(); ++i ) {
+                if( !m_Spill.IsValid( segments[i] ) ) continue;
+                if( i + FLOWING_SPILL_READAHEAD < segments.size() && m_Spill.IsValid( segments[i + FLOWING_SPILL_READAHEAD] ) ) {
+                    m_Spill.Prefetch( segments[i + FLOWING_SPILL_READAHEAD] );
+                }
+                int numEdges;
+                const Edge* edges = m_Spill.Segment( segments[i], numEdges );
+                unsigned int numFound = ScanIntoBuffer( edges, numEdges, nodeId, spillMatch, neighbors, count );
+                // The weights of the segments still in the log are kept in the order they were appended.
+                FillWeights( weights, neighbors, count, count + numFound, m_SpillWeights[segments[i] - m_Spill.Oldest()] );
+                count += numFound;
+            }
+        }
+        return count;
+    }
+
+    unsigned int StreamGraph::Degree( const unsigned int nodeId ) const {
+        return m_Degrees[nodeId];
+    }
+
+    StreamGraph::EdgeMode StreamGraph::Mode() const {
+        return m_EdgeMode;
+    }
+
     unsigned int StreamGraph::NumNodes() const {
         return m_NextId;
     }
 
+    unsigned int StreamGraph::NumLiveNodes() const {
+        return m_NextId - m_FreeIds.size();
+    }
+
+    bool StreamGraph::IsReclaimed( const unsigned int nodeId ) const {
+        return m_Reclaimed[nodeId];
+    }
+
+    unsigned int StreamGraph::NumReclaimedNodes() const {
+        return m_NumReclaimed;
+    }
+
     void* StreamGraph::GetNodeData( unsigned int id ) {
         return m_NodeData[id];
     }
@@ -209,112 +635,271 @@ namespace flowing {
         m_NodeData[id] = nodeData;
     }
 
+    void* StreamGraph::GetUserData() const {
+        return m_UserData;
+    }
+
+    void StreamGraph::SetUserData( void* userData ) {
+        m_UserData = userData;
+    }
+
     unsigned int StreamGraph::Remap( unsigned int id ) {
         return m_Remap[id];
     }
 
     StreamGraph::AdjacencyPage* StreamGraph::GetNewPage() {
-        void* buffer = m_BufferPool.NextBuffer();
-        StreamGraph::AdjacencyPage* page = NULL;
-        if( buffer == NULL ) {
-            page = m_Pages.front();
-            m_Pages.pop_front();
+        if( m_Pages.size() < m_PageLimit ) {
+            if( !m_FreePages.empty() ) {
+                AdjacencyPage* page = m_FreePages.back();
+                m_FreePages.pop_back();
+                return page;
+            }
+            void* buffer = m_SharedPool != NULL ? m_SharedPool->Acquire( m_PoolClient ) : m_BufferPool.NextBuffer();
+            if( buffer != NULL ) return AllocateAdjacencyPage( buffer, FLOWING_PAGE_SIZE );
+        }
+        // A batch larger than the pool would have edges removed before they are inserted, so the callbacks
+        // get them first. The edge being pushed is not written yet, and the maintenance waits for the next batch.
+        if( m_NumInBatch > 0 && m_Pages.front()->m_Batch == m_NumBatches ) InsertBatch();
+        return EvictPage();
+    }
+
+    StreamGraph::AdjacencyPage* StreamGraph::EvictPage() {
+        AdjacencyPage* page = m_Pages.front();
+        m_Pages.pop_front();
+        bool spill = m_Spill.IsOpen();
+        unsigned int segment = 0;
+        if( spill ) segment = SpillPage( page );
+        if( !spill || m_SpillPolicy == SPILL_ARCHIVE ) {
+            m_CallbackWeight = page->m_Weight;
             m_Remove( this, page->m_Buffer, page->m_NumEdges );
-            for( int i = 0; i < page->m_NumEdges; ++i ) {
-                unsigned int tail = page->m_Buffer[i].m_Tail;
-                unsigned int head = page->m_Buffer[i].m_Head;
-                if( (m_Adjacencies[tail]->m_First != NULL) && (m_Adjacencies[tail]->m_First->m_Page == page) ) { 
-                    AdjacencyListNode* aux = m_Adjacencies[tail]->m_First;
-                    m_Adjacencies[tail]->m_First = aux->m_Next;
-                    FreeAdjacencyListNode( aux );
-
-                    if( m_Adjacencies[tail]->m_First == NULL ) {
-                        m_Adjacencies[tail]->m_Last = NULL;
-                    }
+            // Nothing runs between here and the unlinking, so the counts can already drop the edges.
+            if( m_NodeLabel != NULL ) CountAdjacencies( page->m_Buffer, page->m_NumEdges, false, false, page->m_Weight );
+        }
+        for( int i = 0; i < page->m_NumEdges; ++i ) {
+            unsigned int tail = page->m_Buffer[i].m_Tail;
+            unsigned int head = page->m_Buffer[i].m_Head;
+            if( spill ) {
+                // Heads are indexed in both modes, so the edges entering a node can be found in the log too.
+                IndexSpilledSegment( tail, segment );
+                IndexSpilledSegment( head, segment );
+                if( tail == head && m_NodeLabel != NULL && m_SpillPolicy == SPILL_EXTEND && m_EdgeMode == DIRECTED ) {
+                    // A directed self loop was visited once in each list, but only once in the log.
+                    m_Counts.Subtract( tail, m_NodeLabel( this, tail ), page->m_Weight );
                 }
+            }
+            UnlinkPage( m_Adjacencies[tail]->m_First, m_Adjacencies[tail]->m_Last, page );
+            if( m_EdgeMode == UNDIRECTED ) {
+                UnlinkPage( m_Adjacencies[head]->m_First, m_Adjacencies[head]->m_Last, page );
+            } else {
+                UnlinkPage( m_Adjacencies[head]->m_InFirst, m_Adjacencies[head]->m_InLast, page );
+            }
+            if( m_NodeReclaim != NULL && (!spill || m_SpillPolicy == SPILL_ARCHIVE) ) {
+                AddReclaimCandidate( tail );
+                AddReclaimCandidate( head );
+            }
+        }
+        page->m_NumEdges = 0;
+        return page;
+    }
+
+    void StreamGraph::EnforceMemoryBudget() {
+        MemoryUsage usage;
+        GetMemoryUsage( usage );
+        if( usage.Total() <= m_MemoryBudget ) return;
+        size_t lowWater = (size_t)(m_MemoryBudget*FLOWING_MEMORY_LOW_WATER);
+        // The pool is never returned to the system, so it stops growing from now on, and the pages are
+        // evicted in steps since evicting them only frees the metadata that refers to them.
+        while( usage.Total() > lowWater && m_Pages.size() > 1 ) {
+            size_t numEvict = m_Pages.size() / FLOWING_MEMORY_EVICT_FRACTION;
+            if( numEvict == 0 ) numEvict = 1;
+            for( size_t i = 0; i < numEvict && m_Pages.size() > 1; ++i ) {
+                ReleasePage( EvictPage() );
+                m_NumBudgetEvictions++;
+            }
+            m_PageLimit = m_Pages.size();
+            CompactMetadata();
+            GetMemoryUsage( usage );
+        }
+        // Reported by the caller through BudgetUnmet, since several graphs may share the output.
+        if( usage.Total() > m_MemoryBudget ) m_BudgetUnmet = true;
+    }
 
-                if( (m_Adjacencies[head]->m_First != NULL) && (m_Adjacencies[head]->m_First->m_Page == page) ) { 
-                    AdjacencyListNode* aux = m_Adjacencies[head]->m_First;
-                    m_Adjacencies[head]->m_First = aux->m_Next;
-                    FreeAdjacencyListNode( aux );
+    void StreamGraph::ReleasePage( AdjacencyPage* page ) {
+        if( m_SharedPool != NULL ) {
+            m_SharedPool->Release( m_PoolClient, page->m_Buffer );
+            FreeAdjacencyPage( page );
+        } else {
+            m_FreePages.push_back( page );
+        }
+    }
 
-                    if( m_Adjacencies[head]->m_First == NULL ) {
-                        m_Adjacencies[head]->m_Last = NULL;
-                    }
+    void StreamGraph::ShrinkToQuota() {
+        // Called between batches, so the pages can be evicted and handed to the other graphs right away.
+        int excess = m_SharedPool->Excess( m_PoolClient );
+        for( int i = 0; i < excess && m_Pages.size() > 1; ++i ) {
+            ReleasePage( EvictPage() );
+        }
+        if( excess > 0 && !m_ReclaimCandidates.empty() ) ReclaimNodes();
+    }
+
+    void StreamGraph::CompactMetadata() {
+        if( !m_ReclaimCandidates.empty() ) ReclaimNodes();
+        UVector( m_ReclaimCandidates ).swap( m_ReclaimCandidates );
+        if( m_Spill.IsOpen() ) {
+            m_NumSpillIndexEntries = 0;
+            for( unsigned int i = 0; i < m_SpillIndex.size(); ++i ) {
+                UVector& segments = m_SpillIndex[i];
+                unsigned int numInvalid = 0;
+                while( numInvalid < segments.size() && !m_Spill.IsValid( segments[numInvalid] ) ) ++numInvalid;
+                if( numInvalid > 0 ) UVector( segments.begin() + numInvalid, segments.end() ).swap( segments );
+                m_NumSpillIndexEntries += segments.size();
+            }
+        }
+    }
+
+    unsigned int StreamGraph::SpillPage( const AdjacencyPage* page ) {
+        if( m_SpillPolicy == SPILL_EXTEND && m_Spill.IsFull() ) {
+            // The oldest spilled segment is about to be overwritten, so its edges finally leave the graph.
+            int numEdges;
+            const Edge* edges = m_Spill.Segment( m_Spill.Oldest(), numEdges );
+            m_CallbackWeight = m_SpillWeights.front();
+            m_SpillWeights.pop_front();
+            m_Remove( this, const_cast<Edge*>(edges), numEdges );
+            if( m_NodeLabel != NULL ) CountAdjacencies( edges, numEdges, false, true, m_CallbackWeight );
+            if( m_NodeReclaim != NULL ) {
+                for( int i = 0; i < numEdges; ++i ) {
+                    AddReclaimCandidate( edges[i].m_Tail );
+                    AddReclaimCandidate( edges[i].m_Head );
                 }
             }
-            page->m_NumEdges = 0;
-        } else {
-            page =  AllocateAdjacencyPage( buffer, FLOWING_PAGE_SIZE );
         }
-        return page;
+        if( m_SpillPolicy == SPILL_EXTEND ) m_SpillWeights.push_back( page->m_Weight );
+        return m_Spill.Append( page->m_Buffer, page->m_NumEdges );
     }
 
+    void StreamGraph::IndexSpilledSegment( const unsigned int node, const unsigned int segment ) {
+        UVector& segments = m_SpillIndex[node];
+        if( !segments.empty() && segments.back() == segment ) return;
+        // Segments are appended in order, so the overwritten ones are always at the front.
+        unsigned int numInvalid = 0;
+        while( numInvalid < segments.size() && !m_Spill.IsValid( segments[numInvalid] ) ) ++numInvalid;
+        if( numInvalid > 0 ) segments.erase( segments.begin(), segments.begin() + numInvalid );
+        segments.push_back( segment );
+        m_NumSpillIndexEntries = m_NumSpillIndexEntries + 1 - numInvalid;
+    }
     
+    void StreamGraph::AddReclaimCandidate( const unsigned int nodeId ) {
+        // Only nodes whose lists are empty are interesting, which keeps the candidates few.
+        if( m_Adjacencies[nodeId]->m_First == NULL && m_Adjacencies[nodeId]->m_InFirst == NULL ) {
+            m_ReclaimCandidates.push_back( nodeId );
+        }
+    }
+
+    bool StreamGraph::IsEmpty( const unsigned int nodeId ) const {
+        const AdjacencyList* list = m_Adjacencies[nodeId];
+        if( list->m_First != NULL || list->m_InFirst != NULL ) return false;
+        if( m_Spill.IsOpen() && m_SpillPolicy == SPILL_EXTEND ) {
+            const UVector& segments = m_SpillIndex[nodeId];
+            for( unsigned int i = 0; i < segments.size(); ++i ) {
+                if( m_Spill.IsValid( segments[i] ) ) return false;
+            }
+        }
+        return true;
+    }
+
+    void StreamGraph::ReclaimNodes() {
+        // The callback may add more candidates, which are then checked in the same pass.
+        for( unsigned int i = 0; i < m_ReclaimCandidates.size(); ++i ) {
+            unsigned int node = m_ReclaimCandidates[i];
+            if( m_Reclaimed[node] || !IsEmpty( node ) ) continue;
+            // Called while the node can still be remapped, so it can be written out.
+            if( !m_NodeReclaim( this, node, m_NodeData[node] ) ) continue;
+            m_NodeData[node] = NULL;
+            m_Map.erase( m_Remap[node] );
+            if( m_Spill.IsOpen() ) {
+                m_NumSpillIndexEntries -= m_SpillIndex[node].size();
+                UVector().swap( m_SpillIndex[node] );
+            }
+            m_Degrees[node] = 0;
+            if( m_NodeLabel != NULL ) m_Counts.ClearNode( node );
+            m_Reclaimed[node] = true;
+            m_FreeIds.push_back( node );
+            m_NumReclaimed++;
+        }
+        m_ReclaimCandidates.clear();
+    }
+
     unsigned int StreamGraph::GetInternalId( const unsigned int id ) {
         UUMap::iterator it = m_Map.find(id);
-        if( it == m_Map.end() ) {                                                           // If this is a new node, assign an internal id and initialize its adjacency list.
+        if( it == m_Map.end() && !m_FreeIds.empty() ) {                                     // Reuse the internal id of a reclaimed node.
+            unsigned int internalId = m_FreeIds.back();
+            m_FreeIds.pop_back();
+            it = m_Map.insert(std::pair<unsigned int, unsigned int>( id, internalId )).first;
+            m_Remap[internalId] = id;
+            m_Reclaimed[internalId] = false;
+            m_NodeData[internalId] = m_NodeDataAllocate( this, internalId );
+        } else if( it == m_Map.end() ) {                                                    // If this is a new node, assign an internal id and initialize its adjacency list.
             it = m_Map.insert(std::pair<unsigned int, unsigned int>( id, m_NextId )).first;
             m_Remap.push_back(id);
             AdjacencyList* list = AllocateAdjacencyList( m_NextId );
             m_Adjacencies.push_back(list);            
+            if( m_Spill.IsOpen() ) m_SpillIndex.push_back( UVector() );
+            m_Degrees.push_back( 0 );
+            if( m_NodeLabel != NULL ) m_Counts.AddNode();
+            m_Reclaimed.push_back( false );
             m_NodeData.push_back( m_NodeDataAllocate( this, m_NextId ) );
             m_NextId++;
         }
         return (*it).second;
     }
 
-    void StreamGraph::InsertAdjacency( const unsigned int tail, const unsigned int head ) {
+    void StreamGraph::InsertAdjacency( const unsigned int tail, const unsigned int head, const unsigned int weight ) {
         AdjacencyPage* page = NULL;
         if( m_Pages.size() > 0 ) {
             page = m_Pages.back();  
         }
-        if( page == NULL || page->m_NumEdges == page->m_MaxEdges ) {
+        if( page == NULL || page->m_NumEdges == page->m_MaxEdges || page->m_Weight != weight ) {
             page = GetNewPage();
+            page->m_Weight = weight;
             m_Pages.push_back( page );
         }
+        page->m_Batch = m_NumBatches;
         Edge* edge = &page->m_Buffer[page->m_NumEdges++];
         edge->m_Tail = tail;
         edge->m_Head = head;
-        AdjacencyList* list = m_Adjacencies[tail]; 
-        if( list->m_First == NULL ) {
-            AdjacencyListNode* node = AllocateAdjacencyListNode();
-            node->m_Page = page;
-            node->m_Next = NULL;
-            node->m_Previous = NULL;
-            list->m_First = node;
-            list->m_Last = node;
-        }
-        else if( list->m_Last->m_Page != page ) {
-            AdjacencyListNode* node = AllocateAdjacencyListNode();
-            node->m_Page = page;
-            node->m_Next = NULL;
-            node->m_Previous = NULL;
-            list->m_Last->m_Next = node;
-            node->m_Previous = list->m_Last->m_Next;
-            list->m_Last = node;
+        LinkPage( m_Adjacencies[tail]->m_First, m_Adjacencies[tail]->m_Last, page );
+        if( m_EdgeMode == UNDIRECTED ) {
+            LinkPage( m_Adjacencies[head]->m_First, m_Adjacencies[head]->m_Last, page );
+        } else {
+            LinkPage( m_Adjacencies[head]->m_InFirst, m_Adjacencies[head]->m_InLast, page );
         }
+        if( m_NodeLabel != NULL ) CountAdjacencies( edge, 1, true, false, weight );
+    }
 
-        if( m_EdgeMode == UNDIRECTED ) {
-            AdjacencyList* list = m_Adjacencies[head]; 
-            if( list->m_First == NULL ) {
-                AdjacencyListNode* node = AllocateAdjacencyListNode();
-                node->m_Page = page;
-                node->m_Next = NULL;
-                node->m_Previous = NULL;
-                list->m_First = node;
-                list->m_Last = node;
-            }
-            else if( list->m_Last->m_Page != page ) {
-                AdjacencyListNode* node = AllocateAdjacencyListNode();
-                node->m_Page = page;
-                node->m_Next = NULL;
-                node->m_Previous = NULL;
-                list->m_Last->m_Next = node;
-                node->m_Previous = list->m_Last->m_Next;
-                list->m_Last = node;
-            }
+    void StreamGraph::LinkPage( AdjacencyListNode*& first, AdjacencyListNode*& last, AdjacencyPage* page ) {
+        if( last != NULL && last->m_Page == page ) return;
+        AdjacencyListNode* node = AllocateAdjacencyListNode();
+        node->m_Page = page;
+        node->m_Next = NULL;
+        node->m_Previous = last;
+        if( first == NULL ) {
+            first = node;
+        } else {
+            last->m_Next = node;
         }
+        last = node;
     }
-}
 
+    void StreamGraph::UnlinkPage( AdjacencyListNode*& first, AdjacencyListNode*& last, const AdjacencyPage* page ) {
+        // Pages are evicted in the order they were filled, so an evicted page is always at the front of its lists.
+        if( first == NULL || first->m_Page != page ) return;
+        AdjacencyListNode* aux = first;
+        first = aux->m_Next;
+        FreeAdjacencyListNode( aux );
+        if( first == NULL ) {
+            last = NULL;
+        } else {
+            first->m_Previous = NULL;
+        }
+    }
+}
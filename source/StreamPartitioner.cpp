@@ -0,0 +1,214 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StreamPartitioner.h"
+#include <cmath>
+
+namespace flowing {
+
+    StreamPartitioner::StreamPartitioner( StreamGraph* graph ) :
+        m_Graph( graph ),
+        m_NumParts( 0 ),
+        m_Method( LDG ),
+        m_NumAssigned( 0 ),
+        m_NumEdges( 0 ),
+        m_NumCutEdges( 0 ),
+        m_Output( NULL ) {
+    }
+
+    StreamPartitioner::~StreamPartitioner() {
+    }
+
+    void StreamPartitioner::InsertEdges( StreamGraph* graph, Edge* edges, int numEdges ) {
+        static_cast<StreamPartitioner*>(graph->GetUserData())->Insert( edges, numEdges, graph->EdgeWeight() );
+    }
+
+    void StreamPartitioner::RemoveEdges( StreamGraph* graph, Edge* edges, int numEdges ) {
+        static_cast<StreamPartitioner*>(graph->GetUserData())->Remove( edges, numEdges );
+    }
+
+    void* StreamPartitioner::NodeDataAllocate( StreamGraph* graph, unsigned int nodeId ) {
+        static_cast<StreamPartitioner*>(graph->GetUserData())->ResetNode( nodeId );
+        return NULL;
+    }
+
+    void StreamPartitioner::NodeDataFree( StreamGraph* graph, unsigned int nodeId, void* nodeData ) {
+        static_cast<StreamPartitioner*>(graph->GetUserData())->Retire( nodeId );
+    }
+
+    void StreamPartitioner::Configure( const int numParts, const Method method ) {
+        m_NumParts = numParts > 0 ? numParts : 0;
+        m_Method = method;
+        m_Loads.assign( m_NumParts, 0 );
+        m_Counts.assign( m_NumParts, 0 );
+    }
+
+    bool StreamPartitioner::Enabled() const {
+        return m_NumParts > 0;
+    }
+
+    void StreamPartitioner::SetOutput( std::ostream* out ) {
+        m_Output = out;
+    }
+
+    void StreamPartitioner::ResetNode( const unsigned int nodeId ) {
+        if( !Enabled() ) return;
+        if( nodeId >= m_Parts.size() ) m_Parts.resize( nodeId + 1, -1 );
+        m_Parts[nodeId] = -1;
+        if( m_Retired.empty() ) return;
+        // A node that comes back after being reclaimed keeps its part, which still holds its load.
+        std::unordered_map<unsigned int, int>::const_iterator it = m_Retired.find( m_Graph->Remap( nodeId ) );
+        if( it != m_Retired.end() ) m_Parts[nodeId] = it->second;
+    }
+
+    void StreamPartitioner::Insert( const Edge* edges, const int numEdges, const unsigned int weight ) {
+        if( !Enabled() ) return;
+        // The whole batch is already in the adjacencies, so the edges with an unplaced end are accounted by
+        // Assign when that end is placed, and only the others are accounted here.
+        for( int i = 0; i < numEdges; ++i ) {
+            unsigned int tail = edges[i].m_Tail;
+            unsigned int head = edges[i].m_Head;
+            if( tail == head ) {
+                m_NumEdges += weight;
+            } else if( m_Parts[tail] >= 0 && m_Parts[head] >= 0 ) {
+                m_NumEdges += weight;
+                if( m_Parts[tail] != m_Parts[head] ) m_NumCutEdges += weight;
+            }
+        }
+        for( int i = 0; i < numEdges; ++i ) {
+            const unsigned int ends[2] = { edges[i].m_Tail, edges[i].m_Head };
+            for( int j = 0; j < 2; ++j ) {
+                unsigned int node = ends[j];
+                if( m_Parts[node] == -1 ) m_Parts[node] = -2;
+                if( m_Parts[node] == -2 && m_Graph->Degree( node ) >= FLOWING_PARTITION_MIN_DEGREE ) Assign( node );
+            }
+        }
+    }
+
+    void StreamPartitioner::Remove( const Edge* edges, const int numEdges ) {
+        if( !Enabled() ) return;
+        for( int i = 0; i < numEdges; ++i ) {
+            if( m_Parts[edges[i].m_Tail] == -2 ) Assign( edges[i].m_Tail );
+            if( m_Parts[edges[i].m_Head] == -2 ) Assign( edges[i].m_Head );
+        }
+    }
+
+    void StreamPartitioner::Flush() {
+        if( !Enabled() ) return;
+        for( unsigned int i = 0; i < m_Parts.size(); ++i ) {
+            if( m_Parts[i] == -2 ) Assign( i );
+        }
+    }
+
+    void StreamPartitioner::Assign( const unsigned int nodeId, const bool scan ) {
+        UVector* weights = m_Graph->Weighted() ? &m_Weights : NULL;
+        unsigned int numNeighbors = scan ? m_Graph->Neighbors( nodeId, m_Neighbors, StreamGraph::BOTH, weights ) : 0;
+        for( unsigned int i = 0; i < numNeighbors; ++i ) {
+            int part = m_Parts[m_Neighbors[i]];
+            if( part < 0 ) continue;
+            if( m_Counts[part] == 0 ) m_Touched.push_back( part );
+            m_Counts[part] += weights != NULL ? (*weights)[i] : 1;
+        }
+
+        // The parts without neighbours all score best at their lowest load, so only the least loaded one competes with the touched parts.
+        int leastLoaded = 0;
+        for( int i = 1; i < m_NumParts; ++i ) {
+            if( m_Loads[i] < m_Loads[leastLoaded] ) leastLoaded = i;
+        }
+        double numNodes = (double)(m_NumAssigned + 1);
+        double capacity = FLOWING_PARTITION_SLACK*numNodes/m_NumParts;
+        double alpha = std::sqrt( (double)m_NumParts )*(double)(m_NumEdges + 1)/std::pow( numNodes, 1.5 );
+        int best = leastLoaded;
+        double bestScore = 0.0;
+        bool first = true;
+        for( size_t i = 0; i <= m_Touched.size(); ++i ) {
+            int part = i < m_Touched.size() ? m_Touched[i] : leastLoaded;
+            double load = (double)m_Loads[part];
+            if( part != leastLoaded && load + 1.0 > capacity ) continue;
+            double score = m_Method == LDG ? m_Counts[part]*(1.0 - load/capacity) :
+                                             m_Counts[part] - alpha*FLOWING_FENNEL_GAMMA*std::pow( load, FLOWING_FENNEL_GAMMA - 1.0 );
+            if( first || score > bestScore || (score == bestScore && m_Loads[part] < m_Loads[best]) ) {
+                best = part;
+                bestScore = score;
+                first = false;
+            }
+        }
+        for( size_t i = 0; i < m_Touched.size(); ++i ) {
+            unsigned int count = m_Counts[m_Touched[i]];
+            m_NumEdges += count;
+            if( m_Touched[i] != best ) m_NumCutEdges += count;
+            m_Counts[m_Touched[i]] = 0;
+        }
+        m_Touched.clear();
+
+        m_Parts[nodeId] = best;
+        m_Loads[best]++;
+        m_NumAssigned++;
+    }
+
+    void StreamPartitioner::Retire( const unsigned int nodeId, const bool reclaimed ) {
+        if( !Enabled() || m_Parts[nodeId] == -1 ) return;
+        if( m_Parts[nodeId] == -2 ) Assign( nodeId, false );
+        unsigned int node = m_Graph->Remap( nodeId );
+        bool written = false;
+        if( reclaimed ) {
+            written = !m_Retired.insert( std::make_pair( node, m_Parts[nodeId] ) ).second;
+        } else if( !m_Retired.empty() ) {
+            written = m_Retired.find( node ) != m_Retired.end();
+        }
+        if( m_Output != NULL && !written ) (*m_Output) << node << " " << m_Parts[nodeId] << "\n";
+        m_Parts[nodeId] = -1;
+    }
+
+    int StreamPartitioner::Part( const unsigned int nodeId ) const {
+        return nodeId < m_Parts.size() && m_Parts[nodeId] >= 0 ? m_Parts[nodeId] : -1;
+    }
+
+    int StreamPartitioner::NumParts() const {
+        return m_NumParts;
+    }
+
+    unsigned long long StreamPartitioner::Load( const int part ) const {
+        return m_Loads[part];
+    }
+
+    unsigned long long StreamPartitioner::NumAssigned() const {
+        return m_NumAssigned;
+    }
+
+    unsigned long long StreamPartitioner::NumEdges() const {
+        return m_NumEdges;
+    }
+
+    unsigned long long StreamPartitioner::NumCutEdges() const {
+        return m_NumCutEdges;
+    }
+
+    double StreamPartitioner::Imbalance() const {
+        if( m_NumAssigned == 0 ) return 1.0;
+        unsigned long long maxLoad = 0;
+        for( int i = 0; i < m_NumParts; ++i ) {
+            if( m_Loads[i] > maxLoad ) maxLoad = m_Loads[i];
+        }
+        return maxLoad*(double)m_NumParts/m_NumAssigned;
+    }
+
+    void StreamPartitioner::AddMemoryUsage( MemoryUsage& usage ) const {
+        usage.m_Bytes[MEMORY_PARTITIONS] += m_Parts.capacity()*sizeof(int) + m_Loads.capacity()*sizeof(unsigned long long) +
+                                            (m_Counts.capacity() + m_Neighbors.capacity() + m_Weights.capacity())*sizeof(unsigned int) +
+                                            m_Touched.capacity()*sizeof(int) +
+                                            m_Retired.size()*(sizeof(std::pair<const unsigned int, int>) + sizeof(void*)) +
+                                            m_Retired.bucket_count()*sizeof(void*);
+    }
+}
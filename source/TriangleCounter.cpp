@@ -0,0 +1,160 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TriangleCounter.h"
+#include "Kernels.h"
+#include <algorithm>
+
+namespace flowing {
+
+    TriangleCounter::TriangleCounter( const StreamGraph* graph ) :
+        m_Graph( graph ),
+        m_Enabled( false ),
+        m_Scoring( false ),
+        m_NumTriangles( 0 ),
+        m_NumEdges( 0 ),
+        m_NumAdjacencies( 0 ),
+        m_Seconds( 0.0 ) {
+    }
+
+    TriangleCounter::~TriangleCounter() {
+    }
+
+    void TriangleCounter::Configure( const bool enabled, const bool scoring ) {
+        m_Enabled = enabled || scoring;
+        m_Scoring = scoring;
+    }
+
+    bool TriangleCounter::Enabled() const {
+        return m_Enabled;
+    }
+
+    bool TriangleCounter::Scoring() const {
+        return m_Scoring;
+    }
+
+    void TriangleCounter::ResetNode( const unsigned int node ) {
+        if( !m_Enabled ) return;
+        if( node >= m_NodeTriangles.size() ) m_NodeTriangles.resize( node + 1 );
+        m_NodeTriangles[node] = 0;
+    }
+
+    unsigned int TriangleCounter::Gather( const unsigned int node, UVector& neighbors, UVector* counts ) {
+        unsigned int numNeighbors = m_Graph->Neighbors( node, neighbors, StreamGraph::BOTH );
+        m_NumAdjacencies += numNeighbors;
+        // Repeated edges would close the same triangle several times, and the kernels need distinct values.
+        std::sort( neighbors.begin(), neighbors.begin() + numNeighbors );
+        if( counts == NULL ) return std::unique( neighbors.begin(), neighbors.begin() + numNeighbors ) - neighbors.begin();
+        if( counts->size() < numNeighbors ) counts->resize( numNeighbors );
+        unsigned int numDistinct = 0;
+        for( unsigned int i = 0; i < numNeighbors; ++i ) {
+            if( numDistinct > 0 && neighbors[numDistinct-1] == neighbors[i] ) {
+                (*counts)[numDistinct-1]++;
+            } else {
+                neighbors[numDistinct] = neighbors[i];
+                (*counts)[numDistinct++] = 1;
+            }
+        }
+        return numDistinct;
+    }
+
+    unsigned long long TriangleCounter::EdgeKey( const unsigned int tail, const unsigned int head ) {
+        return tail < head ? ((unsigned long long)tail << 32) | head : ((unsigned long long)head << 32) | tail;
+    }
+
+    void TriangleCounter::BeginBatch( const Edge* edges, const int numEdges ) {
+        m_Pending.clear();
+        if( !m_Enabled || numEdges <= 1 ) return;
+        for( int i = 0; i < numEdges; ++i ) {
+            if( edges[i].m_Tail != edges[i].m_Head ) m_Pending[EdgeKey( edges[i].m_Tail, edges[i].m_Head )]++;
+        }
+    }
+
+    bool TriangleCounter::Arrived( const unsigned int node, const unsigned int other, const UVector& neighbors, const UVector& counts, const unsigned int numNeighbors ) const {
+        std::unordered_map<unsigned long long, unsigned int>::const_iterator it = m_Pending.find( EdgeKey( node, other ) );
+        if( it == m_Pending.end() ) return true;
+        unsigned int index = std::lower_bound( neighbors.begin(), neighbors.begin() + numNeighbors, other ) - neighbors.begin();
+        // The same edge may also have arrived before the batch, or earlier in it.
+        return counts[index] > it->second;
+    }
+
+    unsigned int TriangleCounter::Count( const unsigned int tail, const unsigned int head, const unsigned int weight, const unsigned int*& common ) {
+        m_NumEdges++;
+        common = NULL;
+        if( tail == head ) return 0;
+        bool pending = false;
+        if( !m_Pending.empty() ) {
+            std::unordered_map<unsigned long long, unsigned int>::iterator it = m_Pending.find( EdgeKey( tail, head ) );
+            if( it != m_Pending.end() && --it->second == 0 ) m_Pending.erase( it );
+            pending = !m_Pending.empty();
+        }
+        unsigned int numTail = Gather( tail, m_TailNeighbors, pending ? &m_TailCounts : NULL );
+        unsigned int numHead = Gather( head, m_HeadNeighbors, pending ? &m_HeadCounts : NULL );
+        unsigned int size = (numTail < numHead ? numTail : numHead) + FLOWING_SCAN_SLACK;
+        if( m_Common.size() < size ) m_Common.resize( 2*size );
+        int numCommon = IntersectSorted( m_TailNeighbors.data(), numTail, m_HeadNeighbors.data(), numHead, m_Common.data() );
+        // The endpoints only show up through self loops, which do not close triangles, and a neighbour
+        // reached only through edges later in the batch is counted when the last of them arrives.
+        unsigned int numTriangles = 0;
+        for( int i = 0; i < numCommon; ++i ) {
+            unsigned int node = m_Common[i];
+            m_Common[numTriangles] = node;
+            bool closed = node != tail && node != head;
+            if( closed && pending ) {
+                closed = Arrived( tail, node, m_TailNeighbors, m_TailCounts, numTail ) &&
+                         Arrived( head, node, m_HeadNeighbors, m_HeadCounts, numHead );
+            }
+            numTriangles += closed;
+        }
+        for( unsigned int i = 0; i < numTriangles; ++i ) {
+            m_NodeTriangles[m_Common[i]] += weight;
+        }
+        m_NodeTriangles[tail] += (unsigned long long)numTriangles*weight;
+        m_NodeTriangles[head] += (unsigned long long)numTriangles*weight;
+        m_NumTriangles += (unsigned long long)numTriangles*weight;
+        common = m_Common.data();
+        return numTriangles;
+    }
+
+    unsigned long long TriangleCounter::NodeTriangles( const unsigned int node ) const {
+        return m_Enabled ? m_NodeTriangles[node] : 0;
+    }
+
+    unsigned long long TriangleCounter::NumTriangles() const {
+        return m_NumTriangles;
+    }
+
+    unsigned long long TriangleCounter::NumEdges() const {
+        return m_NumEdges;
+    }
+
+    unsigned long long TriangleCounter::NumAdjacencies() const {
+        return m_NumAdjacencies;
+    }
+
+    double TriangleCounter::Seconds() const {
+        return m_Seconds;
+    }
+
+    void TriangleCounter::AddSeconds( const double seconds ) {
+        m_Seconds += seconds;
+    }
+
+    size_t TriangleCounter::Bytes() const {
+        return m_NodeTriangles.capacity()*sizeof(unsigned long long) +
+               (m_TailNeighbors.capacity() + m_HeadNeighbors.capacity() + m_Common.capacity() +
+                m_TailCounts.capacity() + m_HeadCounts.capacity())*sizeof(unsigned int) +
+               m_Pending.size()*(sizeof(unsigned long long) + sizeof(unsigned int) + sizeof(void*));
+    }
+}
@@ -0,0 +1,148 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** @brief Uses the in-process API the way the README shows it: a few cliques joined by single edges are
+ *  pushed as arrays into detectors whose batches hold the whole stream, and the communities and parts are
+ *  read back before closing, so they only show up if the pending batch is processed first.*/
+
+#include "Flowing.h"
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+#define FLOWING_CHECK_NUM_CLIQUES 4
+#define FLOWING_CHECK_CLIQUE_SIZE 8
+#define FLOWING_CHECK_FIRST_ID 1000
+#define FLOWING_CHECK_BATCH_SIZE 4096
+
+using namespace flowing;
+
+/** @brief Builds the edges of the cliques, with ids far from 0 so the original ids have to be mapped back,
+ *  and one edge from each clique to the next.*/
+static void BuildCliques( std::vector<Edge>& edges ) {
+    for( int c = 0; c < FLOWING_CHECK_NUM_CLIQUES; ++c ) {
+        unsigned int first = FLOWING_CHECK_FIRST_ID + c*FLOWING_CHECK_CLIQUE_SIZE;
+        for( unsigned int i = 0; i < FLOWING_CHECK_CLIQUE_SIZE; ++i ) {
+            for( unsigned int j = i + 1; j < FLOWING_CHECK_CLIQUE_SIZE; ++j ) {
+                Edge edge;
+                edge.m_Tail = first + i;
+                edge.m_Head = first + j;
+                edges.push_back( edge );
+            }
+        }
+        if( c > 0 ) {
+            Edge bridge;
+            bridge.m_Tail = first - 1;
+            bridge.m_Head = first;
+            edges.push_back( bridge );
+        }
+    }
+}
+
+/** @brief Checks that every node is assigned once, each clique is mostly one community and no two cliques share one.
+ *  @return The number of errors.*/
+static int CheckAssignments( const char* name, const std::vector<unsigned int>& nodes, const std::vector<unsigned int>& communities, const size_t count ) {
+    const size_t numNodes = FLOWING_CHECK_NUM_CLIQUES*FLOWING_CHECK_CLIQUE_SIZE;
+    if( count != numNodes ) {
+        std::cout << name << ": " << count << " assignments instead of " << numNodes << std::endl;
+        return 1;
+    }
+    std::map<unsigned int, unsigned int> labels;
+    for( size_t i = 0; i < count; ++i ) {
+        if( nodes[i] < FLOWING_CHECK_FIRST_ID || nodes[i] >= FLOWING_CHECK_FIRST_ID + numNodes || !labels.insert( std::make_pair( nodes[i], communities[i] ) ).second ) {
+            std::cout << name << ": unexpected or repeated node " << nodes[i] << std::endl;
+            return 1;
+        }
+    }
+    int numErrors = 0;
+    std::set<unsigned int> seen;
+    for( int c = 0; c < FLOWING_CHECK_NUM_CLIQUES; ++c ) {
+        unsigned int first = FLOWING_CHECK_FIRST_ID + c*FLOWING_CHECK_CLIQUE_SIZE;
+        std::map<unsigned int, int> sizes;
+        for( unsigned int i = 0; i < FLOWING_CHECK_CLIQUE_SIZE; ++i ) {
+            sizes[labels[first + i]]++;
+        }
+        unsigned int label = sizes.begin()->first;
+        for( std::map<unsigned int, int>::const_iterator it = sizes.begin(); it != sizes.end(); ++it ) {
+            if( it->second > sizes[label] ) label = it->first;
+        }
+        // The two ends of the bridges may go either way, but the rest of the clique has to stay together.
+        if( sizes[label] < FLOWING_CHECK_CLIQUE_SIZE - 2 ) {
+            std::cout << name << ": clique " << c << " is split, at most " << sizes[label] << " nodes together" << std::endl;
+            numErrors++;
+        }
+        if( !seen.insert( label ).second ) {
+            std::cout << name << ": clique " << c << " shares its community with another one" << std::endl;
+            numErrors++;
+        }
+    }
+    return numErrors;
+}
+
+/** @brief Pushes the cliques as an array of edges and reads the communities and parts back.*/
+static int CheckEdgeArray( const std::vector<Edge>& edges ) {
+    CommunityDetector detector( StreamGraph::UNDIRECTED, FLOWING_CHECK_BATCH_SIZE );
+    detector.Graph().SetNumPages( 1000 );
+    detector.Graph().SetVerbose( false );
+    detector.EnablePartitioning( 2 );
+    if( !detector.Initialize() ) {
+        std::cout << "edges: unable to initialize" << std::endl;
+        return 1;
+    }
+    detector.Push( edges.data(), edges.size() );
+    std::vector<unsigned int> nodes( detector.NumNodes() ), communities( detector.NumNodes() );
+    size_t count = detector.Assignments( nodes.data(), communities.data(), nodes.size() );
+    int numErrors = CheckAssignments( "edges", nodes, communities, count );
+    std::vector<int> parts( detector.NumNodes() );
+    count = detector.Partitions( nodes.data(), parts.data(), nodes.size() );
+    for( size_t i = 0; i < count; ++i ) {
+        if( parts[i] < 0 || parts[i] >= 2 ) {
+            std::cout << "edges: node " << nodes[i] << " is in part " << parts[i] << std::endl;
+            numErrors++;
+        }
+    }
+    detector.Close();
+    return numErrors;
+}
+
+/** @brief Pushes the cliques as two arrays of ends and reads the communities back.*/
+static int CheckEndArrays( const std::vector<Edge>& edges ) {
+    std::vector<unsigned int> tails, heads;
+    for( size_t i = 0; i < edges.size(); ++i ) {
+        tails.push_back( edges[i].m_Tail );
+        heads.push_back( edges[i].m_Head );
+    }
+    CommunityDetector detector( StreamGraph::UNDIRECTED, FLOWING_CHECK_BATCH_SIZE );
+    detector.Graph().SetNumPages( 1000 );
+    detector.Graph().SetVerbose( false );
+    if( !detector.Initialize() ) {
+        std::cout << "ends: unable to initialize" << std::endl;
+        return 1;
+    }
+    detector.Push( tails.data(), heads.data(), edges.size() );
+    std::vector<unsigned int> nodes( detector.NumNodes() ), communities( detector.NumNodes() );
+    size_t count = detector.Assignments( nodes.data(), communities.data(), nodes.size() );
+    int numErrors = CheckAssignments( "ends", nodes, communities, count );
+    detector.Close();
+    return numErrors;
+}
+
+int main( int argc, char** argv ) {
+    std::vector<Edge> edges;
+    BuildCliques( edges );
+    int numErrors = CheckEdgeArray( edges ) + CheckEndArrays( edges );
+    std::cout << "detector: " << (numErrors == 0 ? "ok" : "FAILED") << std::endl;
+    return numErrors == 0 ? 0 : 1;
+}
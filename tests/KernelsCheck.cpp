@@ -0,0 +1,111 @@
+/*Flowing is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  SCD is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** @brief Checks the vectorized kernels supported by the cpu against their portable versions, over
+ *  random inputs of every size up to a few registers, so the tails and the block boundaries are covered.*/
+
+#include "Kernels.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define FLOWING_CHECK_MAX_SIZE 80
+#define FLOWING_CHECK_ROUNDS 200
+
+using namespace flowing;
+
+static const char* s_LevelNames[] = { "scalar", "sse2", "avx2" };
+
+/** @brief Fills a sorted array of distinct values drawn from [0, range).*/
+static void RandomSorted( std::vector<unsigned int>& values, const int size, const unsigned int range ) {
+    values.clear();
+    while( (int)values.size() < size ) {
+        values.push_back( rand() % range );
+        if( (int)values.size() == size ) {
+            std::sort( values.begin(), values.end() );
+            values.erase( std::unique( values.begin(), values.end() ), values.end() );
+        }
+    }
+}
+
+/** @brief Checks ScanEdges of a level over edges whose ends are drawn from a few nodes, so that every
+ *  combination of matching tails and heads, self loops included, shows up.*/
+static int CheckScanEdges( const KernelLevel level ) {
+    int numErrors = 0;
+    std::vector<Edge> edges( FLOWING_CHECK_MAX_SIZE );
+    std::vector<unsigned int> expected( FLOWING_CHECK_MAX_SIZE + FLOWING_SCAN_SLACK );
+    std::vector<unsigned int> found( FLOWING_CHECK_MAX_SIZE + FLOWING_SCAN_SLACK );
+    const int matches[] = { MATCH_TAIL, MATCH_HEAD, MATCH_ANY };
+    for( int round = 0; round < FLOWING_CHECK_ROUNDS; ++round ) {
+        for( int numEdges = 0; numEdges <= FLOWING_CHECK_MAX_SIZE; ++numEdges ) {
+            for( int i = 0; i < numEdges; ++i ) {
+                edges[i].m_Tail = rand() % 4;
+                edges[i].m_Head = rand() % 4;
+            }
+            unsigned int node = rand() % 4;
+            for( int m = 0; m < 3; ++m ) {
+                int numExpected = ScanEdgesScalar( edges.data(), numEdges, node, matches[m], expected.data() );
+                int numFound = ScanEdgesWith( level, edges.data(), numEdges, node, matches[m], found.data() );
+                if( numFound != numExpected || !std::equal( expected.begin(), expected.begin() + numExpected, found.begin() ) ) {
+                    std::cout << "ScanEdges " << s_LevelNames[level] << " differs with " << numEdges << " edges and match " << matches[m] << std::endl;
+                    numErrors++;
+                }
+            }
+        }
+    }
+    return numErrors;
+}
+
+/** @brief Checks IntersectSorted of a level over arrays of every pair of sizes, with ranges that make the
+ *  common values go from rare to most of them.*/
+static int CheckIntersectSorted( const KernelLevel level ) {
+    int numErrors = 0;
+    std::vector<unsigned int> a;
+    std::vector<unsigned int> b;
+    std::vector<unsigned int> expected( FLOWING_CHECK_MAX_SIZE + FLOWING_SCAN_SLACK );
+    std::vector<unsigned int> found( FLOWING_CHECK_MAX_SIZE + FLOWING_SCAN_SLACK );
+    for( int round = 0; round < FLOWING_CHECK_ROUNDS/20; ++round ) {
+        for( int numA = 0; numA <= FLOWING_CHECK_MAX_SIZE; ++numA ) {
+            for( int numB = 0; numB <= FLOWING_CHECK_MAX_SIZE; ++numB ) {
+                unsigned int range = 2*FLOWING_CHECK_MAX_SIZE << (round % 4);
+                RandomSorted( a, numA, range );
+                RandomSorted( b, numB, range );
+                int numExpected = IntersectSortedScalar( a.data(), a.size(), b.data(), b.size(), expected.data() );
+                int numFound = IntersectSortedWith( level, a.data(), a.size(), b.data(), b.size(), found.data() );
+                if( numFound != numExpected || !std::equal( expected.begin(), expected.begin() + numExpected, found.begin() ) ) {
+                    std::cout << "IntersectSorted " << s_LevelNames[level] << " differs with " << a.size() << " and " << b.size() << " values" << std::endl;
+                    numErrors++;
+                }
+            }
+        }
+    }
+    return numErrors;
+}
+
+int main( int argc, char** argv ) {
+    srand( 1 );
+    int numErrors = 0;
+    const KernelLevel levels[] = { KERNEL_SSE2, KERNEL_AVX2 };
+    for( int i = 0; i < 2; ++i ) {
+        if( !KernelSupported( levels[i] ) ) {
+            std::cout << s_LevelNames[levels[i]] << ": not supported, skipped" << std::endl;
+            continue;
+        }
+        int levelErrors = CheckScanEdges( levels[i] ) + CheckIntersectSorted( levels[i] );
+        std::cout << s_LevelNames[levels[i]] << ": " << (levelErrors == 0 ? "ok" : "FAILED") << std::endl;
+        numErrors += levelErrors;
+    }
+    return numErrors == 0 ? 0 : 1;
+}